@@ -44,9 +44,11 @@
 #include "r_data/renderstyle.h"
 #include "s_sound.h"
 #include "memarena.h"
+#include "m_bbox.h"
 #include "g_level.h"
 #include "tflags.h"
 #include "portal.h"
+#include "p_hotfields.h"
 
 struct subsector_t;
 struct FBlockNode;
@@ -1029,6 +1031,7 @@ public:
 // NOTE: The first member variable *must* be snext.
 	AActor			*snext, **sprev;	// links in sector (if needed)
 	DVector3		__Pos;		// double underscores so that it won't get used by accident. Access to this should be exclusively through the designated access functions.
+	int				HotSlot = -1;	// index into ActorHotFields once the actor has been linked into the world
 
 	DAngle			SpriteAngle;
 	DAngle			SpriteRotation;
@@ -1189,6 +1192,9 @@ public:
 	struct portnode_t	*touching_lineportallist;		// and for cross-lineportal
 	struct msecnode_t	*touching_rendersectors; // this is the list of sectors that this thing interesects with it's max(radius, renderradius).
 	int validcount;
+	FBoundingBox SecnodeFreeBox;	// Box last searched for crossing lines (see P_CreateSecNodeList)
+	uint32_t SecnodeFreeLevel;	// SecnodeFreeBox is only valid if this matches the current level
+	bool SecnodeFreeBlocked;	// a line crosses SecnodeFreeBox
 
 
 	TObjPtr<AInventory*>	Inventory;		// [RH] This actor's inventory
@@ -1405,25 +1411,42 @@ public:
 	void SetZ(double newz, bool moving = true)
 	{
 		__Pos.Z = newz;
+		UpdateHotFields();
 	}
 	void AddZ(double newz, bool moving = true)
 	{
 		__Pos.Z += newz;
 		if (!moving) Prev.Z = Z();
+		UpdateHotFields();
 	}
 
 	void SetXY(const DVector2 &npos)
 	{
 		__Pos.X = npos.X;
 		__Pos.Y = npos.Y;
+		UpdateHotFields();
 	}
 	void SetXYZ(double xx, double yy, double zz)
 	{
 		__Pos = { xx,yy,zz };
+		UpdateHotFields();
 	}
 	void SetXYZ(const DVector3 &npos)
 	{
 		__Pos = npos;
+		UpdateHotFields();
+	}
+	void SetRadius(double newradius)
+	{
+		radius = newradius;
+		UpdateHotFields();
+	}
+	void UpdateHotFields()
+	{
+		if (HotSlot >= 0)
+		{
+			ActorHotFields.Pos[HotSlot] = { __Pos.X, __Pos.Y, __Pos.Z, radius };
+		}
 	}
 
 	double VelXYToSpeed() const
@@ -2,6 +2,7 @@
 
 #include "actor.h"
 #include "r_defs.h"
+#include "p_maputl.h"
 // These depend on both actor.h and r_defs.h so they cannot be in either file without creating a cross dependency.
 
 inline DVector3 AActor::PosRelative(int portalgroup) const
@@ -53,3 +54,21 @@ inline double sector_t::LowestFloorAt(AActor *a, sector_t **resultsec)
 	return LowestFloorAt(a->Pos(), resultsec);
 }
 
+inline bool FMultiBlockThingsIterator::OutOfReach(const CheckResult &cres, double radius)
+{
+	double x, y, blockdist;
+	if (cres.HotSlot >= 0)
+	{
+		const FActorHotPos &hot = ActorHotFields.Pos[cres.HotSlot];
+		x = hot.X;
+		y = hot.Y;
+		blockdist = hot.Radius + radius;
+	}
+	else
+	{
+		x = cres.thing->X();
+		y = cres.thing->Y();
+		blockdist = cres.thing->radius + radius;
+	}
+	return fabs(x - cres.Position.X) >= blockdist || fabs(y - cres.Position.Y) >= blockdist;
+}
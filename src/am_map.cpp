@@ -1851,12 +1851,12 @@ void AM_drawGrid (int color)
 
 	// Figure out start of vertical gridlines
 	start = minx - extx;
-	start = ceil((start - bmaporgx) / FBlockmap::MAPBLOCKUNITS) * FBlockmap::MAPBLOCKUNITS + bmaporgx;
+	start = ceil((start - bmaporgx) / level.blockmap.BlockSize) * level.blockmap.BlockSize + bmaporgx;
 
 	end = minx + minlen - extx;
 
 	// draw vertical gridlines
-	for (x = start; x < end; x += FBlockmap::MAPBLOCKUNITS)
+	for (x = start; x < end; x += level.blockmap.BlockSize)
 	{
 		ml.a.x = x;
 		ml.b.x = x;
@@ -1872,11 +1872,11 @@ void AM_drawGrid (int color)
 
 	// Figure out start of horizontal gridlines
 	start = miny - exty;
-	start = ceil((start - bmaporgy) / FBlockmap::MAPBLOCKUNITS) * FBlockmap::MAPBLOCKUNITS + bmaporgy;
+	start = ceil((start - bmaporgy) / level.blockmap.BlockSize) * level.blockmap.BlockSize + bmaporgy;
 	end = miny + minlen - exty;
 
 	// draw horizontal gridlines
-	for (y=start; y<end; y+=FBlockmap::MAPBLOCKUNITS)
+	for (y=start; y<end; y+=level.blockmap.BlockSize)
 	{
 		ml.a.x = minx - extx;
 		ml.b.x = ml.a.x + minlen;
@@ -56,6 +56,7 @@
 #include "p_spec.h"
 #include "p_checkposition.h"
 #include "actorinlines.h"
+#include "p_navigation.h"
 #include "math/cmath.h"
 
 static FRandom pr_botopendoor ("BotOpenDoor");
@@ -184,6 +185,7 @@ void DBot::NewChaseDir (ticcmd_t *cmd)
     turnaround = opposite[olddir];
 
 	DVector2 delta = player->mo->Vec2To(dest);
+	Navigation.GetChaseDelta(player->mo, dest, delta);
 
     if (delta.X > 10)
         d[1] = DI_EAST;
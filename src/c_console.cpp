@@ -841,6 +841,8 @@ void AddToConsole (int printlevel, const char *text)
 }
 
 /* Adds a string to the console and also to the notify buffer */
+static thread_local FConsoleCapture *ConsoleCapture;
+
 int PrintString (int printlevel, const char *outline)
 {
 	if (printlevel < msglevel || *outline == '\0')
@@ -848,6 +850,12 @@ int PrintString (int printlevel, const char *outline)
 		return 0;
 	}
 
+	if (ConsoleCapture != nullptr)
+	{
+		ConsoleCapture->Lines.Push({ printlevel, outline });
+		return (int)strlen(outline);
+	}
+
 	if (printlevel != PRINT_LOG)
 	{
 		I_PrintStr (outline);
@@ -869,6 +877,34 @@ int PrintString (int printlevel, const char *outline)
 
 extern bool gameisdead;
 
+//==========================================================================
+//
+// FConsoleCapture
+//
+//==========================================================================
+
+void FConsoleCapture::Start()
+{
+	Previous = ConsoleCapture;
+	ConsoleCapture = this;
+}
+
+void FConsoleCapture::Stop()
+{
+	assert(ConsoleCapture == this);
+	ConsoleCapture = Previous;
+	Previous = nullptr;
+}
+
+void FConsoleCapture::Flush()
+{
+	for (auto &line : Lines)
+	{
+		PrintString(line.PrintLevel, line.Text);
+	}
+	Lines.Clear();
+}
+
 int VPrintf (int printlevel, const char *format, va_list parms)
 {
 	if (gameisdead)
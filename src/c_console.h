@@ -36,6 +36,8 @@
 
 #include <stdarg.h>
 #include "basictypes.h"
+#include "zstring.h"
+#include "tarray.h"
 
 struct event_t;
 
@@ -87,4 +89,26 @@ void C_AddTabCommand (const char *name);
 void C_RemoveTabCommand (const char *name);
 void C_ClearTabCommands();		// Removes all tab commands
 
+// Collects everything the calling thread prints instead of outputting it.
+// Work that is split across threads uses this to report in a fixed order.
+class FConsoleCapture
+{
+public:
+	void Start();
+	void Stop();
+	void Flush();		// Prints everything collected so far
+	bool IsEmpty() const { return Lines.Size() == 0; }
+
+private:
+	struct FLine
+	{
+		int PrintLevel;
+		FString Text;
+	};
+	TArray<FLine> Lines;
+	FConsoleCapture *Previous = nullptr;
+
+	friend int PrintString (int printlevel, const char *string);
+};
+
 #endif
@@ -117,6 +117,7 @@
 #include "vm.h"
 #include "types.h"
 #include "r_data/r_vanillatrans.h"
+#include "g_benchmark.h"
 
 EXTERN_CVAR(Bool, hud_althud)
 void DrawHUD();
@@ -668,6 +669,12 @@ void D_Display ()
 
 	if (nodrawers || screen == NULL)
 		return; 				// for comparative timing / profiling
+
+	if (G_BenchmarkActive())
+	{
+		G_BenchmarkDrawFrame ();	// headless: render offscreen, never present
+		return;
+	}
 	
 	cycle_t cycles;
 	
@@ -1023,6 +1030,7 @@ void D_DoomLoop ()
 				I_StartFrame ();
 			}
 			I_SetFrameTime();
+			G_BenchmarkStartFrame ();
 
 			// process one or more tics
 			if (singletics)
@@ -1049,6 +1057,7 @@ void D_DoomLoop ()
 			// Update display, next frame, with current state.
 			I_StartTic ();
 			D_Display ();
+			G_BenchmarkEndFrame ();
 			if (wantToRestart)
 			{
 				wantToRestart = false;
@@ -2311,6 +2320,12 @@ void D_DoomMain (void)
 		Printf("\n");
 	}
 
+	// A headless benchmark must not depend on an audio device.
+	if (Args->CheckParm("-benchmark") && !Args->CheckParm("-nosound"))
+	{
+		Args->AppendArg("-nosound");
+	}
+
 	if (Args->CheckParm("-hashfiles"))
 	{
 		const char *filename = "fileinfo.txt";
@@ -184,6 +184,7 @@ protected: \
 #define _X_VMEXPORT_false(cls)		nullptr
 
 #include "dobjgc.h"
+#include "dobjpool.h"
 
 class DObject
 {
@@ -269,22 +270,23 @@ public:
 private:
 	struct nonew
 	{
+		int PoolGroup;
 	};
 
-	void *operator new(size_t len, nonew&)
+	void *operator new(size_t len, nonew &nono)
 	{
-		return M_Malloc(len);
+		return ObjectPool::Alloc(len, nono.PoolGroup);
 	}
 public:
 
 	void operator delete (void *mem, nonew&)
 	{
-		M_Free(mem);
+		ObjectPool::Free(mem);
 	}
 
 	void operator delete (void *mem)
 	{
-		M_Free(mem);
+		ObjectPool::Free(mem);
 	}
 
 	// GC fiddling
@@ -351,7 +353,7 @@ protected:
 
 	void operator delete (void *mem, EInPlace *)
 	{
-		M_Free (mem);
+		ObjectPool::Free (mem);
 	}
 
 	template<typename T, typename... Args>
@@ -359,12 +361,15 @@ protected:
 
 };
 
+class DThinker;
+class AActor;
+
 // This is the only method aside from calling CreateNew that should be used for creating DObjects
 // to ensure that the Class pointer is always set.
 template<typename T, typename... Args>
 T* Create(Args&&... args)
 {
-	DObject::nonew nono;
+	DObject::nonew nono = { std::is_base_of<AActor, T>::value ? OPG_Actor : std::is_base_of<DThinker, T>::value ? OPG_Thinker : OPG_Object };
 	T *object = new(nono) T(std::forward<Args>(args)...);
 	if (object != nullptr)
 	{
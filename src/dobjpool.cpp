@@ -0,0 +1,354 @@
+/*
+** dobjpool.cpp
+**
+** Size-bucketed slab allocator for DObjects
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <thread>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include "dobject.h"
+#include "dobjpool.h"
+#include "m_alloc.h"
+#include "tarray.h"
+#include "c_dispatch.h"
+#include "stats.h"
+
+#define SLABSHIFT		16
+#define SLABSIZE		(1 << SLABSHIFT)
+#define SLOTALIGN		16
+#define HEADERSIZE		SLOTALIGN	// holds the owning slab, keeps the object aligned
+#define MAXPOOLEDSIZE	4096
+#define NUMSIZECLASSES	(MAXPOOLEDSIZE / SLOTALIGN)
+
+namespace ObjectPool
+{
+
+//==========================================================================
+//
+// A slab occupies one SLABSIZE-aligned block, with this header at the
+// start and the slots after it. Every slot starts with a pointer to its
+// slab, so Free finds it directly. Oversized allocations get the same
+// header with a null pointer.
+//
+//==========================================================================
+
+struct FSlab
+{
+	FSlab *Prev, *Next;				// all slabs of the bucket
+	FSlab *PrevFree, *NextFree;		// slabs of the bucket with a free slot
+	void *FreeList;
+	unsigned SlotSize;
+	unsigned NumSlots;
+	unsigned NumUsed;
+	int Group;
+	int SizeClass;
+};
+
+struct FSlabBucket
+{
+	FSlab *Slabs = nullptr;
+	FSlab *FreeSlabs = nullptr;
+	unsigned NumSlabs = 0;
+	unsigned EmptySlabs = 0;
+};
+
+static FSlabBucket Buckets[NUM_OBJECTPOOLGROUPS][NUMSIZECLASSES];
+static size_t NumSlabs;
+static size_t SlabBytes;
+static size_t PooledBytes;
+static size_t OversizeCount;
+
+static const char *GroupNames[NUM_OBJECTPOOLGROUPS] = { "Object", "Thinker", "Actor" };
+
+//==========================================================================
+//
+// The pool has no lock. DObjects are only created and destroyed on the
+// game thread; the worker thread paths must not do either.
+//
+//==========================================================================
+
+static inline void CheckThread()
+{
+#ifndef NDEBUG
+	static std::thread::id PoolThread = std::this_thread::get_id();
+	assert(PoolThread == std::this_thread::get_id());
+#endif
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void *AllocSlabMemory()
+{
+#ifdef _WIN32
+	return _aligned_malloc(SLABSIZE, SLABSIZE);
+#else
+	void *mem;
+	return posix_memalign(&mem, SLABSIZE, SLABSIZE) == 0 ? mem : nullptr;
+#endif
+}
+
+static void FreeSlabMemory(void *mem)
+{
+#ifdef _WIN32
+	_aligned_free(mem);
+#else
+	free(mem);
+#endif
+}
+
+//==========================================================================
+//
+// Slab lists
+//
+//==========================================================================
+
+static void LinkFree(FSlabBucket &bucket, FSlab *slab)
+{
+	slab->PrevFree = nullptr;
+	slab->NextFree = bucket.FreeSlabs;
+	if (bucket.FreeSlabs != nullptr) bucket.FreeSlabs->PrevFree = slab;
+	bucket.FreeSlabs = slab;
+}
+
+static void UnlinkFree(FSlabBucket &bucket, FSlab *slab)
+{
+	if (slab->PrevFree != nullptr) slab->PrevFree->NextFree = slab->NextFree;
+	else bucket.FreeSlabs = slab->NextFree;
+	if (slab->NextFree != nullptr) slab->NextFree->PrevFree = slab->PrevFree;
+}
+
+//==========================================================================
+//
+// NewSlab
+//
+// Adds a slab to a bucket. The free list is built in address order so
+// that consecutive allocations are adjacent.
+//
+//==========================================================================
+
+static void NewSlab(FSlabBucket &bucket, int group, int sizeclass)
+{
+	FSlab *slab = (FSlab *)AllocSlabMemory();
+	if (slab == nullptr)
+	{
+		I_FatalError("Could not allocate %d bytes for object pool", SLABSIZE);
+	}
+	slab->SlotSize = (sizeclass + 1) * SLOTALIGN + HEADERSIZE;
+	slab->NumUsed = 0;
+	slab->Group = group;
+	slab->SizeClass = sizeclass;
+
+	uint8_t *first = (uint8_t *)slab + ((sizeof(FSlab) + SLOTALIGN - 1) & ~(SLOTALIGN - 1));
+	slab->NumSlots = unsigned(((uint8_t *)slab + SLABSIZE - first) / slab->SlotSize);
+	slab->FreeList = first;
+	for (unsigned i = 0; i < slab->NumSlots; i++)
+	{
+		uint8_t *slot = first + i * slab->SlotSize;
+		*(void **)slot = i + 1 < slab->NumSlots ? slot + slab->SlotSize : nullptr;
+	}
+
+	slab->Prev = nullptr;
+	slab->Next = bucket.Slabs;
+	if (bucket.Slabs != nullptr) bucket.Slabs->Prev = slab;
+	bucket.Slabs = slab;
+	LinkFree(bucket, slab);
+	bucket.NumSlabs++;
+	bucket.EmptySlabs++;
+	NumSlabs++;
+	SlabBytes += SLABSIZE;
+}
+
+//==========================================================================
+//
+// Alloc
+//
+//==========================================================================
+
+void *Alloc(size_t size, int group)
+{
+	CheckThread();
+	if (size > MAXPOOLEDSIZE || size == 0)
+	{
+		OversizeCount++;
+		uint8_t *block = (uint8_t *)M_Malloc(size + HEADERSIZE);
+		*(FSlab **)block = nullptr;
+		return block + HEADERSIZE;
+	}
+
+	int sizeclass = int((size - 1) / SLOTALIGN);
+	FSlabBucket &bucket = Buckets[group][sizeclass];
+
+	// Slabs that just had an object freed come first, so that their
+	// slots get reused before new memory is touched.
+	if (bucket.FreeSlabs == nullptr)
+	{
+		NewSlab(bucket, group, sizeclass);
+	}
+
+	FSlab *slab = bucket.FreeSlabs;
+	uint8_t *slot = (uint8_t *)slab->FreeList;
+	slab->FreeList = *(void **)slot;
+	*(FSlab **)slot = slab;
+	if (slab->FreeList == nullptr)
+	{
+		UnlinkFree(bucket, slab);
+	}
+	if (slab->NumUsed++ == 0)
+	{
+		bucket.EmptySlabs--;
+	}
+	GC::AllocBytes += slab->SlotSize;
+	PooledBytes += slab->SlotSize;
+	return slot + HEADERSIZE;
+}
+
+//==========================================================================
+//
+// Free
+//
+//==========================================================================
+
+void Free(void *mem)
+{
+	if (mem == nullptr)
+	{
+		return;
+	}
+	CheckThread();
+
+	uint8_t *slot = (uint8_t *)mem - HEADERSIZE;
+	FSlab *slab = *(FSlab **)slot;
+	if (slab == nullptr)
+	{
+		M_Free(slot);
+		return;
+	}
+
+	FSlabBucket &bucket = Buckets[slab->Group][slab->SizeClass];
+	if (slab->FreeList == nullptr)
+	{
+		LinkFree(bucket, slab);
+	}
+	*(void **)slot = slab->FreeList;
+	slab->FreeList = slot;
+	GC::AllocBytes -= slab->SlotSize;
+	PooledBytes -= slab->SlotSize;
+
+	if (--slab->NumUsed == 0)
+	{
+		// Keep one empty slab around so that a spawn/destroy cycle
+		// at the boundary doesn't keep allocating and freeing it.
+		if (++bucket.EmptySlabs > 1)
+		{
+			UnlinkFree(bucket, slab);
+			if (slab->Prev != nullptr) slab->Prev->Next = slab->Next;
+			else bucket.Slabs = slab->Next;
+			if (slab->Next != nullptr) slab->Next->Prev = slab->Prev;
+			bucket.NumSlabs--;
+			bucket.EmptySlabs--;
+			NumSlabs--;
+			SlabBytes -= SLABSIZE;
+			FreeSlabMemory(slab);
+		}
+	}
+}
+
+}
+
+//==========================================================================
+//
+// STAT objpool
+//
+// Shows how well the object pool's slabs are used. Occupancy is the part
+// of all slots that hold an object, sparse slabs are less than half full.
+//
+//==========================================================================
+
+ADD_STAT(objpool)
+{
+	using namespace ObjectPool;
+	FString out;
+	size_t sparse = 0, empty = 0;
+	for (auto &group : Buckets)
+	{
+		for (auto &bucket : group)
+		{
+			for (FSlab *slab = bucket.Slabs; slab != nullptr; slab = slab->Next)
+			{
+				if (slab->NumUsed * 2 < slab->NumSlots) sparse++;
+			}
+			empty += bucket.EmptySlabs;
+		}
+	}
+	out.Format("Slabs: %zu (%zuK)  Used: %zuK  Occupancy: %.1f%%  Sparse: %zu  Empty: %zu  Oversize: %zu",
+		NumSlabs, SlabBytes >> 10, PooledBytes >> 10,
+		SlabBytes > 0 ? PooledBytes * 100. / SlabBytes : 0., sparse, empty, OversizeCount);
+	return out;
+}
+
+//==========================================================================
+//
+// CCMD dumpobjpool
+//
+// Lists every size class that has slabs.
+//
+//==========================================================================
+
+CCMD(dumpobjpool)
+{
+	using namespace ObjectPool;
+	for (int g = 0; g < NUM_OBJECTPOOLGROUPS; g++)
+	{
+		for (int i = 0; i < NUMSIZECLASSES; i++)
+		{
+			FSlabBucket &bucket = Buckets[g][i];
+			if (bucket.NumSlabs == 0) continue;
+
+			unsigned used = 0, total = 0, sparse = 0;
+			for (FSlab *slab = bucket.Slabs; slab != nullptr; slab = slab->Next)
+			{
+				used += slab->NumUsed;
+				total += slab->NumSlots;
+				if (slab->NumUsed * 2 < slab->NumSlots) sparse++;
+			}
+			Printf("%-8s %5d bytes: %4u slabs, %6u/%6u slots used (%5.1f%%), %u sparse, %u empty\n",
+				GroupNames[g], (i + 1) * SLOTALIGN, bucket.NumSlabs, used, total,
+				used * 100. / total, sparse, bucket.EmptySlabs);
+		}
+	}
+}
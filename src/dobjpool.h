@@ -0,0 +1,59 @@
+/*
+** dobjpool.h
+**
+** Size-bucketed slab allocator for DObjects
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Objects are rounded up to a multiple of 16 bytes and carved out of 64k
+** slabs that only hold objects of one size. Actors, other thinkers and
+** everything else get separate slabs, so an actor's neighbours in memory
+** are other actors. New objects always go to the lowest slab with room,
+** which keeps the live objects packed together as others are freed.
+**
+*/
+
+#pragma once
+#include <stddef.h>
+
+enum EObjectPoolGroup
+{
+	OPG_Object,			// Anything that isn't a thinker
+	OPG_Thinker,		// Thinkers that aren't actors
+	OPG_Actor,
+
+	NUM_OBJECTPOOLGROUPS
+};
+
+namespace ObjectPool
+{
+	// Allocates memory for an object. Sizes too big for the pool come from M_Malloc.
+	void *Alloc(size_t size, int group);
+
+	// Frees memory returned by Alloc.
+	void Free(void *mem);
+}
@@ -452,7 +452,8 @@ PClass *PClass::FindClass (FName zaname)
 
 DObject *PClass::CreateNew()
 {
-	uint8_t *mem = (uint8_t *)M_Malloc (Size);
+	int group = IsDescendantOf(RUNTIME_CLASS(AActor)) ? OPG_Actor : IsDescendantOf(RUNTIME_CLASS(DThinker)) ? OPG_Thinker : OPG_Object;
+	uint8_t *mem = (uint8_t *)ObjectPool::Alloc (Size, group);
 	assert (mem != nullptr);
 
 	// Set this object's defaults before constructing it.
@@ -463,7 +464,7 @@ DObject *PClass::CreateNew()
 
 	if (ConstructNative == nullptr)
 	{
-		M_Free(mem);
+		ObjectPool::Free(mem);
 		I_Error("Attempt to instantiate abstract class %s.", TypeName.GetChars());
 	}
 	ConstructNative (mem);
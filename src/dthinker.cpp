@@ -37,18 +37,34 @@
 #include "p_local.h"
 #include "statnums.h"
 #include "i_system.h"
+#include "doomstat.h"
 #include "doomerrors.h"
 #include "serializer.h"
 #include "d_player.h"
 #include "vm.h"
+#include "c_cvars.h"
+#include "g_levellocals.h"
+#include "jobsystem.h"
 
 
 static int ThinkCount;
-static cycle_t ThinkCycles;
+cycle_t ThinkCycles;
 extern cycle_t BotSupportCycles;
 extern cycle_t ActionCycles;
 extern int BotWTG;
 
+// Tick the independent scroller and light thinkers on the job system.
+// Demos play back with it, so that the checksum in the -benchmark report
+// can be compared with it on and off. Until that comparison has been run
+// on the IWAD demos it is not in the menus, and it stays off while a demo
+// is recorded and in netgames, where any difference would desync.
+CVAR(Bool, p_parallelthinkers, false, 0)
+
+static bool ParallelThinkersAllowed()
+{
+	return p_parallelthinkers && !netgame && !demorecording;
+}
+
 IMPLEMENT_CLASS(DThinker, false, false)
 
 DThinker *NextToThink;
@@ -495,6 +511,11 @@ void DThinker::RunThinkers ()
 		// Tick every thinker left from last time
 		for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
 		{
+			if ((i == STAT_SCROLLER || i == STAT_LIGHT) && ParallelThinkersAllowed() &&
+				TickIndependentThinkers(&Thinkers[i]))
+			{
+				continue;
+			}
 			TickThinkers(&Thinkers[i], NULL);
 		}
 
@@ -585,6 +606,152 @@ int DThinker::TickThinkers (FThinkerList *list, FThinkerList *dest)
 	return count;
 }
 
+//==========================================================================
+//
+// Ticks a list whose thinkers report tick keys in parallel.
+//
+// Thinkers are grouped by the level element they modify. Each group is
+// ticked in list order on one worker, so a sector or sidedef sees exactly
+// the same sequence of changes as when ticking serially. Any key that is
+// also used by a thinker which has to stay on the main thread is left out
+// of the parallel phase; those thinkers run afterwards, again in list
+// order. Returns false without ticking anything if the list cannot be
+// split, in which case the caller ticks it serially.
+//
+//==========================================================================
+
+enum
+{
+	MIN_PARALLEL_TICK_GROUPS = 64,
+	TICKKEY_FREE = -1,
+	TICKKEY_SERIAL = -2,
+};
+
+static TArray<DThinker *> TickNodes;
+static TArray<int> TickNodeKeys;		// key of every node, -1 for thinkers scheduled for destruction
+static TArray<int> TickNodeGroups;		// group of every node, -1 for the serial ones
+static TArray<int> TickKeyGroups;		// group of every key, or one of the TICKKEY values
+static TArray<int> TickGroupStart;
+static TArray<DThinker *> TickGroupNodes;
+
+static void ResetTickKeys()
+{
+	for (unsigned i = 0; i < TickNodeKeys.Size(); i++)
+	{
+		if (TickNodeKeys[i] >= 0) TickKeyGroups[TickNodeKeys[i]] = TICKKEY_FREE;
+	}
+	TickNodes.Clear();
+	TickNodeKeys.Clear();
+	TickNodeGroups.Clear();
+}
+
+bool DThinker::TickIndependentThinkers(FThinkerList *list)
+{
+	DThinker *node = list->GetHead();
+	if (node == NULL)
+	{
+		return true;
+	}
+
+	int numkeys = level.sectors.Size() + level.sides.Size();
+	if ((int)TickKeyGroups.Size() != numkeys)
+	{
+		TickKeyGroups.Resize(numkeys);
+		for (auto &group : TickKeyGroups) group = TICKKEY_FREE;
+	}
+
+	// Collect the keys and block the ones used by main thread thinkers.
+	for (; node != list->Sentinel; node = node->NextThinker)
+	{
+		bool parallel = false;
+		int key = -1;
+
+		if (node->ObjectFlags & OF_JustSpawned)
+		{
+			ResetTickKeys();
+			return false;
+		}
+		if (!(node->ObjectFlags & OF_EuthanizeMe))
+		{
+			key = node->GetClass()->bRuntimeClass ? -1 : node->GetTickKey(parallel);
+			if (key < 0 || key >= numkeys)
+			{
+				ResetTickKeys();
+				return false;
+			}
+			if (!parallel) TickKeyGroups[key] = TICKKEY_SERIAL;
+		}
+		TickNodes.Push(node);
+		TickNodeKeys.Push(key);
+		TickNodeGroups.Push(parallel ? 0 : -1);
+	}
+
+	int numgroups = 0;
+	for (unsigned i = 0; i < TickNodes.Size(); i++)
+	{
+		if (TickNodeGroups[i] < 0) continue;
+
+		int &group = TickKeyGroups[TickNodeKeys[i]];
+		if (group == TICKKEY_FREE) group = numgroups++;
+		TickNodeGroups[i] = group;	// TICKKEY_SERIAL is negative, too
+	}
+	if (numgroups < MIN_PARALLEL_TICK_GROUPS)
+	{
+		ResetTickKeys();
+		return false;
+	}
+
+	// Sort the nodes by group without changing their order within a group.
+	TickGroupStart.Resize(numgroups + 1);
+	for (auto &start : TickGroupStart) start = 0;
+	for (auto group : TickNodeGroups)
+	{
+		if (group >= 0) TickGroupStart[group + 1]++;
+	}
+	for (int i = 0; i < numgroups; i++)
+	{
+		TickGroupStart[i + 1] += TickGroupStart[i];
+	}
+	int numparallel = TickGroupStart[numgroups];
+	TickGroupNodes.Resize(numparallel);
+	for (unsigned i = 0; i < TickNodes.Size(); i++)
+	{
+		int group = TickNodeGroups[i];
+		if (group >= 0) TickGroupNodes[TickGroupStart[group]++] = TickNodes[i];
+	}
+	// The fill loop advanced every start to the next group's start.
+	for (int i = numgroups; i > 0; i--)
+	{
+		TickGroupStart[i] = TickGroupStart[i - 1];
+	}
+	TickGroupStart[0] = 0;
+
+	FJobSystem::Instance()->ParallelFor(0, numgroups, [](int group)
+	{
+		for (int i = TickGroupStart[group]; i < TickGroupStart[group + 1]; i++)
+		{
+			TickGroupNodes[i]->Tick();
+		}
+	});
+	ThinkCount += numparallel;
+
+	// The objects cannot be collected before the end of this function,
+	// so the node list remains valid even if some get destroyed here.
+	NextToThink = NULL;
+	for (unsigned i = 0; i < TickNodes.Size(); i++)
+	{
+		node = TickNodes[i];
+		if (TickNodeGroups[i] < 0 && !(node->ObjectFlags & OF_EuthanizeMe))
+		{
+			ThinkCount++;
+			node->CallTick();
+		}
+	}
+	ResetTickKeys();
+	GC::CheckGC();
+	return true;
+}
+
 //==========================================================================
 //
 //
@@ -73,6 +73,10 @@ public:
 	virtual void PostBeginPlay ();	// Called just before the first tick
 	virtual void CallPostBeginPlay(); // different in actor.
 	virtual void PostSerialize();
+	// Returns the tick key of the only level element Tick() modifies, or -1 if
+	// that is not known. parallel is set if Tick() touches nothing but that
+	// element and the thinker itself, so that it may run on a worker thread.
+	virtual int GetTickKey(bool &parallel) const { return -1; }
 	size_t PropagateMark();
 	
 	void ChangeStatNum (int statnum);
@@ -98,6 +102,7 @@ private:
 	static void DestroyThinkersInList (FThinkerList &list);
 	static int TickThinkers (FThinkerList *list, FThinkerList *dest);	// Returns: # of thinkers ticked
 	static int ProfileThinkers(FThinkerList *list, FThinkerList *dest);
+	static bool TickIndependentThinkers(FThinkerList *list);
 	static void SaveList(FSerializer &arc, DThinker *node);
 	void Remove();
 
@@ -36,6 +36,14 @@
 // This also pulls in windows.h
 #include "LzmaDec.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <limits.h>
+
 #include "files.h"
 #include "i_system.h"
 #include "templates.h"
@@ -543,6 +551,84 @@ char *MemoryReader::Gets(char *strbuf, int len)
 	return GetsFromBuffer(bufptr, strbuf, len);
 }
 
+//==========================================================================
+//
+// MappedFileReader
+//
+// The mapping covers the entire file, so this is only used for 64 bit
+// builds where address space is not an issue.
+//
+//==========================================================================
+
+#ifdef _WIN32
+
+MappedFileReader *MappedFileReader::Open(const char *filename)
+{
+	if (sizeof(void*) < 8) return NULL;
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return NULL;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	const char *buffer = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < LONG_MAX)
+	{
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL)
+		{
+			buffer = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (buffer == NULL)
+			{
+				CloseHandle(mapping);
+			}
+		}
+	}
+	// The mapping keeps the file open.
+	CloseHandle(file);
+	if (buffer == NULL) return NULL;
+	return new MappedFileReader(buffer, (long)size.QuadPart, mapping);
+}
+
+MappedFileReader::~MappedFileReader()
+{
+	UnmapViewOfFile(bufptr);
+	CloseHandle((HANDLE)MapHandle);
+}
+
+#else
+
+MappedFileReader *MappedFileReader::Open(const char *filename)
+{
+	if (sizeof(void*) < 8) return NULL;
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return NULL;
+
+	struct stat info;
+	void *buffer = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && info.st_size < LONG_MAX)
+	{
+		buffer = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	// The mapping stays valid after closing the descriptor.
+	close(fd);
+	if (buffer == MAP_FAILED) return NULL;
+	return new MappedFileReader((const char *)buffer, (long)info.st_size, NULL);
+}
+
+MappedFileReader::~MappedFileReader()
+{
+	munmap((void *)bufptr, Length);
+}
+
+#endif
+
+MappedFileReader::MappedFileReader(const char *buffer, long length, void *handle)
+: MemoryReader(buffer, length), MapHandle(handle)
+{
+}
+
 //==========================================================================
 //
 // MemoryArrayReader
@@ -390,6 +390,21 @@ protected:
     TArray<uint8_t> buf;
 };
 
+// Maps a whole file read-only into memory. Lumps of uncompressed archives
+// opened through this can be used in place without being copied.
+class MappedFileReader : public MemoryReader
+{
+public:
+	// Returns NULL if the file cannot be mapped.
+	static MappedFileReader *Open(const char *filename);
+	~MappedFileReader();
+
+private:
+	MappedFileReader(const char *buffer, long length, void *handle);
+
+	void *MapHandle;
+};
+
 
 class FileWriter
 {
@@ -2921,7 +2921,7 @@ void FParser::SF_MoveCamera(void)
 				targetangle = cam->Angles.Yaw + anglespeed;
 			}
 
-			cam->radius = 1 / 8192.;
+			cam->SetRadius(1 / 8192.);
 			cam->Height = 1 / 8192.;
 			cam->SetOrigin(movepos, true);
 			t_return.value.i = 1;
@@ -3455,7 +3455,7 @@ void FParser::SF_Resurrect()
 
 		mo->SetState(state);
 		mo->Height = mo->GetDefault()->Height;
-		mo->radius = mo->GetDefault()->radius;
+		mo->SetRadius(mo->GetDefault()->radius);
 		mo->Revive();
 		mo->target = NULL;
 	}
@@ -3739,7 +3739,7 @@ void FParser::SF_MobjRadius(void)
 		if(t_argc > 1)
 		{
 			if(mo) 
-				mo->radius = floatvalue(t_argv[1]);
+				mo->SetRadius(floatvalue(t_argv[1]));
 		}
 		t_return.setDouble(mo ? mo->radius : 0.);
 	}
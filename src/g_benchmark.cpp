@@ -0,0 +1,429 @@
+/*
+** g_benchmark.cpp
+**
+** Headless timedemo benchmarking with a per-subsystem frame breakdown
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** A benchmark run is a timedemo started with -benchmark on the command line.
+** The window stays hidden, sound is disabled and the view is rendered into
+** an offscreen canvas, so the numbers only contain playsim and renderer work.
+** When the demo ends a JSON report is written to the file given after
+** -benchmark (or to the console if none was given) and the program exits.
+**
+*/
+
+#include <math.h>
+#include <algorithm>
+
+#include "templates.h"
+#include "doomstat.h"
+#include "d_player.h"
+#include "g_benchmark.h"
+#include "g_game.h"
+#include "m_argv.h"
+#include "files.h"
+#include "stats.h"
+#include "v_video.h"
+#include "r_renderer.h"
+#include "r_utility.h"
+#include "textures/textures.h"
+#include "i_system.h"
+#include "m_crc32.h"
+#include "g_levellocals.h"
+#include "actor.h"
+#include "swrenderer/drawers/r_thread.h"
+
+extern cycle_t TickerCycles;
+extern cycle_t ThinkCycles;
+extern cycle_t VMCycles[10];
+
+namespace swrenderer
+{
+	extern cycle_t WallCycles, PlaneCycles, MaskedCycles, DrawerWaitCycles;
+}
+
+enum EBenchSubsystem
+{
+	BENCH_Frame,
+	BENCH_Ticker,
+	BENCH_Thinkers,
+	BENCH_VM,
+	BENCH_Render,
+	BENCH_Walls,
+	BENCH_Planes,
+	BENCH_Masked,
+	BENCH_DrawerWait,
+	BENCH_DrawerThreads,
+
+	NUM_BENCH
+};
+
+static const char *BenchNames[NUM_BENCH] =
+{
+	"Frame",
+	"P_Ticker",
+	"DThinker::RunThinkers",
+	"VMCall",
+	"RenderView",
+	"SW.Walls",
+	"SW.Planes",
+	"SW.Masked",
+	"SW.DrawerWait",
+	"DrawerThreads"
+};
+
+struct FBenchFrame
+{
+	float Time[NUM_BENCH];
+};
+
+static bool Benchmarking;
+static bool BenchRendered;
+static bool BenchRecording;
+static bool BenchStarted;
+static FString BenchDemo;
+static FString BenchReport;
+static TArray<FBenchFrame> BenchFrames;
+static cycle_t BenchFrameCycles;
+static cycle_t BenchRenderCycles;
+static cycle_t BenchTotalCycles;
+static double BenchVMStart;
+static DSimpleCanvas *BenchCanvas;
+
+//==========================================================================
+//
+// G_BenchmarkInit
+//
+// Called from G_TimeDemo. Does nothing unless -benchmark was given.
+//
+//==========================================================================
+
+void G_BenchmarkInit (const char *demoname)
+{
+	if (!Args->CheckParm("-benchmark"))
+	{
+		return;
+	}
+	const char *report = Args->CheckValue("-benchmark");
+
+	Benchmarking = true;
+	BenchRecording = false;
+	BenchStarted = false;
+	BenchDemo = demoname;
+	BenchReport = report != NULL ? report : "";
+	BenchFrames.Clear();
+	BenchTotalCycles.Reset();
+	nodrawers = false;
+}
+
+bool G_BenchmarkActive ()
+{
+	return Benchmarking;
+}
+
+//==========================================================================
+//
+// G_BenchmarkStartFrame
+//
+// One frame is one pass through D_DoomLoop: a single tic followed by
+// the display update. Only frames spent inside a level are recorded.
+//
+//==========================================================================
+
+void G_BenchmarkStartFrame ()
+{
+	if (!Benchmarking)
+	{
+		return;
+	}
+	BenchRecording = gamestate == GS_LEVEL;
+	if (!BenchRecording)
+	{
+		return;
+	}
+	if (!BenchStarted)
+	{
+		BenchTotalCycles.Clock();
+		BenchStarted = true;
+	}
+	BenchRendered = false;
+	BenchRenderCycles.Reset();
+	DrawerThreads::ResetBusyTime();
+	BenchVMStart = VMCycles[0].TimeMS();
+	BenchFrameCycles.Reset();
+	BenchFrameCycles.Clock();
+}
+
+void G_BenchmarkEndFrame ()
+{
+	if (!Benchmarking || !BenchRecording)
+	{
+		return;
+	}
+	BenchFrameCycles.Unclock();
+
+	FBenchFrame frame;
+	frame.Time[BENCH_Frame] = (float)BenchFrameCycles.TimeMS();
+	frame.Time[BENCH_Ticker] = (float)TickerCycles.TimeMS();
+	frame.Time[BENCH_Thinkers] = (float)ThinkCycles.TimeMS();
+	frame.Time[BENCH_VM] = (float)(VMCycles[0].TimeMS() - BenchVMStart);
+	frame.Time[BENCH_Render] = (float)BenchRenderCycles.TimeMS();
+	if (BenchRendered)
+	{
+		frame.Time[BENCH_Walls] = (float)swrenderer::WallCycles.TimeMS();
+		frame.Time[BENCH_Planes] = (float)swrenderer::PlaneCycles.TimeMS();
+		frame.Time[BENCH_Masked] = (float)swrenderer::MaskedCycles.TimeMS();
+		frame.Time[BENCH_DrawerWait] = (float)swrenderer::DrawerWaitCycles.TimeMS();
+		frame.Time[BENCH_DrawerThreads] = (float)DrawerThreads::GetBusyTimeMS();
+	}
+	else
+	{
+		for (int i = BENCH_Walls; i <= BENCH_DrawerThreads; i++)
+		{
+			frame.Time[i] = 0.f;
+		}
+	}
+	BenchFrames.Push(frame);
+	BenchRecording = false;
+}
+
+//==========================================================================
+//
+// G_BenchmarkDrawFrame
+//
+// Replaces D_Display during a benchmark: renders the console player's
+// view into an offscreen canvas and never presents anything.
+//
+//==========================================================================
+
+void G_BenchmarkDrawFrame ()
+{
+	if (gamestate != GS_LEVEL || !gametic || screen == NULL)
+	{
+		return;
+	}
+
+	player_t *player = &players[consoleplayer];
+	if (player->camera == NULL)
+	{
+		player->camera = player->mo;
+	}
+	if (player->camera == NULL)
+	{
+		return;
+	}
+
+	if (BenchCanvas == NULL || BenchCanvas->GetWidth() != screen->GetWidth() ||
+		BenchCanvas->GetHeight() != screen->GetHeight() || BenchCanvas->IsBgra() != screen->IsBgra())
+	{
+		delete BenchCanvas;
+		BenchCanvas = new DSimpleCanvas(screen->GetWidth(), screen->GetHeight(), screen->IsBgra());
+	}
+
+	BenchRenderCycles.Clock();
+	R_SetFOV (r_viewpoint, player->camera->player ? player->camera->player->FOV : 90.f);
+	// Animate by game time so that every run renders the same frames.
+	TexMan.UpdateAnimations(uint32_t(level.maptime * 1000 / TICRATE));
+	BenchCanvas->Lock();
+	BenchRendered = Renderer->RenderViewToCanvas(player, BenchCanvas);
+	BenchCanvas->Unlock();
+	BenchRenderCycles.Unclock();
+}
+
+//==========================================================================
+//
+// Report generation
+//
+//==========================================================================
+
+struct FBenchSummary
+{
+	double Total, Mean, Min, Max, P50, P90, P95, P99;
+};
+
+static double Percentile (const TArray<float> &sorted, double pct)
+{
+	if (sorted.Size() == 0)
+	{
+		return 0;
+	}
+	// nearest-rank method
+	unsigned rank = (unsigned)ceil(pct / 100. * sorted.Size());
+	return sorted[clamp<unsigned>(rank, 1, sorted.Size()) - 1];
+}
+
+static FBenchSummary Summarize (int subsystem)
+{
+	FBenchSummary sum = {};
+	TArray<float> times;
+
+	times.Resize(BenchFrames.Size());
+
+	for (unsigned i = 0; i < BenchFrames.Size(); i++)
+	{
+		times[i] = BenchFrames[i].Time[subsystem];
+		sum.Total += times[i];
+	}
+	if (times.Size() > 0)
+	{
+		std::sort(&times[0], &times[0] + times.Size());
+		sum.Mean = sum.Total / times.Size();
+		sum.Min = times[0];
+		sum.Max = times.Last();
+		sum.P50 = Percentile(times, 50);
+		sum.P90 = Percentile(times, 90);
+		sum.P95 = Percentile(times, 95);
+		sum.P99 = Percentile(times, 99);
+	}
+	return sum;
+}
+
+static FString JsonEscape (const char *str)
+{
+	FString out;
+	for (; *str != 0; str++)
+	{
+		if (*str == '"' || *str == '\\') out += '\\';
+		if ((unsigned char)*str >= ' ') out += *str;
+	}
+	return out;
+}
+
+//==========================================================================
+//
+// WorldChecksum
+//
+// Hashes what the thinkers change, so that two runs of the same demo can
+// be compared, e.g. with p_parallelthinkers on and off.
+//
+//==========================================================================
+
+static uint32_t WorldChecksum ()
+{
+	uint32_t crc = 0;
+	auto add = [&crc](const void *data, size_t size)
+	{
+		crc = AddCRC32(crc, (const uint8_t *)data, (unsigned)size);
+	};
+
+	for (auto &sec : level.sectors)
+	{
+		double values[] = { sec.floorplane.fD(), sec.ceilingplane.fD(),
+			sec.planes[sector_t::floor].xform.xOffs, sec.planes[sector_t::floor].xform.yOffs,
+			sec.planes[sector_t::ceiling].xform.xOffs, sec.planes[sector_t::ceiling].xform.yOffs };
+		add(values, sizeof(values));
+		add(&sec.lightlevel, sizeof(sec.lightlevel));
+	}
+	for (auto &side : level.sides)
+	{
+		for (auto &part : side.textures)
+		{
+			add(&part.xOffset, sizeof(part.xOffset));
+			add(&part.yOffset, sizeof(part.yOffset));
+		}
+	}
+	TThinkerIterator<AActor> it;
+	AActor *mo;
+	while ((mo = it.Next()))
+	{
+		double values[] = { mo->X(), mo->Y(), mo->Z(), mo->Vel.X, mo->Vel.Y, mo->Vel.Z, mo->Angles.Yaw.Degrees };
+		add(values, sizeof(values));
+		add(&mo->health, sizeof(mo->health));
+	}
+	return crc;
+}
+
+static FString BuildReport (int gametics, double seconds)
+{
+	FString out;
+	int frames = BenchFrames.Size();
+
+	out.AppendFormat("{\n");
+	out.AppendFormat("\t\"demo\": \"%s\",\n", JsonEscape(BenchDemo).GetChars());
+	out.AppendFormat("\t\"gametics\": %d,\n", gametics);
+	out.AppendFormat("\t\"frames\": %d,\n", frames);
+	out.AppendFormat("\t\"seconds\": %.6f,\n", seconds);
+	out.AppendFormat("\t\"ticspersec\": %.3f,\n", seconds > 0 ? frames / seconds : 0.);
+	out.AppendFormat("\t\"width\": %d,\n", BenchCanvas != NULL ? BenchCanvas->GetWidth() : 0);
+	out.AppendFormat("\t\"height\": %d,\n", BenchCanvas != NULL ? BenchCanvas->GetHeight() : 0);
+	out.AppendFormat("\t\"truecolor\": %s,\n", BenchCanvas != NULL && BenchCanvas->IsBgra() ? "true" : "false");
+	out.AppendFormat("\t\"checksum\": \"%08x\",\n", WorldChecksum());
+	out.AppendFormat("\t\"subsystems\": {\n");
+	for (int i = 0; i < NUM_BENCH; i++)
+	{
+		FBenchSummary sum = Summarize(i);
+		out.AppendFormat("\t\t\"%s\": { \"total\": %.4f, \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			BenchNames[i], sum.Total, sum.Mean, sum.Min, sum.P50, sum.P90, sum.P95, sum.P99, sum.Max, i < NUM_BENCH - 1 ? "," : "");
+	}
+	out.AppendFormat("\t}\n");
+	out.AppendFormat("}\n");
+	return out;
+}
+
+//==========================================================================
+//
+// G_BenchmarkFinish
+//
+// Called from G_CheckDemoStatus when the timed demo ends. Does not return.
+//
+//==========================================================================
+
+void G_BenchmarkFinish (int gametics)
+{
+	if (BenchStarted)
+	{
+		BenchTotalCycles.Unclock();
+	}
+	double seconds = BenchTotalCycles.Time();
+	FString report = BuildReport(gametics, seconds);
+
+	if (BenchReport.IsNotEmpty())
+	{
+		FileWriter *fw = FileWriter::Open(BenchReport);
+		if (fw == NULL)
+		{
+			I_FatalError("Could not write benchmark report %s", BenchReport.GetChars());
+		}
+		fw->Write(report.GetChars(), report.Len());
+		delete fw;
+		Printf("Benchmark report written to %s\n", BenchReport.GetChars());
+	}
+	else
+	{
+		Printf("%s", report.GetChars());
+	}
+
+	FBenchSummary frame = Summarize(BENCH_Frame);
+	Printf("timed %d gametics in %.3f seconds (%.1f tics/sec, p99 frame %.2f ms)\n",
+		BenchFrames.Size(), seconds, seconds > 0 ? BenchFrames.Size() / seconds : 0., frame.P99);
+
+	delete BenchCanvas;
+	BenchCanvas = NULL;
+	Benchmarking = false;
+	exit(0);
+}
@@ -0,0 +1,13 @@
+#ifndef __G_BENCHMARK_H
+#define __G_BENCHMARK_H
+
+// Headless timedemo benchmarking (-timedemo <demo> -benchmark [report])
+
+void G_BenchmarkInit (const char *demoname);
+bool G_BenchmarkActive ();
+void G_BenchmarkStartFrame ();
+void G_BenchmarkEndFrame ();
+void G_BenchmarkDrawFrame ();
+void G_BenchmarkFinish (int gametics);
+
+#endif
@@ -28,6 +28,8 @@
 #include <stddef.h>
 #include <time.h>
 #include <memory>
+#include <thread>
+#include <atomic>
 #ifdef __APPLE__
 #include <CoreServices/CoreServices.h>
 #endif
@@ -90,6 +92,7 @@
 #include <zlib.h>
 
 #include "g_hub.h"
+#include "g_benchmark.h"
 #include "g_levellocals.h"
 #include "events.h"
 
@@ -119,6 +122,8 @@ bool WriteZip(const char *filename, TArray<FString> &filenames, TArray<FCompress
 
 FIntCVar gameskill ("skill", 2, CVAR_SERVERINFO|CVAR_LATCH);
 CVAR(Bool, save_formatted, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// use formatted JSON for saves (more readable but a larger files and a bit slower.
+CVAR(Bool, save_binary, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// use the binary format for the level and globals data. Much faster to write but not human readable.
+CVAR(Bool, save_async, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// compress and write savegames on a separate thread.
 CVAR (Int, deathmatch, 0, CVAR_SERVERINFO|CVAR_LATCH);
 CVAR (Bool, chasedemo, false, 0);
 CVAR (Bool, storesavepic, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
@@ -1049,6 +1054,9 @@ void G_Ticker ()
 	int i;
 	gamestate_t	oldgamestate;
 
+	// report a savegame that finished writing in the background
+	G_FinishPendingSave(false);
+
 	// do player reborns if needed
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
@@ -1749,6 +1757,7 @@ void G_DoReborn (int playernum, bool freshbot)
 {
 	if (!multiplayer && !(level.flags2 & LEVEL2_ALLOWRESPAWN) && !sv_singleplayerrespawn)
 	{
+		G_FinishPendingSave(true);
 		if (BackupSaveName.Len() > 0 && FileExists (BackupSaveName.GetChars()))
 		{ // Load game from the last point it was saved
 			savename = BackupSaveName;
@@ -1933,6 +1942,9 @@ void G_DoLoadGame ()
 	hidecon = gameaction == ga_loadgamehidecon;
 	gameaction = ga_nothing;
 
+	// The savegame may still be written in the background.
+	G_FinishPendingSave(true);
+
 	std::unique_ptr<FResourceFile> resfile(FResourceFile::OpenResourceFile(savename.GetChars(), nullptr, true, true));
 	if (resfile == nullptr)
 	{
@@ -2251,6 +2263,91 @@ static void PutSavePic (FileWriter *file, int width, int height)
 	}
 }
 
+//==========================================================================
+//
+// Asynchronous saving
+//
+// The game thread only serializes the game into memory. Compressing the
+// data and writing the zip happen on a separate thread. Its completion
+// gets reported from G_Ticker through G_FinishPendingSave.
+//
+//==========================================================================
+
+struct FPendingSave
+{
+	std::thread Thread;
+	std::atomic<bool> Done { false };
+	bool Success = false;
+	bool OkForQuicksave;
+	FString Filename;
+	FString Description;
+	TArray<FString> Filenames;
+	TArray<FCompressedBuffer> Content;	// all owned by this, only the picture is not compressed yet
+};
+
+static FPendingSave *PendingSave;
+
+#ifdef _WIN32
+extern "C" __declspec(dllimport) int __stdcall MoveFileExA(const char *lpExistingFileName, const char *lpNewFileName, unsigned long dwFlags);
+#endif
+
+// Moves the finished file over the old one in a single step, so that a
+// crash never leaves the player without a complete savegame.
+static bool ReplaceSaveFile (const char *from, const char *to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, 1 /* MOVEFILE_REPLACE_EXISTING */) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+static void WriteSaveGame (FPendingSave *save)
+{
+	for (unsigned i = 1; i < save->Content.Size(); i++)
+	{
+		save->Content[i].Compress();
+	}
+
+	// Write to a temporary file first so that nobody can see a partial savegame.
+	FString tempname = save->Filename + ".tmp";
+	if (WriteZip(tempname, save->Filenames, save->Content))
+	{
+		save->Success = ReplaceSaveFile(tempname.GetChars(), save->Filename.GetChars());
+	}
+	for (auto &buff : save->Content)
+	{
+		buff.Clean();
+	}
+	save->Done.store(true, std::memory_order_release);
+}
+
+static void G_WaitForPendingSave ()
+{
+	// Only make sure the file is complete. It's too late to report anything.
+	if (PendingSave != nullptr)
+	{
+		PendingSave->Thread.join();
+		delete PendingSave;
+		PendingSave = nullptr;
+	}
+}
+
+static void ReportSaveGame (const FString &filename, const FString &description, bool okForQuicksave)
+{
+	savegameManager.NotifyNewSave (filename, description, okForQuicksave);
+
+	// Check whether the file is ok by trying to open it.
+	FResourceFile *test = FResourceFile::OpenResourceFile(filename, nullptr, true);
+	if (test != nullptr)
+	{
+		delete test;
+		if (longsavemessages) Printf ("%s (%s)\n", GStrings("GGSAVED"), filename.GetChars());
+		else Printf ("%s\n", GStrings("GGSAVED"));
+	}
+	else Printf(PRINT_HIGH, "Save failed\n");
+}
+
 void G_DoSaveGame (bool okForQuicksave, FString filename, const char *description)
 {
 	TArray<FCompressedBuffer> savegame_content;
@@ -2270,13 +2367,25 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 		filename = G_BuildSaveName ("demosave." SAVEGAME_EXT, -1);
 	}
 
+	// Only one save can be written at a time.
+	G_FinishPendingSave(true);
+	if (save_async)
+	{
+		static bool registered;
+		if (!registered)
+		{
+			atterm(G_WaitForPendingSave);
+			registered = true;
+		}
+	}
+
 	if (cl_waitforsave)
 		I_FreezeTime(true);
 
 	insave = true;
 	try
 	{
-		G_SnapshotLevel();
+		G_SnapshotLevel(!save_async);
 	}
 	catch(CRecoverableError &err)
 	{
@@ -2303,7 +2412,8 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 	FSerializer savegameglobals;	// and this for non-level related info that must be saved.
 
 	savegameinfo.OpenWriter(true);
-	savegameglobals.OpenWriter(save_formatted);
+	if (save_binary) savegameglobals.OpenBinaryWriter();
+	else savegameglobals.OpenWriter(save_formatted);
 
 	SaveVersion = SAVEVER;
 	PutSavePic(&savepic, SAVEPICWIDTH, SAVEPICHEIGHT);
@@ -2355,6 +2465,48 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 	auto picdata = savepic.GetBuffer();
 	FCompressedBuffer bufpng = { picdata->Size(), picdata->Size(), METHOD_STORED, 0, static_cast<unsigned int>(crc32(0, &(*picdata)[0], picdata->Size())), (char*)&(*picdata)[0] };
 
+	if (save_async)
+	{
+		// Everything the writer thread needs gets copied or handed over, so that
+		// the game can go on and change the snapshots while the file is written.
+		auto save = new FPendingSave;
+		save->Filename = filename;
+		save->Description = description;
+		save->OkForQuicksave = okForQuicksave;
+
+		bufpng.mBuffer = (char*)memcpy(new char[bufpng.mSize], bufpng.mBuffer, bufpng.mSize);
+		save->Content.Push(bufpng);
+		save->Filenames.Push("savepic.png");
+		save->Content.Push(savegameinfo.GetStoredOutput());
+		save->Filenames.Push("info.json");
+		save->Content.Push(savegameglobals.GetStoredOutput());
+		save->Filenames.Push("globals.json");
+
+		unsigned first = save->Content.Size();
+		G_WriteSnapshots (save->Filenames, save->Content);
+		for (unsigned i = first; i < save->Content.Size(); i++)
+		{
+			auto &buff = save->Content[i];
+			if (buff.mBuffer == level.info->Snapshot.mBuffer)
+			{
+				// The current level's snapshot is only needed by the save.
+				level.info->Snapshot.mBuffer = nullptr;
+				level.info->Snapshot.mSize = level.info->Snapshot.mCompressedSize = 0;
+			}
+			else
+			{
+				buff.mBuffer = (char*)memcpy(new char[buff.mCompressedSize], buff.mBuffer, buff.mCompressedSize);
+			}
+		}
+		PendingSave = save;
+		save->Thread = std::thread(WriteSaveGame, save);
+
+		BackupSaveName = filename;
+		insave = false;
+		I_FreezeTime(false);
+		return;
+	}
+
 	savegame_content.Push(bufpng);
 	savegame_filenames.Push("savepic.png");
 	savegame_content.Push(savegameinfo.GetCompressedOutput());
@@ -2367,23 +2519,12 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 
 	WriteZip(filename, savegame_filenames, savegame_content);
 
-	savegameManager.NotifyNewSave (filename, description, okForQuicksave);
-
 	// delete the JSON buffers we created just above. Everything else will
 	// either still be needed or taken care of automatically.
 	savegame_content[1].Clean();
 	savegame_content[2].Clean();
 
-	// Check whether the file is ok by trying to open it.
-	FResourceFile *test = FResourceFile::OpenResourceFile(filename, nullptr, true);
-	if (test != nullptr)
-	{
-		delete test;
-		if (longsavemessages) Printf ("%s (%s)\n", GStrings("GGSAVED"), filename.GetChars());
-		else Printf ("%s\n", GStrings("GGSAVED"));
-	}
-	else Printf(PRINT_HIGH, "Save failed\n");
-
+	ReportSaveGame(filename, description, okForQuicksave);
 
 	BackupSaveName = filename;
 
@@ -2394,6 +2535,33 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 	I_FreezeTime(false);
 }
 
+//==========================================================================
+//
+// Finishes an asynchronous save. If wait is false this only happens if the
+// writer thread is already done.
+//
+//==========================================================================
+
+void G_FinishPendingSave (bool wait)
+{
+	auto save = PendingSave;
+	if (save == nullptr || (!wait && !save->Done.load(std::memory_order_acquire)))
+	{
+		return;
+	}
+	PendingSave = nullptr;
+	save->Thread.join();
+	if (save->Success)
+	{
+		ReportSaveGame(save->Filename, save->Description, save->OkForQuicksave);
+	}
+	else
+	{
+		Printf(PRINT_HIGH, "Save failed\n");
+	}
+	delete save;
+}
+
 
 
 
@@ -2864,6 +3032,7 @@ void G_TimeDemo (const char* name)
 	noblit = !!Args->CheckParm ("-noblit");
 	timingdemo = true;
 	singletics = true;
+	G_BenchmarkInit (name);
 
 	defdemoname = name;
 	gameaction = (gameaction == ga_loadgame) ? ga_loadgameplaydemo : ga_playdemo;
@@ -2916,6 +3085,10 @@ bool G_CheckDemoStatus (void)
 		{
 			if (timingdemo)
 			{
+				if (G_BenchmarkActive())
+				{
+					G_BenchmarkFinish (gametic);	// does not return
+				}
 				// Trying to get back to a stable state after timing a demo
 				// seems to cause problems. I don't feel like fixing that
 				// right now.
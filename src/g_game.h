@@ -53,6 +53,8 @@ void G_DoLoadGame (void);
 
 // Called by M_Responder.
 void G_SaveGame (const char *filename, const char *description);
+// Reports an asynchronously written savegame once it is done
+void G_FinishPendingSave (bool wait);
 
 // Only called by startup code.
 void G_RecordDemo (const char* name);
@@ -101,6 +101,7 @@ void STAT_StartNewGame(const char *lev);
 void STAT_ChangeLevel(const char *newl);
 
 EXTERN_CVAR(Bool, save_formatted)
+EXTERN_CVAR(Bool, save_binary)
 EXTERN_CVAR (Float, sv_gravity)
 EXTERN_CVAR (Float, sv_aircontrol)
 EXTERN_CVAR (Int, disableautosave)
@@ -1581,10 +1582,12 @@ void G_AirControlChanged ()
 //==========================================================================
 //
 // Archives the current level
+// An uncompressed snapshot still needs FCompressedBuffer::Compress
+// to calculate its CRC before it can be written to a savegame.
 //
 //==========================================================================
 
-void G_SnapshotLevel ()
+void G_SnapshotLevel (bool compress)
 {
 	level.info->Snapshot.Clean();
 
@@ -1592,11 +1595,11 @@ void G_SnapshotLevel ()
 	{
 		FSerializer arc;
 
-		if (arc.OpenWriter(save_formatted))
+		if (save_binary ? arc.OpenBinaryWriter() : arc.OpenWriter(save_formatted))
 		{
 			SaveVersion = SAVEVER;
 			G_SerializeLevel(arc, false);
-			level.info->Snapshot = arc.GetCompressedOutput();
+			level.info->Snapshot = compress ? arc.GetCompressedOutput() : arc.GetStoredOutput();
 		}
 	}
 }
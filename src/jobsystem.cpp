@@ -0,0 +1,369 @@
+/*
+** jobsystem.cpp
+**
+** Work-stealing job scheduler shared by all subsystems
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <chrono>
+#include "jobsystem.h"
+
+// Index of the deque owned by the current thread, or -1 for foreign threads
+static thread_local int JobDequeIndex = -1;
+
+//==========================================================================
+//
+// FWorkStealingDeque
+//
+// Chase-Lev deque, using the C11 memory model formulation by
+// Lê, Pop, Cohen and Zappa Nardelli. Slots are never reallocated.
+//
+//==========================================================================
+
+bool FWorkStealingDeque::Push(FJob *job)
+{
+	int64_t b = Bottom.load(std::memory_order_relaxed);
+	int64_t t = Top.load(std::memory_order_acquire);
+	if (b - t >= Capacity)
+		return false;
+
+	Buffer[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	Bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+FJob *FWorkStealingDeque::Pop()
+{
+	int64_t b = Bottom.load(std::memory_order_relaxed) - 1;
+	Bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = Top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Empty
+		Bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	FJob *job = Buffer[b & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// Last element: race against thieves for it
+		if (!Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		Bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+FJob *FWorkStealingDeque::Steal()
+{
+	int64_t t = Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = Bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return nullptr;
+
+	FJob *job = Buffer[t & (Capacity - 1)].load(std::memory_order_acquire);
+	if (!Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+//==========================================================================
+//
+// FJobGroup :: Wait
+//
+//==========================================================================
+
+bool FJobGroup::Wait(int timeoutms)
+{
+	using namespace std::chrono;
+
+	auto jobs = FJobSystem::Instance();
+	auto start = steady_clock::now();
+	int idle = 0;
+
+	while (!IsDone())
+	{
+		if (jobs->RunOne(this))
+		{
+			idle = 0;
+			continue;
+		}
+
+		// Nothing left to help with; the remaining jobs are running elsewhere.
+		if (++idle < 64)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(microseconds(50));
+			if (timeoutms >= 0 && duration_cast<milliseconds>(steady_clock::now() - start).count() > timeoutms)
+				return false;
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// FJobSystem
+//
+//==========================================================================
+
+FJobSystem *FJobSystem::Instance()
+{
+	static FJobSystem jobs;
+	return &jobs;
+}
+
+FJobSystem::FJobSystem() : NumInjected(0), NumSleeping(0), Shutdown(false)
+{
+	// The thread creating the job system runs jobs too while it waits.
+	int numworkers = (int)std::thread::hardware_concurrency() - 1;
+	if (numworkers < 0)
+		numworkers = 3;
+	else if (numworkers == 0)
+		numworkers = 1;
+
+	// Deque 0 belongs to the thread creating the job system, the rest to the workers.
+	NumDeques = numworkers + 1;
+	Deques.reset(new FWorkStealingDeque[NumDeques]);
+	JobDequeIndex = 0;
+
+	Workers.reserve(numworkers);
+	for (int i = 1; i <= numworkers; i++)
+	{
+		Workers.push_back(std::thread([=]() { WorkerMain(i); }));
+	}
+}
+
+FJobSystem::~FJobSystem()
+{
+	Shutdown.store(true);
+	{
+		std::unique_lock<std::mutex> lock(SleepMutex);
+	}
+	SleepCondition.notify_all();
+	for (auto &worker : Workers)
+		worker.join();
+}
+
+void FJobSystem::Submit(FJob *job)
+{
+	int self = JobDequeIndex;
+	if (self >= 0)
+	{
+		if (!Deques[self].Push(job))
+		{
+			RunJob(job);
+			return;
+		}
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(InjectMutex);
+		Injected.push_back(job);
+		NumInjected.fetch_add(1, std::memory_order_relaxed);
+	}
+	Wake();
+}
+
+void FJobSystem::Wake()
+{
+	// Pairs with the fence in WorkerMain: either the worker sees the new job
+	// or we see the worker going to sleep.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (NumSleeping.load(std::memory_order_relaxed) > 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(SleepMutex);
+		}
+		SleepCondition.notify_one();
+	}
+}
+
+bool FJobSystem::RunOne(FJobGroup *group)
+{
+	FJob *job = group == nullptr ? FindJob(JobDequeIndex) : FindGroupJob(JobDequeIndex, group);
+	if (job == nullptr)
+		return false;
+	RunJob(job);
+	return true;
+}
+
+void FJobSystem::RunJob(FJob *job)
+{
+	// The job may be released as soon as its group is done, so read everything first.
+	FJobGroup *group = job->Group;
+	job->Func(job->Data);
+	if (group != nullptr)
+		group->Done();
+}
+
+FJob *FJobSystem::FindJob(int self)
+{
+	FJob *job;
+
+	if (self >= 0 && (job = Deques[self].Pop()) != nullptr)
+		return job;
+
+	if (NumInjected.load(std::memory_order_relaxed) > 0)
+	{
+		std::unique_lock<std::mutex> lock(InjectMutex);
+		if (!Injected.empty())
+		{
+			job = Injected.back();
+			Injected.pop_back();
+			NumInjected.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	// Start at a different victim for every thief to spread contention.
+	int start = self >= 0 ? self + 1 : 0;
+	for (int i = 0; i < NumDeques; i++)
+	{
+		int victim = (start + i) % NumDeques;
+		if (victim != self && (job = Deques[victim].Steal()) != nullptr)
+			return job;
+	}
+	return nullptr;
+}
+
+//==========================================================================
+//
+// Like FindJob, but for a thread waiting on a group. Unrelated work, like
+// lump decompression, must not hold up a frame. Jobs of other groups that
+// turn up are handed to the workers through the injection queue.
+//
+//==========================================================================
+
+FJob *FJobSystem::FindGroupJob(int self, FJobGroup *group)
+{
+	FJob *job;
+
+	if (self >= 0)
+	{
+		while ((job = Deques[self].Pop()) != nullptr)
+		{
+			if (job->Group == group)
+				return job;
+			Reinject(job);
+		}
+	}
+
+	if (NumInjected.load(std::memory_order_relaxed) > 0)
+	{
+		std::unique_lock<std::mutex> lock(InjectMutex);
+		for (size_t i = Injected.size(); i-- > 0; )
+		{
+			if (Injected[i]->Group == group)
+			{
+				job = Injected[i];
+				Injected.erase(Injected.begin() + i);
+				NumInjected.fetch_sub(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+	}
+
+	int start = self >= 0 ? self + 1 : 0;
+	for (int i = 0; i < NumDeques; i++)
+	{
+		int victim = (start + i) % NumDeques;
+		if (victim != self && (job = Deques[victim].Steal()) != nullptr)
+		{
+			if (job->Group == group)
+				return job;
+			Reinject(job);
+		}
+	}
+	return nullptr;
+}
+
+void FJobSystem::Reinject(FJob *job)
+{
+	{
+		std::unique_lock<std::mutex> lock(InjectMutex);
+		Injected.push_back(job);
+		NumInjected.fetch_add(1, std::memory_order_relaxed);
+	}
+	Wake();
+}
+
+bool FJobSystem::HasWork()
+{
+	if (NumInjected.load(std::memory_order_relaxed) > 0)
+		return true;
+	for (int i = 0; i < NumDeques; i++)
+	{
+		if (!Deques[i].IsEmpty())
+			return true;
+	}
+	return false;
+}
+
+void FJobSystem::WorkerMain(int index)
+{
+	JobDequeIndex = index;
+	int idle = 0;
+
+	while (!Shutdown.load(std::memory_order_relaxed))
+	{
+		FJob *job = FindJob(index);
+		if (job != nullptr)
+		{
+			RunJob(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < 64)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(SleepMutex);
+		NumSleeping.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!HasWork() && !Shutdown.load(std::memory_order_relaxed))
+		{
+			SleepCondition.wait_for(lock, std::chrono::milliseconds(100));
+		}
+		NumSleeping.fetch_sub(1, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
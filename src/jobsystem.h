@@ -0,0 +1,205 @@
+/*
+** jobsystem.h
+**
+** Work-stealing job scheduler shared by all subsystems
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Every worker thread owns a lock-free deque (Chase-Lev). A thread pushes
+** and pops jobs at the bottom of its own deque, idle threads steal from
+** the top of the others. The thread that first creates the job system
+** (the main thread) owns a deque as well; any other thread submits
+** through a small locked injection queue.
+**
+** Jobs are not allocated by the scheduler. The submitter owns the FJob
+** and must keep it alive until its group reports completion.
+**
+*/
+
+#ifndef __JOBSYSTEM_H
+#define __JOBSYSTEM_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+class FJobGroup;
+
+struct FJob
+{
+	void (*Func)(void *data);
+	void *Data;
+	FJobGroup *Group;
+};
+
+//==========================================================================
+//
+// Counts outstanding jobs. Waiting on a group executes the group's own
+// queued jobs instead of blocking, so it is safe to wait from inside a job.
+//
+//==========================================================================
+
+class FJobGroup
+{
+public:
+	FJobGroup() : Pending(0) {}
+
+	void Add(int count = 1) { Pending.fetch_add(count, std::memory_order_relaxed); }
+	void Done() { Pending.fetch_sub(1, std::memory_order_release); }
+	bool IsDone() const { return Pending.load(std::memory_order_acquire) == 0; }
+
+	// Returns false if the jobs did not finish within timeoutms milliseconds (-1 waits forever).
+	// Only jobs of this group are run while waiting.
+	bool Wait(int timeoutms = -1);
+
+private:
+	std::atomic<int> Pending;
+};
+
+//==========================================================================
+//
+// Single owner, multiple thief deque
+//
+//==========================================================================
+
+class FWorkStealingDeque
+{
+public:
+	enum { Capacity = 4096 };
+
+	FWorkStealingDeque() : Top(0), Bottom(0)
+	{
+		for (auto &slot : Buffer) slot.store(nullptr, std::memory_order_relaxed);
+	}
+
+	bool Push(FJob *job);	// owner only. Returns false if full
+	FJob *Pop();			// owner only
+	FJob *Steal();			// any thread
+
+	bool IsEmpty() const
+	{
+		return Bottom.load(std::memory_order_relaxed) <= Top.load(std::memory_order_relaxed);
+	}
+
+private:
+	// Keep the thieves' and the owner's index on separate cache lines
+	std::atomic<int64_t> Top;
+	char Padding1[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> Bottom;
+	char Padding2[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<FJob *> Buffer[Capacity];
+};
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+class FJobSystem
+{
+public:
+	static FJobSystem *Instance();
+
+	// Queues a job. Falls back to running it immediately if the deque is full.
+	void Submit(FJob *job);
+
+	// Runs one queued job on the calling thread. Returns false if none was found.
+	// If a group is given, only a job of that group is run.
+	bool RunOne(FJobGroup *group = nullptr);
+
+	// Number of threads that can execute jobs concurrently (workers plus the waiting thread)
+	int GetNumThreads() const { return (int)Workers.size() + 1; }
+
+	// Calls func(index) for every index in [start, end), split into chunks across the pool.
+	template<typename Function>
+	void ParallelFor(int start, int end, const Function &func, int chunk = 0)
+	{
+		struct Range
+		{
+			const Function *func;
+			int start, end;
+		};
+		int count = end - start;
+		if (count <= 0) return;
+		if (chunk <= 0) chunk = (count + GetNumThreads() * 4 - 1) / (GetNumThreads() * 4);
+		if (chunk <= 0) chunk = 1;
+
+		int numjobs = (count + chunk - 1) / chunk;
+		std::unique_ptr<FJob[]> jobs(new FJob[numjobs]);
+		std::unique_ptr<Range[]> ranges(new Range[numjobs]);
+		FJobGroup group;
+		group.Add(numjobs);
+		for (int i = 0; i < numjobs; i++)
+		{
+			ranges[i].func = &func;
+			ranges[i].start = start + i * chunk;
+			ranges[i].end = ranges[i].start + chunk < end ? ranges[i].start + chunk : end;
+			jobs[i].Func = [](void *data)
+			{
+				Range *range = (Range*)data;
+				for (int index = range->start; index < range->end; index++)
+					(*range->func)(index);
+			};
+			jobs[i].Data = &ranges[i];
+			jobs[i].Group = &group;
+			Submit(&jobs[i]);
+		}
+		group.Wait();
+	}
+
+private:
+	FJobSystem();
+	~FJobSystem();
+
+	void WorkerMain(int index);
+	FJob *FindJob(int self);
+	FJob *FindGroupJob(int self, FJobGroup *group);
+	void Reinject(FJob *job);
+	bool HasWork();
+	void Wake();
+	static void RunJob(FJob *job);
+
+	std::vector<std::thread> Workers;
+	std::unique_ptr<FWorkStealingDeque[]> Deques;
+	int NumDeques = 0;
+
+	std::mutex InjectMutex;
+	std::vector<FJob *> Injected;
+	std::atomic<int> NumInjected;
+
+	std::mutex SleepMutex;
+	std::condition_variable SleepCondition;
+	std::atomic<int> NumSleeping;
+	std::atomic<bool> Shutdown;
+};
+
+#endif
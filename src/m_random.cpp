@@ -159,6 +159,26 @@ FRandom::FRandom ()
 	Init(0);
 }
 
+//==========================================================================
+//
+// FRandom - Copy constructor
+//
+// The copy is not added to the RNG list, so it is neither seeded nor
+// saved along with the others.
+//
+//==========================================================================
+
+FRandom::FRandom (const FRandom &other)
+: Next (NULL), NameCRC (0)
+{
+#ifndef NDEBUG
+	Name = NULL;
+	initialized = other.initialized;
+#endif
+	sfmt = other.sfmt;
+	idx = other.idx;
+}
+
 //==========================================================================
 //
 // FRandom - Named constructor
@@ -46,6 +46,9 @@ class FRandom
 public:
 	FRandom ();
 	FRandom (const char *name);
+	// Unregistered copy of another RNG's current state, for looking ahead
+	// at the numbers it will return without consuming them.
+	explicit FRandom (const FRandom &other);
 	~FRandom ();
 
 	// Returns a random number in the range [0,255]
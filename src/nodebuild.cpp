@@ -51,10 +51,12 @@
 #include "m_bbox.h"
 #include "c_console.h"
 #include "r_state.h"
+#include "jobsystem.h"
 
 const int MaxSegs = 64;
 const int SplitCost = 8;
 const int AAPreference = 16;
+const unsigned MinParallelSplitters = 64;	// Fewer candidates are not worth distributing
 
 #if 0
 #define D(x) x
@@ -464,6 +466,7 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 
 	D(Printf (PRINT_LOG, "Processing set %d\n", set));
 
+	Candidates.Clear();
 	while (seg != DWORD_MAX)
 	{
 		FPrivSeg *pseg = &Segs[seg];
@@ -481,31 +484,41 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 				}
 
 				stepleft = step;
-				SetNodeFromSeg (node, pseg);
-
-				int value = Heuristic (node, set, nosplit);
-
-				D(Printf (PRINT_LOG, "Seg %5d, ld %d (%5d,%5d)-(%5d,%5d) scores %d\n", seg, Segs[seg].linedef, node.x>>16, node.y>>16,
-					(node.x+node.dx)>>16, (node.y+node.dy)>>16, value));
-
-				if (value > bestvalue)
-				{
-					bestvalue = value;
-					bestseg = seg;
-				}
-				else if (value < 0)
-				{
-					nosplitters = true;
-				}
+				Candidates.Push(seg);
 			}
 		}
 
 		seg = pseg->next;
 	}
 
+	ScoreSplitters (set, nosplit);
+
+	// Pick the best one in set order so that the result does not depend on
+	// how the scoring was distributed.
+	for (unsigned i = 0; i < Candidates.Size(); i++)
+	{
+		int value = CandidateScores[i];
+
+		D(Printf (PRINT_LOG, "Seg %5d, ld %d scores %d\n", Candidates[i], Segs[Candidates[i]].linedef, value));
+
+		if (value > bestvalue)
+		{
+			bestvalue = value;
+			bestseg = Candidates[i];
+		}
+		else if (value < 0)
+		{
+			nosplitters = true;
+		}
+	}
+
 	if (bestseg == DWORD_MAX)
 	{ // No lines split any others into two sets, so this is a convex region.
 	D(Printf (PRINT_LOG, "set %d, step %d, nosplit %d has no good splitter (%d)\n", set, step, nosplit, nosplitters));
+		if (Candidates.Size() > 0)
+		{
+			SetNodeFromSeg (node, &Segs[Candidates.Last()]);
+		}
 		return nosplitters ? -1 : 0;
 	}
 
@@ -516,13 +529,49 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 	return 1;
 }
 
+// Scores all splitter candidates of a set. Every candidate needs a full pass
+// over the set, so for large sets this is where most of the node building
+// time goes. Heuristic only reads the builder's data, which allows scoring
+// the candidates on the job system, each chunk with its own scratch lists.
+
+void FNodeBuilder::ScoreSplitters (uint32_t set, bool nosplit)
+{
+	unsigned count = Candidates.Size();
+	CandidateScores.Resize(count);
+
+	if (count < MinParallelSplitters)
+	{
+		node_t node;
+		for (unsigned i = 0; i < count; i++)
+		{
+			SetNodeFromSeg (node, &Segs[Candidates[i]]);
+			CandidateScores[i] = Heuristic (node, set, nosplit);
+		}
+		return;
+	}
+
+	const unsigned chunk = MinParallelSplitters / 4;
+	FJobSystem::Instance()->ParallelFor(0, (count + chunk - 1) / chunk, [&](int c)
+	{
+		TArray<int> touched, colinear;
+		node_t node;
+		unsigned end = MIN((c + 1) * chunk, count);
+
+		for (unsigned i = c * chunk; i < end; i++)
+		{
+			SetNodeFromSeg (node, &Segs[Candidates[i]]);
+			CandidateScores[i] = Heuristic (node, set, nosplit, touched, colinear);
+		}
+	}, 1);
+}
+
 // Given a splitter (node), returns a score based on how "good" the resulting
 // split in a set of segs is. Higher scores are better. -1 means this splitter
 // splits something it shouldn't and will only be returned if honorNoSplit is
 // true. A score of 0 means that the splitter does not split any of the segs
 // in the set.
 
-int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
+int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit, TArray<int> &touched, TArray<int> &colinear)
 {
 	// Set the initial score above 0 so that near vertex anti-weighting is less likely to produce a negative score.
 	int score = 1000000;
@@ -537,8 +586,8 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	unsigned int max, m2, p, q;
 	double frac;
 
-	Touched.Clear ();
-	Colinear.Clear ();
+	touched.Clear ();
+	colinear.Clear ();
 
 	while (i != DWORD_MAX)
 	{
@@ -564,32 +613,32 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 			{
 				if ((sidev[0] | sidev[1]) != 0)
 				{
-					max = Touched.Size();
+					max = touched.Size();
 					for (p = 0; p < max; ++p)
 					{
-						if (Touched[p] == test->loopnum)
+						if (touched[p] == test->loopnum)
 						{
 							break;
 						}
 					}
 					if (p == max)
 					{
-						Touched.Push (test->loopnum);
+						touched.Push (test->loopnum);
 					}
 				}
 				else
 				{
-					max = Colinear.Size();
+					max = colinear.Size();
 					for (p = 0; p < max; ++p)
 					{
-						if (Colinear[p] == test->loopnum)
+						if (colinear[p] == test->loopnum)
 						{
 							break;
 						}
 					}
 					if (p == max)
 					{
-						Colinear.Push (test->loopnum);
+						colinear.Push (test->loopnum);
 					}
 				}
 			}
@@ -706,8 +755,8 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	// seg of that sector must be crossing the container's corner and does not
 	// actually split the container.
 
-	max = Touched.Size ();
-	m2 = Colinear.Size ();
+	max = touched.Size ();
+	m2 = colinear.Size ();
 
 	// If honorNoSplit is false, then both these lists will be empty.
 
@@ -720,10 +769,10 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 
 	for (p = 0; p < max; ++p)
 	{
-		int look = Touched[p];
+		int look = touched[p];
 		for (q = 0; q < m2; ++q)
 		{
-			if (look == Colinear[q])
+			if (look == colinear[q])
 			{
 				break;
 			}
@@ -1513,6 +1513,46 @@ enum CBA_Flags
 
 static void AimBulletMissile(AActor *proj, AActor *puff, int flags, bool temp, bool cba);
 
+//==========================================================================
+//
+// Traces all pellets of a spread attack before the first one is fired.
+// The spread comes from a copy of pr_cwbullet, so the firing loop still
+// gets the same numbers in the same order.
+//
+//==========================================================================
+
+static void PrepareBulletBatch(FTraceBatch &batch, AActor *self, DAngle bangle, DAngle bslope, DAngle spread_xy, DAngle spread_z,
+	int numbullets, bool explicitangle, bool randomdamage, double range, PClassActor *pufftype, int laflags)
+{
+	if (numbullets < 2 || !FTraceBatch::IsUsable()) return;
+
+	FRandom lookahead(pr_cwbullet);
+	TArray<DAngle> angles(numbullets);
+	TArray<DAngle> slopes(numbullets);
+
+	for (int i = 0; i < numbullets; i++)
+	{
+		DAngle angle = bangle;
+		DAngle slope = bslope;
+
+		if (explicitangle)
+		{
+			angle += spread_xy;
+			slope += spread_z;
+		}
+		else
+		{
+			angle += spread_xy * (lookahead.Random2() / 255.);
+			slope += spread_z * (lookahead.Random2() / 255.);
+		}
+		if (randomdamage) lookahead();
+
+		angles.Push(angle);
+		slopes.Push(slope);
+	}
+	P_LineAttackBatch(batch, self, &angles[0], &slopes[0], numbullets, range, pufftype, laflags);
+}
+
 DEFINE_ACTION_FUNCTION(AActor, A_CustomBulletAttack)
 {
 	PARAM_SELF_PROLOGUE(AActor);
@@ -1550,6 +1590,13 @@ DEFINE_ACTION_FUNCTION(AActor, A_CustomBulletAttack)
 		if (pufftype == nullptr) pufftype = PClass::FindActor(NAME_BulletPuff);
 
 		S_Sound (self, CHAN_WEAPON, self->AttackSound, 1, ATTN_NORM);
+
+		FTraceBatch batch;
+		if (missile == nullptr)
+		{
+			PrepareBulletBatch(batch, self, bangle, bslope, spread_xy, spread_z, numbullets,
+				!!(flags & CBAF_EXPLICITANGLE), false, range, pufftype, laflags);
+		}
 		for (i = 0; i < numbullets; i++)
 		{
 			DAngle angle = bangle;
@@ -1571,7 +1618,7 @@ DEFINE_ACTION_FUNCTION(AActor, A_CustomBulletAttack)
 			if (!(flags & CBAF_NORANDOM))
 				damage *= ((pr_cabullet()%3)+1);
 
-			AActor *puff = P_LineAttack(self, angle, range, slope, damage, NAME_Hitscan, pufftype, laflags);
+			AActor *puff = P_LineAttack(self, angle, range, slope, damage, NAME_Hitscan, pufftype, laflags, nullptr, nullptr, 0., &batch);
 			if (missile != nullptr && pufftype != nullptr)
 			{
 				double x = Spawnofs_xy * angle.Cos();
@@ -1837,6 +1884,13 @@ DEFINE_ACTION_FUNCTION(AStateProvider, A_FireBullets)
 	{
 		if (numbullets < 0)
 			numbullets = 1;
+
+		FTraceBatch batch;
+		if (missile == nullptr)
+		{
+			PrepareBulletBatch(batch, self, bangle, bslope, spread_xy, spread_z, numbullets,
+				!!(flags & FBF_EXPLICITANGLE), !(flags & FBF_NORANDOM), range, pufftype, laflags);
+		}
 		for (i = 0; i < numbullets; i++)
 		{
 			DAngle angle = bangle;
@@ -1858,7 +1912,7 @@ DEFINE_ACTION_FUNCTION(AStateProvider, A_FireBullets)
 			if (!(flags & FBF_NORANDOM))
 				damage *= ((pr_cwbullet()%3)+1);
 
-			AActor *puff = P_LineAttack(self, angle, range, slope, damage, NAME_Hitscan, pufftype, laflags);
+			AActor *puff = P_LineAttack(self, angle, range, slope, damage, NAME_Hitscan, pufftype, laflags, nullptr, nullptr, 0., &batch);
 
 			if (missile != nullptr)
 			{
@@ -3723,7 +3777,7 @@ DEFINE_ACTION_FUNCTION(AActor, A_Respawn)
 
 	self->flags |= MF_SOLID;
 	self->Height = self->GetDefault()->Height;
-	self->radius = self->GetDefault()->radius;
+	self->SetRadius(self->GetDefault()->radius);
 	self->RestoreSpecialPosition();
 
 	if (flags & RSF_TELEFRAG)
@@ -6766,14 +6820,14 @@ DEFINE_ACTION_FUNCTION(AActor, A_SetSize)
 
 	FLinkContext ctx;
 	self->UnlinkFromWorld(&ctx);
-	self->radius = newradius;
+	self->SetRadius(newradius);
 	self->Height = newheight;
 	self->LinkToWorld(&ctx);
 
 	if (testpos && !P_TestMobjLocation(self))
 	{
 		self->UnlinkFromWorld(&ctx);
-		self->radius = oldradius;
+		self->SetRadius(oldradius);
 		self->Height = oldheight;
 		self->LinkToWorld(&ctx);
 		ACTION_RETURN_BOOL(false);
@@ -1,6 +1,8 @@
 #ifndef __P_BLOCKMAP_H
 #define __P_BLOCKMAP_H
 
+#include <math.h>
+#include <float.h>
 #include "doomtype.h"
 
 class AActor;
@@ -9,6 +11,7 @@ class AActor;
 struct FBlockNode
 {
 	AActor *Me;						// actor this node references
+	int HotSlot;					// Me's slot in ActorHotFields
 	int BlockIndex;					// index into blocklinks for the block this node is in
 	int Group;						// portal group this link belongs to (can be different than the actor's own group
 	FBlockNode **PrevActor;			// previous actor in this block
@@ -20,12 +23,14 @@ struct FBlockNode
 	void Release ();
 
 	static FBlockNode *FreeBlocks;
+	static uint32_t LinkCount;		// changes whenever an actor is linked into or unlinked from a block
 };
 
 // BLOCKMAP
 // Created from axis aligned bounding box
 // of the map, a rectangular array of
-// blocks of size 128x128.
+// blocks of size 128x128 (or blockmapsize
+// if the blockmap is generated).
 // Used to speed up collision detection
 // by spatial subdivision in 2D.
 //
@@ -40,22 +45,32 @@ struct FBlockmap
 	double				bmaporgx;
 	double				bmaporgy;		// origin of block map
 	FBlockNode**		blocklinks; 	// for thing chains
+	int					BlockSize;		// in map units
+
+	// Rebuilt copy of the line lists for the line iterators. Each block's
+	// lines are stored contiguously and padded to a multiple of 4, so that
+	// the bounding boxes of 4 lines can be checked at once. The boxes are
+	// rounded outwards so that they never reject a line the exact check
+	// would accept. Padding entries have an empty box and line index -1.
+	TArray<int>			FlatStart;		// first entry of each block, plus end marker
+	TArray<int>			FlatLines;
+	TArray<float>		FlatLeft, FlatBottom, FlatRight, FlatTop;
 
 	// mapblocks are used to check movement
 	// against lines and things
 	enum
 	{
-		MAPBLOCKUNITS = 128
+		MAPBLOCKUNITS = 128		// the only block size the BLOCKMAP lump can have
 	};
 
 	inline int GetBlockX(double xpos)
 	{
-		return int((xpos - bmaporgx) / MAPBLOCKUNITS);
+		return int((xpos - bmaporgx) / BlockSize);
 	}
 
 	inline int GetBlockY(double ypos)
 	{
-		return int((ypos - bmaporgy) / MAPBLOCKUNITS);
+		return int((ypos - bmaporgy) / BlockSize);
 	}
 
 	inline bool isValidBlock(int x, int y) const
@@ -74,6 +89,20 @@ struct FBlockmap
 	}
 
 	bool VerifyBlockMap(int count);
+	void BuildFlatLines();
+
+	// Conversions for the line boxes that never make a box smaller
+	static float RoundDown(double v)
+	{
+		float f = (float)v;
+		return f > v ? nextafterf(f, -FLT_MAX) : f;
+	}
+
+	static float RoundUp(double v)
+	{
+		float f = (float)v;
+		return f < v ? nextafterf(f, FLT_MAX) : f;
+	}
 
 	void Clear()
 	{
@@ -87,6 +116,12 @@ struct FBlockmap
 			delete[] blocklinks;
 			blocklinks = NULL;
 		}
+		FlatStart.Clear();
+		FlatLines.Clear();
+		FlatLeft.Clear();
+		FlatBottom.Clear();
+		FlatRight.Clear();
+		FlatTop.Clear();
 	}
 
 };
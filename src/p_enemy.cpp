@@ -59,6 +59,7 @@
 #include "g_levellocals.h"
 #include "vm.h"
 #include "actorinlines.h"
+#include "p_navigation.h"
 
 #include "gi.h"
 
@@ -971,6 +972,37 @@ void P_DoNewChaseDir (AActor *actor, double deltax, double deltay)
 // hang over dropoffs.
 //=============================================================================
 
+//=============================================================================
+//
+// P_TryNavigationDir
+//
+// When following a waypoint, only the two directions closest to it are
+// worth trying. If neither works, the normal search takes over.
+//
+//=============================================================================
+
+static bool P_TryNavigationDir(AActor *actor, const DVector2 &delta)
+{
+	double angle = delta.Angle().Normalized360().Degrees / 45.;
+	int best = int(angle + 0.5);
+	int next = angle >= best ? best + 1 : best - 1;
+	int olddir = actor->movedir;
+	dirtype_t turnaround = opposite[olddir];
+
+	for (int dir : { best & 7, next & 7 })
+	{
+		if (dir != turnaround)
+		{
+			actor->movedir = dir;
+			if (P_TryWalk(actor))
+				return true;
+		}
+	}
+	// The normal search decides by the old heading.
+	actor->movedir = olddir;
+	return false;
+}
+
 //=============================================================================
 //
 // P_NewChaseDir
@@ -982,25 +1014,29 @@ void P_DoNewChaseDir (AActor *actor, double deltax, double deltay)
 void P_NewChaseDir(AActor * actor)
 {
 	DVector2 delta;
+	bool navigating = false;
 
 	actor->strafecount = 0;
 
 	if ((actor->flags5&MF5_CHASEGOAL || actor->goal == actor->target) && actor->goal!=NULL)
 	{
 		delta = actor->Vec2To(actor->goal);
+		navigating = Navigation.GetChaseDelta(actor, actor->goal, delta);
 	}
 	else if (actor->target != NULL)
 	{
 		delta = actor->Vec2To(actor->target);
 
-		if (!(actor->flags6 & MF6_NOFEAR))
+		if (!(actor->flags6 & MF6_NOFEAR) &&
+			((actor->target->player != NULL && (actor->target->player->cheats & CF_FRIGHTENING)) || 
+			(actor->flags4 & MF4_FRIGHTENED) ||
+			(actor->target->flags8 & MF8_FRIGHTENING)))
 		{
-			if ((actor->target->player != NULL && (actor->target->player->cheats & CF_FRIGHTENING)) || 
-				(actor->flags4 & MF4_FRIGHTENED) ||
-				(actor->target->flags8 & MF8_FRIGHTENING))
-			{
-				delta = -delta;
-			}
+			delta = -delta;
+		}
+		else
+		{
+			navigating = Navigation.GetChaseDelta(actor, actor->target, delta);
 		}
 	}
 	else
@@ -1018,7 +1054,7 @@ void P_NewChaseDir(AActor * actor)
 		!(actor->flags & MF_FLOAT) && !(i_compatflags & COMPATF_DROPOFF))
 	{
 		FBoundingBox box(actor->X(), actor->Y(), actor->radius);
-		FBlockLinesIterator it(box);
+		FBlockLinesIterator it(box, true);
 		line_t *line;
 
 		double deltax = 0;
@@ -1110,11 +1146,15 @@ void P_NewChaseDir(AActor * actor)
 			{
 				actor->strafecount = pr_enemystrafe() & 15;
 				delta = -delta;
+				navigating = false;
 			}
 	    }
 	}
 
-	P_DoNewChaseDir(actor, delta.X, delta.Y);
+	if (!navigating || !P_TryNavigationDir(actor, delta))
+	{
+		P_DoNewChaseDir(actor, delta.X, delta.Y);
+	}
 
 	// If strafing, set movecount to strafecount so that old Doom
 	// logic still works the same, except in the strafing part
@@ -1898,6 +1938,9 @@ bool P_LookForPlayers (AActor *actor, INTBOOL allaround, FLookExParams *params)
 		if (player->health <= 0)
 			continue;			// dead
 
+		if (!P_SightPossible (actor, player->mo, SF_SEEPASTSHOOTABLELINES))
+			continue;			// not in the PVS
+
 		if (!P_IsVisible (actor, player->mo, allaround, params))
 			continue;			// out of sight
 
@@ -2842,7 +2885,7 @@ static bool P_CheckForResurrection(AActor *self, bool usevilestates)
 				corpsehit->Height = corpsehit->GetDefault()->Height;
 				bool check = P_CheckPosition(corpsehit, corpsehit->Pos());
 				corpsehit->flags = oldflags;
-				corpsehit->radius = oldradius;
+				corpsehit->SetRadius(oldradius);
 				corpsehit->Height = oldheight;
 				if (!check) continue;
 
@@ -2905,7 +2948,7 @@ static bool P_CheckForResurrection(AActor *self, bool usevilestates)
 				else
 				{
 					corpsehit->Height = info->Height;	// [RH] Use real mobj height
-					corpsehit->radius = info->radius;	// [RH] Use real radius
+					corpsehit->SetRadius(info->radius);	// [RH] Use real radius
 				}
 
 				corpsehit->Revive();
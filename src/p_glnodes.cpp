@@ -73,6 +73,8 @@ void P_GetPolySpots (MapData * lump, TArray<FNodeBuilder::FPolyStart> &spots, TA
 
 CVAR(Bool, gl_cachenodes, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR(Float, gl_cachetime, 0.6f, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+CVAR(Bool, cacheleveldata, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+CVAR(Float, cacheleveltime, 0.02f, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 
 void P_LoadZNodes (FileReader &dalump, uint32_t id);
 static bool CheckCachedNodes(MapData *map);
@@ -1004,7 +1006,7 @@ bool P_CheckNodes(MapData * map, bool rebuilt, int buildtime)
 typedef TArray<uint8_t> MemFile;
 
 
-static FString CreateCacheName(MapData *map, bool create)
+static FString CreateCacheName(MapData *map, const char *ext, bool create)
 {
 	FString path = M_GetCachePath(create);
 	FString lumpname = Wads.GetLumpFullPath(map->lumpnum);
@@ -1014,7 +1016,7 @@ static FString CreateCacheName(MapData *map, bool create)
 
 	lumpname.ReplaceChars('/', '%');
 	lumpname.ReplaceChars(':', '$');
-	path << '/' << lumpname.Right(lumpname.Len() - separator - 1) << ".gzc";
+	path << '/' << lumpname.Right(lumpname.Len() - separator - 1) << ext;
 	return path;
 }
 
@@ -1131,7 +1133,7 @@ static void CreateCachedNodes(MapData *map)
 	}
 	memcpy(compressed + offset - 4, "ZGL3", 4);
 
-	FString path = CreateCacheName(map, true);
+	FString path = CreateCacheName(map, ".gzc", true);
 	FILE *f = fopen(path, "wb");
 
 	if (f != NULL)
@@ -1160,7 +1162,7 @@ static bool CheckCachedNodes(MapData *map)
 	uint32_t numlin;
 	uint32_t *verts = NULL;
 
-	FString path = CreateCacheName(map, false);
+	FString path = CreateCacheName(map, ".gzc", false);
 	FILE *f = fopen(path, "rb");
 	if (f == NULL) return false;
 
@@ -1219,6 +1221,107 @@ errorout:
 	return false;
 }
 
+//==========================================================================
+//
+// Level data caching
+//
+// Other generated level data is cached next to the nodes, one file per
+// kind of data: the blockmap (.bmc) and the PVS (.pvs). The payload is
+// stored uncompressed and little endian behind a fixed size header. It
+// is read into memory in one piece and byte swapped by the user.
+//
+//==========================================================================
+
+struct FLevelCacheHeader
+{
+	char Magic[4];
+	uint32_t Param;			// data specific, e.g. the blockmap's block size
+	uint8_t MD5[16];
+	uint32_t NumLines;
+	uint32_t NumVertices;
+	uint32_t Size;			// of the payload in bytes
+	uint32_t Reserved;
+};
+
+static void InitCacheHeader(MapData *map, FLevelCacheHeader &header, uint32_t param, uint32_t size)
+{
+	memcpy(header.Magic, "LDC1", 4);
+	header.Param = LittleLong(param);
+	map->GetChecksum(header.MD5);
+	header.NumLines = LittleLong(level.lines.Size());
+	header.NumVertices = LittleLong(level.vertexes.Size());
+	header.Size = LittleLong(size);
+	header.Reserved = 0;
+}
+
+//==========================================================================
+//
+// Returns false if there is no cached data for the current state of the map
+//
+//==========================================================================
+
+bool P_ReadLevelCache(MapData *map, const char *ext, uint32_t param, TArray<uint8_t> &data)
+{
+	if (!cacheleveldata || level.maptype == MAPTYPE_BUILD)
+	{
+		return false;
+	}
+
+	FString path = CreateCacheName(map, ext, false);
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) return false;
+
+	FLevelCacheHeader header, check;
+	bool ok = fread(&header, sizeof(header), 1, f) == 1;
+	if (ok)
+	{
+		InitCacheHeader(map, check, param, LittleLong(header.Size));
+		ok = !memcmp(&header, &check, sizeof(header));
+	}
+	if (ok)
+	{
+		data.Resize(LittleLong(header.Size));
+		ok = data.Size() == 0 || fread(&data[0], data.Size(), 1, f) == 1;
+	}
+	fclose(f);
+	return ok;
+}
+
+//==========================================================================
+//
+// Only data that took at least cacheleveltime seconds to create gets cached.
+//
+//==========================================================================
+
+void P_WriteLevelCache(MapData *map, const char *ext, uint32_t param, const void *data, uint32_t size, double buildtime)
+{
+	if (!cacheleveldata || level.maptype == MAPTYPE_BUILD || buildtime < cacheleveltime)
+	{
+		return;
+	}
+
+	FLevelCacheHeader header;
+	InitCacheHeader(map, header, param, size);
+
+	FString path = CreateCacheName(map, ext, true);
+	FILE *f = fopen(path, "wb");
+	if (f != NULL)
+	{
+		if (fwrite(&header, sizeof(header), 1, f) != 1 || (size > 0 && fwrite(data, size, 1, f) != 1))
+		{
+			fclose(f);
+			remove(path);
+			Printf("Error saving level data to file %s\n", path.GetChars());
+			return;
+		}
+		fclose(f);
+	}
+	else
+	{
+		Printf("Cannot open level data file %s for writing\n", path.GetChars());
+	}
+}
+
 CCMD(clearnodecache)
 {
 	TArray<FFileList> list;
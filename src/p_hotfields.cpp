@@ -0,0 +1,72 @@
+/*
+** p_hotfields.cpp
+**
+** Compact mirror of the actor fields that collision checks read most
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include "p_hotfields.h"
+#include "c_cvars.h"
+
+FActorHotFields ActorHotFields;
+
+// Lets the blockmap searches go back to reading the actors, for comparison.
+CVAR(Bool, p_actorhotfields, true, 0)
+
+//==========================================================================
+//
+// FActorHotFields :: AllocSlot
+//
+// Reuses the most recently freed slot, so the arrays only grow to the
+// highest number of actors that were linked at the same time.
+//
+//==========================================================================
+
+int FActorHotFields::AllocSlot()
+{
+	int slot;
+	if (FreeSlots.Pop(slot))
+	{
+		return slot;
+	}
+	slot = Pos.Reserve(1);
+	PortalGroup.Reserve(1);
+	return slot;
+}
+
+//==========================================================================
+//
+// FActorHotFields :: FreeSlot
+//
+//==========================================================================
+
+void FActorHotFields::FreeSlot(int slot)
+{
+	FreeSlots.Push(slot);
+}
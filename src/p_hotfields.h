@@ -0,0 +1,71 @@
+/*
+** p_hotfields.h
+**
+** Compact mirror of the actor fields that collision checks read most
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+**
+** Blockmap searches look at many actors but reject most of them after
+** reading nothing but their position and radius. Reading those from the
+** actor drags in several cache lines of a very large object, so every
+** actor that gets linked into the world also gets a slot in these arrays
+** holding a copy of them.
+**
+** The copies are exact. The position can only be changed through the
+** AActor accessors and the radius through SetRadius, and both update the
+** slot. The portal group is refreshed whenever the actor gets linked.
+**
+*/
+
+#ifndef __P_HOTFIELDS_H
+#define __P_HOTFIELDS_H
+
+#include "tarray.h"
+
+struct FActorHotPos
+{
+	double X, Y, Z;
+	double Radius;
+};
+
+class FActorHotFields
+{
+public:
+	TArray<FActorHotPos> Pos;
+	TArray<int> PortalGroup;
+
+	int AllocSlot();
+	void FreeSlot(int slot);
+
+private:
+	TArray<int> FreeSlots;
+};
+
+extern FActorHotFields ActorHotFields;
+
+#endif
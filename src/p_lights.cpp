@@ -57,6 +57,7 @@ public:
 	DFireFlicker(sector_t *sector, int upper, int lower);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	int			GetTickKey(bool &parallel) const override;
 protected:
 	int 		m_Count;
 	int 		m_MaxLight;
@@ -72,6 +73,7 @@ public:
 	DFlicker(sector_t *sector, int upper, int lower);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	int			GetTickKey(bool &parallel) const override;
 protected:
 	int 		m_Count;
 	int 		m_MaxLight;
@@ -88,6 +90,7 @@ public:
 	DLightFlash(sector_t *sector, int min, int max);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	int			GetTickKey(bool &parallel) const override;
 protected:
 	int 		m_Count;
 	int 		m_MaxLight;
@@ -106,6 +109,7 @@ public:
 	DStrobe(sector_t *sector, int upper, int lower, int utics, int ltics);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	int			GetTickKey(bool &parallel) const override;
 protected:
 	int 		m_Count;
 	int 		m_MinLight;
@@ -123,6 +127,7 @@ public:
 	DGlow(sector_t *sector);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	int			GetTickKey(bool &parallel) const override;
 protected:
 	int 		m_MinLight;
 	int 		m_MaxLight;
@@ -139,6 +144,7 @@ public:
 	DGlow2(sector_t *sector, int start, int end, int tics, bool oneshot);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	int			GetTickKey(bool &parallel) const override;
 protected:
 	int			m_Start;
 	int			m_End;
@@ -162,6 +168,7 @@ public:
 
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	int			GetTickKey(bool &parallel) const override;
 protected:
 	uint8_t		m_BaseLevel;
 	uint8_t		m_Phase;
@@ -1057,3 +1064,53 @@ void P_SpawnLights(sector_t *sector)
 	}
 }
 
+//-----------------------------------------------------------------------------
+//
+// Tick keys for parallel ticking. Every light effect only changes the light
+// level of its own sector, but the flickering ones need the random number
+// generators and a one-shot glow destroys itself, so those have to stay on
+// the main thread.
+//
+//-----------------------------------------------------------------------------
+
+int DFireFlicker::GetTickKey(bool &parallel) const
+{
+	parallel = false;
+	return m_Sector->Index();
+}
+
+int DFlicker::GetTickKey(bool &parallel) const
+{
+	parallel = false;
+	return m_Sector->Index();
+}
+
+int DLightFlash::GetTickKey(bool &parallel) const
+{
+	parallel = false;
+	return m_Sector->Index();
+}
+
+int DStrobe::GetTickKey(bool &parallel) const
+{
+	parallel = true;
+	return m_Sector->Index();
+}
+
+int DGlow::GetTickKey(bool &parallel) const
+{
+	parallel = true;
+	return m_Sector->Index();
+}
+
+int DGlow2::GetTickKey(bool &parallel) const
+{
+	parallel = !m_OneShot;
+	return m_Sector->Index();
+}
+
+int DPhased::GetTickKey(bool &parallel) const
+{
+	parallel = true;
+	return m_Sector->Index();
+}
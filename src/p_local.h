@@ -51,6 +51,7 @@ struct secplane_t;
 struct FCheckPosition;
 struct FTranslatedLineTarget;
 struct FLinePortal;
+class FTraceBatch;
 
 #include <stdlib.h>
 
@@ -279,6 +280,7 @@ void	P_SlideMove (AActor* mo, const DVector2 &pos, int numsteps);
 bool	P_BounceWall (AActor *mo);
 bool	P_BounceActor (AActor *mo, AActor *BlockingMobj, bool ontop);
 bool	P_CheckSight (AActor *t1, AActor *t2, int flags=0);
+bool	P_SightPossible (AActor *t1, AActor *t2, int flags=0);
 
 enum ESightFlags
 {
@@ -289,6 +291,8 @@ enum ESightFlags
 };
 
 void	P_ResetSightCounters (bool full);
+void	P_PrefetchSight ();
+void	P_ClearSightCache ();
 bool	P_TalkFacing (AActor *player);
 void	P_UseLines (player_t* player);
 bool	P_UsePuzzleItem (AActor *actor, int itemType);
@@ -331,8 +335,9 @@ enum	// P_LineAttack flags
 	LAF_OVERRIDEZ =		32,
 };
 
-AActor *P_LineAttack(AActor *t1, DAngle angle, double distance, DAngle pitch, int damage, FName damageType, PClassActor *pufftype, int flags = 0, FTranslatedLineTarget *victim = NULL, int *actualdamage = NULL, double sz = 0.0);
+AActor *P_LineAttack(AActor *t1, DAngle angle, double distance, DAngle pitch, int damage, FName damageType, PClassActor *pufftype, int flags = 0, FTranslatedLineTarget *victim = NULL, int *actualdamage = NULL, double sz = 0.0, FTraceBatch *batch = NULL);
 AActor *P_LineAttack(AActor *t1, DAngle angle, double distance, DAngle pitch, int damage, FName damageType, FName pufftype, int flags = 0, FTranslatedLineTarget *victim = NULL, int *actualdamage = NULL, double sz = 0.0);
+bool P_LineAttackBatch(FTraceBatch &batch, AActor *t1, const DAngle *angles, const DAngle *pitches, int count, double distance, PClassActor *pufftype, int flags = 0, double sz = 0.0);
 
 void	P_TraceBleed(int damage, const DVector3 &pos, AActor *target, DAngle angle, DAngle pitch);
 void	P_TraceBleed(int damage, AActor *target, DAngle angle, DAngle pitch);
@@ -407,6 +412,9 @@ template<class nodetype, class linktype>
 nodetype* P_DelSecnode(nodetype *, nodetype *linktype::*head);
 
 msecnode_t *P_CreateSecNodeList(AActor *thing, double radius, msecnode_t *sector_list, msecnode_t *sector_t::*seclisthead);
+void	P_FreeSecnodes();
+void	P_ResetSecnodeBoxes();
+void	P_ResetSecnodeCounters();
 double	P_GetMoveFactor(const AActor *mo, double *frictionp);	// phares  3/6/98
 double		P_GetFriction(const AActor *mo, double *frictionfactor);
 
@@ -100,6 +100,7 @@
 #include "r_sky.h"
 #include "g_levellocals.h"
 #include "actorinlines.h"
+#include "p_navigation.h"
 
 CVAR(Bool, cl_bloodsplats, true, CVAR_ARCHIVE)
 CVAR(Int, sv_smartaim, 0, CVAR_ARCHIVE | CVAR_SERVERINFO)
@@ -385,7 +386,7 @@ void P_FindFloorCeiling(AActor *actor, int flags)
 	validcount++;
 
 	FPortalGroupArray grouplist;
-	FMultiBlockLinesIterator mit(grouplist, actor);
+	FMultiBlockLinesIterator mit(grouplist, actor, -1, true);
 	FMultiBlockLinesIterator::CheckResult cres;
 
 	// if we already have a valid floor/ceiling sector within the current sector, 
@@ -478,7 +479,7 @@ bool	P_TeleportMove(AActor* thing, const DVector3 &pos, bool telefrag, bool modi
 	sector_t *sector = P_PointInSector(pos);
 
 	FPortalGroupArray grouplist;
-	FMultiBlockLinesIterator mit(grouplist, pos.X, pos.Y, pos.Z, thing->Height, thing->radius, sector);
+	FMultiBlockLinesIterator mit(grouplist, pos.X, pos.Y, pos.Z, thing->Height, thing->radius, sector, true);
 	FMultiBlockLinesIterator::CheckResult cres;
 
 	while (mit.Next(&cres))
@@ -1131,7 +1132,7 @@ static bool PIT_CheckPortal(FMultiBlockLinesIterator &mit, FMultiBlockLinesItera
 	tm.thing->AddZ(zofs);
 
 	FBoundingBox pbox(cres.Position.X, cres.Position.Y, tm.thing->radius);
-	FBlockLinesIterator it(pbox);
+	FBlockLinesIterator it(pbox, true);
 	bool ret = false;
 	line_t *ld;
 
@@ -1290,13 +1291,13 @@ bool PIT_CheckThing(FMultiBlockThingsIterator &it, FMultiBlockThingsIterator::Ch
 	if (thing == tm.thing)
 		return true;
 
+	// Most things get rejected here, so check the distance first, before anything else is read from thing.
+	if (FMultiBlockThingsIterator::OutOfReach(cres, tm.thing->radius))
+		return true;
+
 	if (!((thing->flags & (MF_SOLID | MF_SPECIAL | MF_SHOOTABLE)) || thing->flags6 & MF6_TOUCHY))
 		return true;	// can't hit thing
 
-	double blockdist = thing->radius + tm.thing->radius;
-	if (fabs(thing->X() - cres.Position.X) >= blockdist || fabs(thing->Y() - cres.Position.Y) >= blockdist)
-		return true;
-
 	if ((thing->flags2 | tm.thing->flags2) & MF2_THRUACTORS)
 		return true;
 
@@ -1865,7 +1866,7 @@ bool P_CheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, boo
 	spechit.Clear();
 	portalhit.Clear();
 
-	FMultiBlockLinesIterator it(pcheck, pos.X, pos.Y, thing->Z(), thing->Height, thing->radius, newsec);
+	FMultiBlockLinesIterator it(pcheck, pos.X, pos.Y, thing->Z(), thing->Height, thing->radius, newsec, true);
 	FMultiBlockLinesIterator::CheckResult lcres;
 
 	double thingdropoffz = tm.floorz;
@@ -2015,8 +2016,7 @@ bool P_TestMobjZ(AActor *actor, bool quick, AActor **pOnmobj)
 	{
 		AActor *thing = cres.thing;
 
-		double blockdist = thing->radius + actor->radius;
-		if (fabs(thing->X() - cres.Position.X) >= blockdist || fabs(thing->Y() - cres.Position.Y) >= blockdist)
+		if (FMultiBlockThingsIterator::OutOfReach(cres, actor->radius))
 		{
 			continue;
 		}
@@ -4381,6 +4381,46 @@ static ETraceStatus CheckForActor(FTraceResults &res, void *userdata)
 	return TRACE_Stop;
 }
 
+//==========================================================================
+//
+// Height a hitscan attack is fired from
+//
+//==========================================================================
+
+static double P_LineAttackZ(AActor *t1, int flags, double sz)
+{
+	double shootz = t1->Center() - t1->Floorclip;
+
+	if (t1->player != NULL)
+	{
+		shootz += t1->player->mo->AttackZOffset * t1->player->crouchfactor;
+	}
+	else
+	{
+		shootz += 8;
+	}
+
+	// [MC] If overriding, set it to the base of the actor.
+	// Offset by the amount specified.
+	if (flags & LAF_OVERRIDEZ)
+		shootz = t1->Z();
+	return shootz + sz;
+}
+
+static DVector3 P_LineAttackDirection(DAngle angle, DAngle pitch)
+{
+	double pc = pitch.Cos();
+	return { pc * angle.Cos(), pc * angle.Sin(), -pitch.Sin() };
+}
+
+static bool P_LineAttackHitsGhosts(AActor *t1, AActor *puffDefaults)
+{
+	return (t1->player != NULL &&
+		t1->player->ReadyWeapon != NULL &&
+		(t1->player->ReadyWeapon->flags2 & MF2_THRUGHOST)) ||
+		(puffDefaults && (puffDefaults->flags2 & MF2_THRUGHOST));
+}
+
 //==========================================================================
 //
 // P_LineAttack
@@ -4390,7 +4430,8 @@ static ETraceStatus CheckForActor(FTraceResults &res, void *userdata)
 //==========================================================================
 
 AActor *P_LineAttack(AActor *t1, DAngle angle, double distance,
-	DAngle pitch, int damage, FName damageType, PClassActor *pufftype, int flags, FTranslatedLineTarget*victim, int *actualdamage, double sz)
+	DAngle pitch, int damage, FName damageType, PClassActor *pufftype, int flags, FTranslatedLineTarget*victim, int *actualdamage, double sz,
+	FTraceBatch *batch)
 {
 	bool nointeract = !!(flags & LAF_NOINTERACT);
 	DVector3 direction;
@@ -4415,39 +4456,20 @@ AActor *P_LineAttack(AActor *t1, DAngle angle, double distance,
 		*actualdamage = 0;
 	}
 
-	double pc = pitch.Cos();
-
-	direction = { pc * angle.Cos(), pc * angle.Sin(), -pitch.Sin() };
-	shootz = t1->Center() - t1->Floorclip;
+	direction = P_LineAttackDirection(angle, pitch);
+	shootz = P_LineAttackZ(t1, flags, sz);
 
-	if (t1->player != NULL)
+	if (t1->player != NULL && (damageType == NAME_Melee || damageType == NAME_Hitscan))
 	{
-		shootz += t1->player->mo->AttackZOffset * t1->player->crouchfactor;
-		if (damageType == NAME_Melee || damageType == NAME_Hitscan)
-		{
-			// this is coming from a weapon attack function which needs to transfer information to the obituary code,
-			// We need to preserve this info from the damage type because the actual damage type can get overridden by the puff
-			pflag = DMG_PLAYERATTACK;
-		}
+		// this is coming from a weapon attack function which needs to transfer information to the obituary code,
+		// We need to preserve this info from the damage type because the actual damage type can get overridden by the puff
+		pflag = DMG_PLAYERATTACK;
 	}
-	else
-	{
-		shootz += 8;
-	}
-
-	// [MC] If overriding, set it to the base of the actor.
-	// Offset by the amount specified.
-	if (flags & LAF_OVERRIDEZ)
-		shootz = t1->Z();
-	shootz += sz;
 
 	// We need to check the defaults of the replacement here
 	AActor *puffDefaults = GetDefaultByType(pufftype->GetReplacement());
 	
-	TData.hitGhosts = (t1->player != NULL &&
-		t1->player->ReadyWeapon != NULL &&
-		(t1->player->ReadyWeapon->flags2 & MF2_THRUGHOST)) ||
-		(puffDefaults && (puffDefaults->flags2 & MF2_THRUGHOST));
+	TData.hitGhosts = P_LineAttackHitsGhosts(t1, puffDefaults);
 	
 	spawnSky = (puffDefaults && (puffDefaults->flags3 & MF3_SKYEXPLODE));
 	TData.MThruSpecies = (puffDefaults && (puffDefaults->flags6 & MF6_MTHRUSPECIES));
@@ -4491,8 +4513,13 @@ AActor *P_LineAttack(AActor *t1, DAngle angle, double distance,
 	if (nointeract || (puffDefaults && puffDefaults->flags6 & MF6_NOTRIGGER)) tflags = TRACE_NoSky;
 	else tflags = TRACE_NoSky | TRACE_Impact;
 
-	if (!Trace(t1->PosAtZ(shootz), t1->Sector, direction, distance, MF_SHOOTABLE, 
-		ML_BLOCKEVERYTHING | ML_BLOCKHITSCAN, t1, trace, tflags, CheckForActor, &TData))
+	bool hit;
+	if (batch == nullptr || !batch->Take(t1->PosAtZ(shootz), t1->Sector, direction, trace, hit))
+	{
+		hit = Trace(t1->PosAtZ(shootz), t1->Sector, direction, distance, MF_SHOOTABLE,
+			ML_BLOCKEVERYTHING | ML_BLOCKHITSCAN, t1, trace, tflags, CheckForActor, &TData);
+	}
+	if (!hit)
 	{ // hit nothing
 		if (!nointeract && puffDefaults && puffDefaults->ActiveSound)
 		{ // Play miss sound
@@ -4526,7 +4553,7 @@ AActor *P_LineAttack(AActor *t1, DAngle angle, double distance,
 				DVector2 pos = P_GetOffsetPosition(trace.HitPos.X, trace.HitPos.Y, -trace.HitVector.X * 4, -trace.HitVector.Y * 4);
 				puff = P_SpawnPuff(t1, pufftype, DVector3(pos, trace.HitPos.Z - trace.HitVector.Z * 4), trace.SrcAngleFromTarget,
 					trace.SrcAngleFromTarget - 90, 0, puffFlags);
-				puff->radius = 1/65536.;
+				puff->SetRadius(1/65536.);
 
 				if (nointeract)
 				{
@@ -4715,6 +4742,49 @@ AActor *P_LineAttack(AActor *t1, DAngle angle, double distance,
 	}
 }
 
+//==========================================================================
+//
+// P_LineAttackBatch
+//
+// Traces the pellets of a multi-bullet attack at once. The P_LineAttack
+// calls that fire them must follow in the same order and get the batch
+// passed. Each takes its pellet's result if it is still valid and traces
+// again otherwise.
+//
+//==========================================================================
+
+bool P_LineAttackBatch(FTraceBatch &batch, AActor *t1, const DAngle *angles, const DAngle *pitches, int count,
+	double distance, PClassActor *pufftype, int flags, double sz)
+{
+	batch.Clear();
+	if (count < 2 || !FTraceBatch::IsUsable()) return false;
+
+	AActor *puffDefaults = GetDefaultByType(pufftype->GetReplacement());
+
+	// These need a temporary puff or the actors' species, neither of which the workers can get.
+	if ((puffDefaults->flags7 & MF7_ALLOWTHRUFLAGS) || (puffDefaults->flags6 & MF6_MTHRUSPECIES)) return false;
+
+	Origin TData;
+	TData.Caller = t1;
+	TData.PuffSpecies = NAME_None;
+	TData.hitGhosts = P_LineAttackHitsGhosts(t1, puffDefaults);
+	TData.MThruSpecies = false;
+	TData.ThruSpecies = false;
+	TData.ThruActors = false;
+
+	int tflags;
+	if ((flags & LAF_NOINTERACT) || (puffDefaults->flags6 & MF6_NOTRIGGER)) tflags = TRACE_NoSky;
+	else tflags = TRACE_NoSky | TRACE_Impact;
+
+	for (int i = 0; i < count; i++)
+	{
+		batch.AddRay(P_LineAttackDirection(angles[i], pitches[i]));
+	}
+	batch.Run(t1->PosAtZ(P_LineAttackZ(t1, flags, sz)), t1->Sector, distance, MF_SHOOTABLE,
+		ML_BLOCKEVERYTHING | ML_BLOCKHITSCAN, t1, tflags, CheckForActor, &TData);
+	return true;
+}
+
 DEFINE_ACTION_FUNCTION(AActor, LineAttack)
 {
 	PARAM_SELF_PROLOGUE(AActor);
@@ -4736,6 +4806,43 @@ DEFINE_ACTION_FUNCTION(AActor, LineAttack)
 	return numret;
 }
 
+//==========================================================================
+//
+// Fires one LineAttack per entry, in order, with the traces done as a batch.
+// The random numbers for all pellets must be drawn before this is called.
+//
+//==========================================================================
+
+DEFINE_ACTION_FUNCTION(AActor, LineAttackBatch)
+{
+	PARAM_SELF_PROLOGUE(AActor);
+	PARAM_POINTER(angles, TArray<double>);
+	PARAM_POINTER(pitches, TArray<double>);
+	PARAM_POINTER(damages, TArray<int>);
+	PARAM_FLOAT(distance);
+	PARAM_NAME(damageType);
+	PARAM_CLASS(puffType, AActor);
+	PARAM_INT_DEF(flags);
+	PARAM_FLOAT_DEF(offsetz);
+
+	if (puffType == nullptr) puffType = PClass::FindActor("BulletPuff");	// P_LineAttack does not work without a puff to take info from.
+	unsigned count = MIN(angles->Size(), MIN(pitches->Size(), damages->Size()));
+	TArray<DAngle> a(count), p(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		a.Push((*angles)[i]);
+		p.Push((*pitches)[i]);
+	}
+
+	FTraceBatch batch;
+	if (count > 0) P_LineAttackBatch(batch, self, &a[0], &p[0], count, distance, puffType, flags, offsetz);
+	for (unsigned i = 0; i < count; i++)
+	{
+		P_LineAttack(self, a[i], distance, p[i], (*damages)[i], damageType, puffType, flags, nullptr, nullptr, offsetz, &batch);
+	}
+	return 0;
+}
+
 //==========================================================================
 //
 // P_LinePickActor
@@ -5933,8 +6040,7 @@ void P_FindAboveIntersectors(AActor *actor)
 	while (it.Next(&cres))
 	{
 		AActor *thing = cres.thing;
-		double blockdist = actor->radius + thing->radius;
-		if (fabs(thing->X() - cres.Position.X) >= blockdist || fabs(thing->Y() - cres.Position.Y) >= blockdist)
+		if (FMultiBlockThingsIterator::OutOfReach(cres, actor->radius))
 			continue;
 
 		if (!(thing->flags & MF_SOLID))
@@ -5989,8 +6095,7 @@ void P_FindBelowIntersectors(AActor *actor)
 	while (it.Next(&cres))
 	{
 		AActor *thing = cres.thing;
-		double blockdist = actor->radius + thing->radius;
-		if (fabs(thing->X() - cres.Position.X) >= blockdist || fabs(thing->Y() - cres.Position.Y) >= blockdist)
+		if (FMultiBlockThingsIterator::OutOfReach(cres, actor->radius))
 			continue;
 
 		if (!(thing->flags & MF_SOLID))
@@ -6444,6 +6549,8 @@ bool P_ChangeSector(sector_t *sector, int crunch, double amt, int floorOrCeil, b
 	void(*iterator2)(AActor *, FChangePosition *) = NULL;
 	msecnode_t *n;
 
+	Navigation.SectorChanged(sector);
+
 	cpos.nofit = false;
 	cpos.crushchange = crunch;
 	cpos.moveamt = fabs(amt);
@@ -61,6 +61,9 @@
 
 
 #include <stdlib.h>
+#ifndef NO_SSE
+#include <xmmintrin.h>
+#endif
 
 
 #include "m_bbox.h"
@@ -83,6 +86,8 @@
 #include "g_levellocals.h"
 #include "vm.h"
 
+EXTERN_CVAR(Bool, p_actorhotfields)
+
 sector_t *P_PointInSectorBuggy(double x, double y);
 int P_VanillaPointOnDivlineSide(double x, double y, const divline_t* line);
 
@@ -473,6 +478,13 @@ void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sec
 	Sector = sector;
 	subsector = R_PointInSubsector(Pos());	// this is from the rendering nodes, not the gameplay nodes!
 
+	if (HotSlot < 0)
+	{
+		HotSlot = ActorHotFields.AllocSlot();
+	}
+	UpdateHotFields();
+	ActorHotFields.PortalGroup[HotSlot] = sector->PortalGroup;
+
 	if (!(flags & MF_NOSECTOR))
 	{
 		// invisible things don't go into the sector links
@@ -600,6 +612,7 @@ DEFINE_ACTION_FUNCTION(AActor, SetOrigin)
 //===========================================================================
 
 FBlockNode *FBlockNode::FreeBlocks = NULL;
+uint32_t FBlockNode::LinkCount;
 
 FBlockNode *FBlockNode::Create (AActor *who, int x, int y, int group)
 {
@@ -614,8 +627,10 @@ FBlockNode *FBlockNode::Create (AActor *who, int x, int y, int group)
 	{
 		block = new FBlockNode;
 	}
+	LinkCount++;
 	block->BlockIndex = x + y*level.blockmap.bmapwidth;
 	block->Me = who;
+	block->HotSlot = who->HotSlot;
 	block->NextActor = NULL;
 	block->PrevActor = NULL;
 	block->PrevBlock = NULL;
@@ -625,6 +640,7 @@ FBlockNode *FBlockNode::Create (AActor *who, int x, int y, int group)
 
 void FBlockNode::Release ()
 {
+	LinkCount++;
 	NextBlock = FreeBlocks;
 	FreeBlocks = this;
 }
@@ -652,22 +668,80 @@ FBlockLinesIterator::FBlockLinesIterator(int _minx, int _miny, int _maxx, int _m
 	maxx = _maxx;
 	miny = _miny;
 	maxy = _maxy;
+	boxfilter = false;
 	Reset();
 }
 
-void FBlockLinesIterator::init(const FBoundingBox &box)
+void FBlockLinesIterator::init(const FBoundingBox &box, bool filtered)
 {
 	validcount++;
 	maxy = level.blockmap.GetBlockY(box.Top());
 	miny = level.blockmap.GetBlockY(box.Bottom());
 	maxx = level.blockmap.GetBlockX(box.Right());
 	minx = level.blockmap.GetBlockX(box.Left());
+	boxfilter = false;
+	if (filtered)
+	{
+		// Nothing has been returned yet, so there is no group for SetBoxFilter to mask.
+		listpos = listend = 0;
+		SetBoxFilter(box);
+	}
 	Reset();
 }
 
-FBlockLinesIterator::FBlockLinesIterator(const FBoundingBox &box)
+void FBlockLinesIterator::SetBoxFilter(const FBoundingBox &box)
+{
+	boxfilter = true;
+	filterbox[BOXLEFT] = FBlockmap::RoundDown(box.Left());
+	filterbox[BOXBOTTOM] = FBlockmap::RoundDown(box.Bottom());
+	filterbox[BOXRIGHT] = FBlockmap::RoundUp(box.Right());
+	filterbox[BOXTOP] = FBlockmap::RoundUp(box.Top());
+	// Lines of the current group of 4 that were already returned stay done.
+	if (listpos < listend) linemask &= GetLineMask(listpos);
+}
+
+//===========================================================================
+//
+// FBlockLinesIterator :: GetLineMask
+//
+// Checks the 4 lines starting at pos (which must be a multiple of 4)
+// against the filter box. Returns one bit per line that may touch it.
+// The comparisons are the same as in FBoundingBox::inRange.
+//
+//===========================================================================
+
+int FBlockLinesIterator::GetLineMask(int pos) const
+{
+	if (!boxfilter)
+	{
+		return 15;
+	}
+	const FBlockmap &bmap = level.blockmap;
+#ifndef NO_SSE
+	__m128 left = _mm_loadu_ps(&bmap.FlatLeft[pos]);
+	__m128 bottom = _mm_loadu_ps(&bmap.FlatBottom[pos]);
+	__m128 right = _mm_loadu_ps(&bmap.FlatRight[pos]);
+	__m128 top = _mm_loadu_ps(&bmap.FlatTop[pos]);
+	__m128 inx = _mm_and_ps(_mm_cmplt_ps(_mm_set1_ps(filterbox[BOXLEFT]), right), _mm_cmpgt_ps(_mm_set1_ps(filterbox[BOXRIGHT]), left));
+	__m128 iny = _mm_and_ps(_mm_cmpgt_ps(_mm_set1_ps(filterbox[BOXTOP]), bottom), _mm_cmplt_ps(_mm_set1_ps(filterbox[BOXBOTTOM]), top));
+	return _mm_movemask_ps(_mm_and_ps(inx, iny));
+#else
+	int mask = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (filterbox[BOXLEFT] < bmap.FlatRight[pos + i] && filterbox[BOXRIGHT] > bmap.FlatLeft[pos + i] &&
+			filterbox[BOXTOP] > bmap.FlatBottom[pos + i] && filterbox[BOXBOTTOM] < bmap.FlatTop[pos + i])
+		{
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+FBlockLinesIterator::FBlockLinesIterator(const FBoundingBox &box, bool filtered)
 {
-	init(box);
+	init(box, filtered);
 }
 
 //===========================================================================
@@ -686,12 +760,14 @@ void FBlockLinesIterator::StartBlock(int x, int y)
 		polyLink = PolyBlockMap? PolyBlockMap[offset] : NULL;
 		polyIndex = 0;
 
-		list = level.blockmap.GetLines(x, y);
+		listpos = level.blockmap.FlatStart[offset];
+		listend = level.blockmap.FlatStart[offset + 1];
+		linemask = listpos < listend ? GetLineMask(listpos) : 0;
 	}
 	else
 	{
 		// invalid block
-		list = NULL;
+		listpos = listend = -1;
 		polyLink = NULL;
 	}
 }
@@ -741,18 +817,26 @@ line_t *FBlockLinesIterator::Next()
 			else polyLink = polyLink->next;
 		}
 
-		if (list != NULL)
+		while (listpos < listend)
 		{
-			while (*list != -1)
+			if (linemask == 0)
 			{
-				line_t *ld = &level.lines[*list];
+				listpos += 4;
+				if (listpos < listend) linemask = GetLineMask(listpos);
+				continue;
+			}
+			int i = 0;
+			while (!(linemask & (1 << i))) i++;
+			linemask &= linemask - 1;
 
-				list++;
-				if (ld->validcount != validcount)
-				{
-					ld->validcount = validcount;
-					return ld;
-				}
+			int lineindex = level.blockmap.FlatLines[listpos + i];
+			if (lineindex < 0) continue;	// padding
+
+			line_t *ld = &level.lines[lineindex];
+			if (ld->validcount != validcount)
+			{
+				ld->validcount = validcount;
+				return ld;
 			}
 		}
 
@@ -773,8 +857,8 @@ line_t *FBlockLinesIterator::Next()
 //
 //===========================================================================
 
-FMultiBlockLinesIterator::FMultiBlockLinesIterator(FPortalGroupArray &check, AActor *origin, double checkradius)
-	: checklist(check)
+FMultiBlockLinesIterator::FMultiBlockLinesIterator(FPortalGroupArray &check, AActor *origin, double checkradius, bool filtered)
+	: checklist(check), filtered(filtered)
 {
 	checkpoint = origin->Pos();
 	if (!check.inited) P_CollectConnectedGroups(origin->Sector->PortalGroup, checkpoint, origin->Top(), checkradius, checklist);
@@ -784,8 +868,8 @@ FMultiBlockLinesIterator::FMultiBlockLinesIterator(FPortalGroupArray &check, AAc
 	Reset();
 }
 
-FMultiBlockLinesIterator::FMultiBlockLinesIterator(FPortalGroupArray &check, double checkx, double checky, double checkz, double checkh, double checkradius, sector_t *newsec)
-	: checklist(check)
+FMultiBlockLinesIterator::FMultiBlockLinesIterator(FPortalGroupArray &check, double checkx, double checky, double checkz, double checkh, double checkradius, sector_t *newsec, bool filtered)
+	: checklist(check), filtered(filtered)
 {
 	checkpoint = { checkx, checky, checkz };
 	if (newsec == NULL)	newsec = P_PointInSector(checkx, checky);
@@ -912,7 +996,7 @@ void FMultiBlockLinesIterator::startIteratorForGroup(int group)
 	offset.Y += checkpoint.Y;
 	cursector = group == startsector->PortalGroup ? startsector : P_PointInSector(offset);
 	bbox.setBox(offset.X, offset.Y, checkpoint.Z);
-	blockIterator.init(bbox);
+	blockIterator.init(bbox, filtered);
 }
 
 //===========================================================================
@@ -1097,6 +1181,8 @@ AActor *FBlockThingsIterator::Next(bool centeronly)
 			HashEntry *entry;
 			int i;
 
+			LastHotSlot = mynode->HotSlot;
+
 			block = block->NextActor;
 			// Don't recheck things that were already checked
 			if (mynode->NextBlock == NULL && mynode->PrevBlock == &me->BlockNode)
@@ -1106,10 +1192,10 @@ AActor *FBlockThingsIterator::Next(bool centeronly)
 			if (centeronly)
 			{
 				// Block boundaries for compatibility mode
-				double blockleft = (curx * FBlockmap::MAPBLOCKUNITS) + level.blockmap.bmaporgx;
-				double blockright = blockleft + FBlockmap::MAPBLOCKUNITS;
-				double blockbottom = (cury * FBlockmap::MAPBLOCKUNITS) + level.blockmap.bmaporgy;
-				double blocktop = blockbottom + FBlockmap::MAPBLOCKUNITS;
+				double blockleft = (curx * level.blockmap.BlockSize) + level.blockmap.bmaporgx;
+				double blockright = blockleft + level.blockmap.BlockSize;
+				double blockbottom = (cury * level.blockmap.BlockSize) + level.blockmap.bmaporgy;
+				double blocktop = blockbottom + level.blockmap.BlockSize;
 
 				// only return actors with the center in this block
 				if (me->X() >= blockleft && me->X() < blockright &&
@@ -1208,8 +1294,11 @@ bool FMultiBlockThingsIterator::Next(FMultiBlockThingsIterator::CheckResult *ite
 	AActor *thing = blockIterator.Next();
 	if (thing != NULL)
 	{
+		// Use the hot field copies so that rejecting the thing doesn't need to touch it.
+		int slot = p_actorhotfields ? blockIterator.LastHotSlot : -1;
 		item->thing = thing;
-		item->Position = checkpoint + Displacements.getOffset(basegroup, thing->Sector->PortalGroup);
+		item->HotSlot = slot;
+		item->Position = checkpoint + Displacements.getOffset(basegroup, slot >= 0 ? ActorHotFields.PortalGroup[slot] : thing->Sector->PortalGroup);
 		item->portalflags = portalflags;
 		return true;
 	}
@@ -1342,7 +1431,7 @@ DEFINE_FIELD_NAMED(DBlockThingsIterator, cres.portalflags, portalflags);
 //
 //===========================================================================
 
-TArray<intercept_t> FPathTraverse::intercepts(128);
+thread_local TArray<intercept_t> FPathTraverse::intercepts(128);
 
 
 //===========================================================================
@@ -1362,32 +1451,44 @@ void FPathTraverse::AddLineIntercepts(int bx, int by)
 	FBlockLinesIterator it(bx, by, bx, by, true);
 	line_t *ld;
 
+	it.SetBoxFilter(TraceBox);
 	while ((ld = it.Next()))
 	{
-		int 				s1;
-		int 				s2;
-		double 				frac;
-		divline_t			dl;
+		AddLineIntercept(ld);
+	}
+}
 
-		s1 = P_PointOnDivlineSide (ld->v1->fX(), ld->v1->fY(), &trace);
-		s2 = P_PointOnDivlineSide (ld->v2->fX(), ld->v2->fY(), &trace);
-		
-		if (s1 == s2) continue;	// line isn't crossed
-		
-		// hit the line
-		P_MakeDivline (ld, &dl);
-		frac = P_InterceptVector (&trace, &dl);
+//===========================================================================
+//
+// FPathTraverse :: AddLineIntercept
+//
+//===========================================================================
 
-		if (frac < Startfrac || frac > 1.) continue;	// behind source or beyond end point
-			
-		intercept_t newintercept;
+void FPathTraverse::AddLineIntercept(line_t *ld)
+{
+	int 				s1;
+	int 				s2;
+	double 				frac;
+	divline_t			dl;
 
-		newintercept.frac = frac;
-		newintercept.isaline = true;
-		newintercept.done = false;
-		newintercept.d.line = ld;
-		intercepts.Push (newintercept);
-	}
+	s1 = P_PointOnDivlineSide (ld->v1->fX(), ld->v1->fY(), &trace);
+	s2 = P_PointOnDivlineSide (ld->v2->fX(), ld->v2->fY(), &trace);
+	
+	if (s1 == s2) return;	// line isn't crossed
+	
+	// hit the line
+	P_MakeDivline (ld, &dl);
+	frac = P_InterceptVector (&trace, &dl);
+
+	if (frac < Startfrac || frac > 1.) return;	// behind source or beyond end point
+		
+	intercept_t newintercept;
+
+	newintercept.frac = frac;
+	newintercept.isaline = true;
+	newintercept.done = false;
+	newintercept.d.line = ld;
+	intercepts.Push (newintercept);
 }
 
 
@@ -1404,163 +1505,174 @@ void FPathTraverse::AddThingIntercepts (int bx, int by, FBlockThingsIterator &it
 	it.SwitchBlock(bx, by);
 	while ((thing = it.Next(compatible)))
 	{
-		int numfronts = 0;
-		divline_t line;
-		int i;
+		AddThingIntercept(thing, compatible);
+	}
+}
 
+//===========================================================================
+//
+// FPathTraverse :: AddThingIntercept
+//
+//===========================================================================
 
-		if (!compatible)
-		{
-			// [RH] Don't check a corner to corner crossection for hit.
-			// Instead, check against the actual bounding box (but not if compatibility optioned.)
+void FPathTraverse::AddThingIntercept(AActor *thing, bool compatible)
+{
+	int numfronts = 0;
+	divline_t line;
+	int i;
+
+
+	if (!compatible)
+	{
+		// [RH] Don't check a corner to corner crossection for hit.
+		// Instead, check against the actual bounding box (but not if compatibility optioned.)
 
-			// There's probably a smarter way to determine which two sides
-			// of the thing face the trace than by trying all four sides...
-			for (i = 0; i < 4; ++i)
+		// There's probably a smarter way to determine which two sides
+		// of the thing face the trace than by trying all four sides...
+		for (i = 0; i < 4; ++i)
+		{
+			switch (i)
 			{
-				switch (i)
-				{
-				case 0:		// Top edge
-					line.y = thing->Y() + thing->radius;
-					if (trace.y < line.y) continue;
-					line.x = thing->X() + thing->radius;
-					line.dx = -thing->radius * 2;
-					line.dy = 0;
-					break;
-
-				case 1:		// Right edge
-					line.x = thing->X() + thing->radius;
-					if (trace.x < line.x) continue;
-					line.y = thing->Y() - thing->radius;
-					line.dx = 0;
-					line.dy = thing->radius * 2;
-					break;
-
-				case 2:		// Bottom edge
-					line.y = thing->Y() - thing->radius;
-					if (trace.y > line.y) continue;
-					line.x = thing->X() - thing->radius;
-					line.dx = thing->radius * 2;
-					line.dy = 0;
-					break;
-
-				case 3:		// Left edge
-					line.x = thing->X() - thing->radius;
-					if (trace.x > line.x) continue;
-					line.y = thing->Y() + thing->radius;
-					line.dx = 0;
-					line.dy = thing->radius * -2;
-					break;
-				}
-				// Check if this side is facing the trace origin
-				numfronts++;
+			case 0:		// Top edge
+				line.y = thing->Y() + thing->radius;
+				if (trace.y < line.y) continue;
+				line.x = thing->X() + thing->radius;
+				line.dx = -thing->radius * 2;
+				line.dy = 0;
+				break;
+
+			case 1:		// Right edge
+				line.x = thing->X() + thing->radius;
+				if (trace.x < line.x) continue;
+				line.y = thing->Y() - thing->radius;
+				line.dx = 0;
+				line.dy = thing->radius * 2;
+				break;
+
+			case 2:		// Bottom edge
+				line.y = thing->Y() - thing->radius;
+				if (trace.y > line.y) continue;
+				line.x = thing->X() - thing->radius;
+				line.dx = thing->radius * 2;
+				line.dy = 0;
+				break;
+
+			case 3:		// Left edge
+				line.x = thing->X() - thing->radius;
+				if (trace.x > line.x) continue;
+				line.y = thing->Y() + thing->radius;
+				line.dx = 0;
+				line.dy = thing->radius * -2;
+				break;
+			}
+			// Check if this side is facing the trace origin
+			numfronts++;
 
-				// If it is, see if the trace crosses it
-				if (P_PointOnDivlineSide (line.x, line.y, &trace) !=
-					P_PointOnDivlineSide (line.x + line.dx, line.y + line.dy, &trace))
-				{
-					// It's a hit
-					double frac = P_InterceptVector (&trace, &line);
-					if (frac < Startfrac)
-					{ // behind source
-						if (Startfrac > 0)
+			// If it is, see if the trace crosses it
+			if (P_PointOnDivlineSide (line.x, line.y, &trace) !=
+				P_PointOnDivlineSide (line.x + line.dx, line.y + line.dy, &trace))
+			{
+				// It's a hit
+				double frac = P_InterceptVector (&trace, &line);
+				if (frac < Startfrac)
+				{ // behind source
+					if (Startfrac > 0)
+					{
+						// check if the trace starts within this actor
+						switch (i)
 						{
-							// check if the trace starts within this actor
-							switch (i)
-							{
-							case 0:
-								line.y -= 2 * thing->radius;
-								break;
-
-							case 1:
-								line.x -= 2 * thing->radius;
-								break;
-
-							case 2:
-								line.y += 2 * thing->radius;
-								break;
-
-							case 3:
-								line.x += 2 * thing->radius;
-								break;
-							}
-							double frac2 = P_InterceptVector(&trace, &line);
-							if (frac2 >= Startfrac) goto addit;
+						case 0:
+							line.y -= 2 * thing->radius;
+							break;
+
+						case 1:
+							line.x -= 2 * thing->radius;
+							break;
+
+						case 2:
+							line.y += 2 * thing->radius;
+							break;
+
+						case 3:
+							line.x += 2 * thing->radius;
+							break;
 						}
-						continue;
+						double frac2 = P_InterceptVector(&trace, &line);
+						if (frac2 >= Startfrac) goto addit;
 					}
-				addit:
-					intercept_t newintercept;
-					newintercept.frac = frac;
-					newintercept.isaline = false;
-					newintercept.done = false;
-					newintercept.d.thing = thing;
-					intercepts.Push (newintercept);
-					break;
+					continue;
 				}
-			}
-
-			// If none of the sides was facing the trace, then the trace
-			// must have started inside the box, so add it as an intercept.
-			if (numfronts == 0)
-			{
+			addit:
 				intercept_t newintercept;
-				newintercept.frac = 0;
+				newintercept.frac = frac;
 				newintercept.isaline = false;
 				newintercept.done = false;
 				newintercept.d.thing = thing;
 				intercepts.Push (newintercept);
+				break;
 			}
 		}
+
+		// If none of the sides was facing the trace, then the trace
+		// must have started inside the box, so add it as an intercept.
+		if (numfronts == 0)
+		{
+			intercept_t newintercept;
+			newintercept.frac = 0;
+			newintercept.isaline = false;
+			newintercept.done = false;
+			newintercept.d.thing = thing;
+			intercepts.Push (newintercept);
+		}
+	}
+	else
+	{
+		// Old code for compatibility purposes
+		double 		x1, y1, x2, y2;
+		int 			s1, s2;
+		divline_t		dl;
+		double 		frac;
+			
+		bool tracepositive = (trace.dx * trace.dy)>0;
+					
+		// check a corner to corner crossection for hit
+		if (tracepositive)
+		{
+			x1 = thing->X() - thing->radius;
+			y1 = thing->Y() + thing->radius;
+					
+			x2 = thing->X() + thing->radius;
+			y2 = thing->Y() - thing->radius;					
+		}
 		else
 		{
-			// Old code for compatibility purposes
-			double 		x1, y1, x2, y2;
-			int 			s1, s2;
-			divline_t		dl;
-			double 		frac;
-				
-			bool tracepositive = (trace.dx * trace.dy)>0;
-						
-			// check a corner to corner crossection for hit
-			if (tracepositive)
-			{
-				x1 = thing->X() - thing->radius;
-				y1 = thing->Y() + thing->radius;
-						
-				x2 = thing->X() + thing->radius;
-				y2 = thing->Y() - thing->radius;					
-			}
-			else
-			{
-				x1 = thing->X() - thing->radius;
-				y1 = thing->Y() - thing->radius;
-						
-				x2 = thing->X() + thing->radius;
-				y2 = thing->Y() + thing->radius;					
-			}
+			x1 = thing->X() - thing->radius;
+			y1 = thing->Y() - thing->radius;
+					
+			x2 = thing->X() + thing->radius;
+			y2 = thing->Y() + thing->radius;					
+		}
+		
+		s1 = P_PointOnDivlineSide (x1, y1, &trace);
+		s2 = P_PointOnDivlineSide (x2, y2, &trace);
+
+		if (s1 != s2)
+		{
+			dl.x = x1;
+			dl.y = y1;
+			dl.dx = x2-x1;
+			dl.dy = y2-y1;
 			
-			s1 = P_PointOnDivlineSide (x1, y1, &trace);
-			s2 = P_PointOnDivlineSide (x2, y2, &trace);
+			frac = P_InterceptVector (&trace, &dl);
 
-			if (s1 != s2)
+			if (frac >= Startfrac)
 			{
-				dl.x = x1;
-				dl.y = y1;
-				dl.dx = x2-x1;
-				dl.dy = y2-y1;
-				
-				frac = P_InterceptVector (&trace, &dl);
-
-				if (frac >= Startfrac)
-				{
-					intercept_t newintercept;
-					newintercept.frac = frac;
-					newintercept.isaline = false;
-					newintercept.done = false;
-					newintercept.d.thing = thing;
-					intercepts.Push (newintercept);
-				}
+				intercept_t newintercept;
+				newintercept.frac = frac;
+				newintercept.isaline = false;
+				newintercept.done = false;
+				newintercept.d.thing = thing;
+				intercepts.Push (newintercept);
 			}
 		}
 	}
@@ -1627,6 +1739,11 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 		trace.dx = x2 - x1;
 		trace.dy = y2 - y1;
 	}
+	// Lines outside this cannot be crossed between frac 0 and 1. The extra
+	// unit keeps lines touching the trace's ends.
+	TraceBox = FBoundingBox(MIN(trace.x, trace.x + trace.dx) - 1, MIN(trace.y, trace.y + trace.dy) - 1,
+		MAX(trace.x, trace.x + trace.dx) + 1, MAX(trace.y, trace.y + trace.dy) + 1);
+
 	if (startfrac > 0)
 	{
 		double startdx = trace.dx * startfrac;
@@ -1639,7 +1756,7 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 		flags |= PT_DELTA;
 	}
 
-	validcount++;
+	StartLineChecks();
 	intercept_index = intercepts.Size();
 	Startfrac = startfrac;
 
@@ -1651,13 +1768,13 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 
 	x1 -= level.blockmap.bmaporgx;
 	y1 -= level.blockmap.bmaporgy;
-	xt1 = x1 / FBlockmap::MAPBLOCKUNITS;
-	yt1 = y1 / FBlockmap::MAPBLOCKUNITS;
+	xt1 = x1 / level.blockmap.BlockSize;
+	yt1 = y1 / level.blockmap.BlockSize;
 
 	x2 -= level.blockmap.bmaporgx;
 	y2 -= level.blockmap.bmaporgy;
-	xt2 = x2 / FBlockmap::MAPBLOCKUNITS;
-	yt2 = y2 / FBlockmap::MAPBLOCKUNITS;
+	xt2 = x2 / level.blockmap.BlockSize;
+	yt2 = y2 / level.blockmap.BlockSize;
 
 	mapx = xs_FloorToInt(xt1);
 	mapy = xs_FloorToInt(yt1);
@@ -1865,7 +1982,7 @@ FPathTraverse::~FPathTraverse()
 // P_RoughMonsterSearch
 //
 // Searches though the surrounding mapblocks for monsters/players
-//		distance is in FBlockmap::MAPBLOCKUNITS
+//		distance is in blocks of FBlockmap::MAPBLOCKUNITS size
 //===========================================================================
 
 AActor *P_BlockmapSearch (AActor *mo, int distance, AActor *(*check)(AActor*, int, void *), void *params)
@@ -1886,6 +2003,12 @@ AActor *P_BlockmapSearch (AActor *mo, int distance, AActor *(*check)(AActor*, in
 	startX = level.blockmap.GetBlockX(mo->X());
 	startY = level.blockmap.GetBlockY(mo->Y());
 	validcount++;
+
+	// Keep the search area the same for other block sizes.
+	if (level.blockmap.BlockSize != FBlockmap::MAPBLOCKUNITS)
+	{
+		distance = MAX(1, distance * FBlockmap::MAPBLOCKUNITS / level.blockmap.BlockSize);
+	}
 	
 	if (level.blockmap.isValidBlock(startX, startY))
 	{
@@ -210,17 +210,26 @@ class FBlockLinesIterator
 	int curx, cury;
 	polyblock_t *polyLink;
 	int polyIndex;
-	int *list;
+	int listpos, listend;	// current group of 4 and end of the block in FBlockmap::FlatLines
+	int linemask;			// lines of the current group that are still to be returned
+	bool boxfilter;
+	float filterbox[4];
 
 	void StartBlock(int x, int y);
+	int GetLineMask(int pos) const;
 
-	FBlockLinesIterator() {}
-	void init(const FBoundingBox &box);
+	FBlockLinesIterator() : listpos(0), listend(0) {}
+	void init(const FBoundingBox &box, bool filtered);
 public:
 	FBlockLinesIterator(int minx, int miny, int maxx, int maxy, bool keepvalidcount = false);
-	FBlockLinesIterator(const FBoundingBox &box);
+	// If filtered is set, only returns lines whose bounding box overlaps the given one.
+	// Only for callers that skip all other lines anyway.
+	FBlockLinesIterator(const FBoundingBox &box, bool filtered = false);
 	line_t *Next();
 	void Reset() { StartBlock(minx, miny); }
+	// Skips blockmap lines whose bounding box does not overlap the given one.
+	// Polyobject lines are always returned.
+	void SetBoxFilter(const FBoundingBox &box);
 };
 
 class FMultiBlockLinesIterator
@@ -235,6 +244,7 @@ class FMultiBlockLinesIterator
 	short index;
 	bool continueup;
 	bool continuedown;
+	bool filtered;
 	FBlockLinesIterator blockIterator;
 	FBoundingBox bbox;
 
@@ -251,8 +261,9 @@ public:
 		int portalflags;
 	};
 
-	FMultiBlockLinesIterator(FPortalGroupArray &check, AActor *origin, double checkradius = -1);
-	FMultiBlockLinesIterator(FPortalGroupArray &check, double checkx, double checky, double checkz, double checkh, double checkradius, sector_t *newsec);
+	// filtered works as for FBlockLinesIterator. The scripted iterator never sets it.
+	FMultiBlockLinesIterator(FPortalGroupArray &check, AActor *origin, double checkradius = -1, bool filtered = false);
+	FMultiBlockLinesIterator(FPortalGroupArray &check, double checkx, double checky, double checkz, double checkh, double checkradius, sector_t *newsec, bool filtered = false);
 
 	bool Next(CheckResult *item);
 	void Reset();
@@ -280,6 +291,7 @@ class FBlockThingsIterator
 	int curx, cury;
 
 	FBlockNode *block;
+	int LastHotSlot = -1;		// ActorHotFields slot of the actor Next returned last
 
 	int Buckets[32];
 
@@ -337,8 +349,12 @@ public:
 		AActor *thing;
 		DVector3 Position;
 		int portalflags;
+		int HotSlot;		// -1 if the thing's fields must be read directly
 	};
 
+	// Checks if the thing can't reach into a box of the given radius around the check position.
+	static inline bool OutOfReach(const CheckResult &cres, double radius);
+
 	FMultiBlockThingsIterator(FPortalGroupArray &check, AActor *origin, double checkradius = -1, bool ignorerestricted = false);
 	FMultiBlockThingsIterator(FPortalGroupArray &check, double checkx, double checky, double checkz, double checkh, double checkradius, bool ignorerestricted, sector_t *newsec);
 	bool Next(CheckResult *item);
@@ -354,9 +370,11 @@ public:
 class FPathTraverse
 {
 protected:
-	static TArray<intercept_t> intercepts;
+	// Per thread so that traversals can run on the job system's workers
+	static thread_local TArray<intercept_t> intercepts;
 
 	divline_t trace;
+	FBoundingBox TraceBox;
 	double Startfrac;
 	unsigned int intercept_index;
 	unsigned int intercept_count;
@@ -364,6 +382,10 @@ protected:
 
 	virtual void AddLineIntercepts(int bx, int by);
 	virtual void AddThingIntercepts(int bx, int by, FBlockThingsIterator &it, bool compatible);
+	// Called by init before any block is checked. Lines checked afterwards must not be returned again.
+	virtual void StartLineChecks() { validcount++; }
+	void AddLineIntercept(line_t *ld);
+	void AddThingIntercept(AActor *thing, bool compatible);
 	FPathTraverse() {}
 public:
 
@@ -186,6 +186,10 @@ AActor::~AActor ()
 {
 	// Please avoid calling the destructor directly (or through delete)!
 	// Use Destroy() instead.
+	if (HotSlot >= 0)
+	{
+		ActorHotFields.FreeSlot(HotSlot);
+	}
 }
 
 DEFINE_FIELD(AActor, snext)
@@ -576,11 +580,15 @@ AActor::AActor (const AActor &other) throw()
 	: DThinker()
 {
 	memcpy (&snext, &other.snext, (uint8_t *)&this[1] - (uint8_t *)&snext);
+	HotSlot = -1;
 }
 
 AActor &AActor::operator= (const AActor &other)
 {
+	int slot = HotSlot;
 	memcpy (&snext, &other.snext, (uint8_t *)&this[1] - (uint8_t *)&snext);
+	HotSlot = slot;
+	UpdateHotFields();
 	return *this;
 }
 
@@ -1771,7 +1779,7 @@ bool AActor::Grind(bool items)
 			flags &= ~MF_SOLID;
 			flags3 |= MF3_DONTGIB;
 			Height = 0;
-			radius = 0;
+			SetRadius(0);
 			return false;
 		}
 
@@ -1798,7 +1806,7 @@ bool AActor::Grind(bool items)
 			flags &= ~MF_SOLID;
 			flags3 |= MF3_DONTGIB;
 			Height = 0;
-			radius = 0;
+			SetRadius(0);
 			SetState (state);
 			if (isgeneric)	// Not a custom crush state, so colorize it appropriately.
 			{
@@ -1833,7 +1841,7 @@ bool AActor::Grind(bool items)
 				flags &= ~MF_SOLID;
 				flags3 |= MF3_DONTGIB;
 				Height = 0;
-				radius = 0;
+				SetRadius(0);
 				return false;
 			}
 
@@ -1843,7 +1851,7 @@ bool AActor::Grind(bool items)
 				gib->RenderStyle = RenderStyle;
 				gib->Alpha = Alpha;
 				gib->Height = 0;
-				gib->radius = 0;
+				gib->SetRadius(0);
 				gib->Translation = BloodTranslation;
 			}
 			S_Sound (this, CHAN_BODY, "misc/fallingsplat", 1, ATTN_IDLE);
@@ -5378,6 +5386,11 @@ void AActor::OnDestroy ()
 	// unlink from sector and block lists
 	UnlinkFromWorld (nullptr);
 	flags |= MF_NOSECTOR|MF_NOBLOCKMAP;
+	if (HotSlot >= 0)
+	{
+		ActorHotFields.FreeSlot(HotSlot);
+		HotSlot = -1;
+	}
 
 	// Transform any playing sound into positioned, non-actor sounds.
 	S_RelinkSound (this, NULL);
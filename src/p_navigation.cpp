@@ -0,0 +1,695 @@
+/*
+** p_navigation.cpp
+**
+** Sector graph and flow fields for monster navigation
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <float.h>
+#include <algorithm>
+#include <queue>
+#include <vector>
+#include "doomdef.h"
+#include "p_local.h"
+#include "p_lnspec.h"
+#include "p_navigation.h"
+#include "c_cvars.h"
+#include "vm.h"
+#include "stats.h"
+#include "g_levellocals.h"
+#include "actorinlines.h"
+#include "serializer.h"
+
+// Lets monsters and bots that cannot see what they are chasing follow the
+// sector graph. This changes gameplay, so it is off by default.
+CVAR(Bool, sv_monsternavigation, false, CVAR_SERVERINFO | CVAR_ARCHIVE)
+
+FSectorNavigation Navigation;
+
+// The standard walking monster the graph is made for
+static const double NAV_HEIGHT = 56.;
+static const double NAV_STEPHEIGHT = 24.;
+static const double NAV_DROPOFFHEIGHT = 24.;
+
+// How far behind the line to cross a waypoint is placed
+static const double NAV_OVERSHOOT = 16.;
+
+static const unsigned NAV_MAXFIELDS = 32;
+static const int NAV_FIELDLIFETIME = 10 * TICRATE;
+
+// Edges rechecked every tic, for changes that do not go through P_ChangeSector
+static const int NAV_CHECKSPERTIC = 64;
+
+// Routes that stay within 45 degrees of the direct way are not followed.
+static const double NAV_DIRECTCOS = 0.70710678118654752;
+
+//==========================================================================
+//
+// Can a monster walk through this line from one sector into the other?
+//
+//==========================================================================
+
+static bool CanMonsterUse(const line_t *line)
+{
+	if (line->special == 0) return false;
+	if (line->activation & (SPAC_MUse | SPAC_MPush)) return true;
+	if (!(line->activation & (SPAC_Use | SPAC_Push))) return false;
+	return (line->flags & ML_MONSTERSCANACTIVATE) || line->special == Door_Raise;
+}
+
+static bool CanPassLine(const line_t *line, const sector_t *from, const sector_t *to)
+{
+	if (line->flags & (ML_BLOCKING | ML_BLOCKMONSTERS | ML_BLOCKEVERYTHING))
+	{
+		return false;
+	}
+	if (CanMonsterUse(line))
+	{
+		return true;
+	}
+
+	DVector2 mid = line->v1->fPos() + line->Delta() / 2;
+	double fromfloor = from->floorplane.ZatPoint(mid);
+	double tofloor = to->floorplane.ZatPoint(mid);
+	double top = MIN(from->ceilingplane.ZatPoint(mid), to->ceilingplane.ZatPoint(mid));
+
+	return top - MAX(fromfloor, tofloor) >= NAV_HEIGHT &&
+		tofloor - fromfloor <= NAV_STEPHEIGHT &&
+		fromfloor - tofloor <= NAV_DROPOFFHEIGHT;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FSectorNavigation::Build()
+{
+	struct FLink
+	{
+		int From, To;
+		line_t *Line;
+	};
+
+	Clear();
+
+	TArray<FLink> links;
+	for (auto &line : level.lines)
+	{
+		if (line.frontsector == nullptr || line.backsector == nullptr ||
+			line.frontsector == line.backsector || line.isLinePortal())
+		{
+			continue;
+		}
+		links.Push({ line.frontsector->Index(), line.backsector->Index(), &line });
+		links.Push({ line.backsector->Index(), line.frontsector->Index(), &line });
+	}
+	if (links.Size() > 0)
+	{
+		std::sort(&links[0], &links[0] + links.Size(), [](const FLink &a, const FLink &b)
+		{
+			return a.From != b.From ? a.From < b.From : a.To < b.To;
+		});
+	}
+
+	Nodes.Resize(level.sectors.Size());
+	for (unsigned i = 0; i < Nodes.Size(); i++)
+	{
+		Nodes[i].Center = level.sectors[i].centerspot;
+		Nodes[i].FirstEdge = 0;
+		Nodes[i].NumEdges = 0;
+		Nodes[i].Dirty = false;
+	}
+
+	for (unsigned i = 0; i < links.Size(); i++)
+	{
+		const FLink &link = links[i];
+		if (i == 0 || link.From != links[i - 1].From || link.To != links[i - 1].To)
+		{
+			FEdge edge = { link.From, link.To, 0, EdgeLines.Size(), 0, FLT_MAX, false };
+			if (Nodes[link.From].NumEdges == 0) Nodes[link.From].FirstEdge = Edges.Size();
+			Nodes[link.From].NumEdges++;
+			Edges.Push(edge);
+		}
+		FEdge &edge = Edges.Last();
+		DVector2 mid = link.Line->v1->fPos() + link.Line->Delta() / 2;
+		double cost = (mid - Nodes[link.From].Center).Length() + (Nodes[link.To].Center - mid).Length();
+		edge.Cost = MIN(edge.Cost, float(cost));
+		edge.NumLines++;
+		EdgeLines.Push(link.Line);
+	}
+
+	for (auto &edge : Edges)
+	{
+		// Both directions always exist, so the search cannot fail.
+		const FNode &node = Nodes[edge.To];
+		auto first = &Edges[node.FirstEdge], last = first + node.NumEdges;
+		auto reverse = std::lower_bound(first, last, edge.From, [](const FEdge &e, int from) { return e.To < from; });
+		assert(reverse != last && reverse->To == edge.From);
+		edge.Reverse = unsigned(reverse - &Edges[0]);
+		edge.Open = CheckEdge(edge);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FSectorNavigation::Clear()
+{
+	for (auto field : Fields)
+	{
+		delete field;
+	}
+	Fields.Clear();
+	Nodes.Clear();
+	Edges.Clear();
+	EdgeLines.Clear();
+	DirtySectors.Clear();
+	NextCheck = 0;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FSectorNavigation::CheckEdge(const FEdge &edge) const
+{
+	const sector_t *from = &level.sectors[edge.From];
+	const sector_t *to = &level.sectors[edge.To];
+	for (unsigned i = 0; i < edge.NumLines; i++)
+	{
+		if (CanPassLine(EdgeLines[edge.FirstLine + i], from, to))
+			return true;
+	}
+	return false;
+}
+
+void FSectorNavigation::UpdateEdge(unsigned index)
+{
+	FEdge &edge = Edges[index];
+	bool open = CheckEdge(edge);
+	if (open == edge.Open)
+		return;
+
+	edge.Open = open;
+	for (auto field : Fields)
+	{
+		if (open) OpenEdge(field, index);
+		else CloseEdge(field, index);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FSectorNavigation::Tick()
+{
+	FieldsBuilt = FieldsRepaired = Queries = 0;
+
+	// The edges are kept up to date even without fields. Their state is
+	// part of the savegame, so it must not depend on what was queried.
+	for (int index : DirtySectors)
+	{
+		FNode &node = Nodes[index];
+		for (unsigned i = node.FirstEdge; i < node.FirstEdge + node.NumEdges; i++)
+		{
+			UpdateEdge(i);
+			UpdateEdge(Edges[i].Reverse);
+		}
+		node.Dirty = false;
+	}
+	DirtySectors.Clear();
+
+	for (int i = 0; i < NAV_CHECKSPERTIC && Edges.Size() > 0; i++)
+	{
+		if (NextCheck >= Edges.Size()) NextCheck = 0;
+		UpdateEdge(NextCheck++);
+	}
+
+	for (unsigned i = Fields.Size(); i-- > 0; )
+	{
+		if (level.maptime - Fields[i]->LastUsed > NAV_FIELDLIFETIME)
+		{
+			delete Fields[i];
+			Fields.Delete(i);
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FSectorNavigation::FField *FSectorNavigation::GetField(int target)
+{
+	FField *field = nullptr;
+	for (auto f : Fields)
+	{
+		if (f->Target == target)
+		{
+			field = f;
+			break;
+		}
+	}
+
+	if (field == nullptr)
+	{
+		if (Fields.Size() >= NAV_MAXFIELDS)
+		{
+			unsigned oldest = 0;
+			for (unsigned i = 1; i < Fields.Size(); i++)
+			{
+				if (Fields[i]->LastUsed < Fields[oldest]->LastUsed) oldest = i;
+			}
+			delete Fields[oldest];
+			Fields.Delete(oldest);
+		}
+		field = new FField;
+		field->Target = target;
+		BuildField(field);
+		Fields.Push(field);
+		FieldsBuilt++;
+	}
+	field->LastUsed = level.maptime;
+	return field;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FSectorNavigation::BuildField(FField *field)
+{
+	field->Distance.Resize(Nodes.Size());
+	field->Exit.Resize(Nodes.Size());
+	for (unsigned i = 0; i < Nodes.Size(); i++)
+	{
+		field->Distance[i] = FLT_MAX;
+		field->Exit[i] = -1;
+	}
+	field->Distance[field->Target] = 0;
+
+	TArray<int> seeds;
+	seeds.Push(field->Target);
+	Propagate(field, seeds);
+}
+
+//==========================================================================
+//
+// Dijkstra from the seeds, whose distances have already been lowered.
+// Runs backwards along the edges, towards the sectors that lead to them.
+//
+// Of several equally short ways out of a sector the edge with the lowest
+// index is taken. That way a repaired field is the same as a newly built
+// one, and routes do not change when the fields are rebuilt after loading
+// a savegame.
+//
+//==========================================================================
+
+void FSectorNavigation::Propagate(FField *field, TArray<int> &seeds)
+{
+	struct FQueued
+	{
+		float Distance;
+		int Node;
+
+		// Reversed, so that the queue returns the closest sector first
+		bool operator<(const FQueued &other) const { return Distance > other.Distance; }
+	};
+
+	std::priority_queue<FQueued, std::vector<FQueued>> queue;
+	for (int node : seeds)
+	{
+		queue.push({ field->Distance[node], node });
+	}
+
+	while (!queue.empty())
+	{
+		FQueued current = queue.top();
+		queue.pop();
+		if (current.Distance > field->Distance[current.Node])
+			continue;	// already reached on a shorter path
+
+		const FNode &node = Nodes[current.Node];
+		for (unsigned i = node.FirstEdge; i < node.FirstEdge + node.NumEdges; i++)
+		{
+			unsigned index = Edges[i].Reverse;
+			const FEdge &edge = Edges[index];
+			if (!edge.Open)
+				continue;
+
+			float distance = current.Distance + edge.Cost;
+			if (distance < field->Distance[edge.From])
+			{
+				field->Distance[edge.From] = distance;
+				field->Exit[edge.From] = index;
+				queue.push({ distance, edge.From });
+			}
+			else if (distance == field->Distance[edge.From] && field->Exit[edge.From] > int(index))
+			{
+				field->Exit[edge.From] = index;
+			}
+		}
+	}
+}
+
+//==========================================================================
+//
+// An edge that opens can only make the sector it starts in closer.
+//
+//==========================================================================
+
+void FSectorNavigation::OpenEdge(FField *field, unsigned index)
+{
+	const FEdge &edge = Edges[index];
+	if (field->Distance[edge.To] == FLT_MAX)
+		return;
+
+	float distance = field->Distance[edge.To] + edge.Cost;
+	if (distance < field->Distance[edge.From])
+	{
+		field->Distance[edge.From] = distance;
+		field->Exit[edge.From] = index;
+		TArray<int> seeds;
+		seeds.Push(edge.From);
+		Propagate(field, seeds);
+		FieldsRepaired++;
+	}
+	else if (distance == field->Distance[edge.From] && field->Exit[edge.From] > int(index))
+	{
+		field->Exit[edge.From] = index;
+	}
+}
+
+//==========================================================================
+//
+// An edge that closes only matters if it is the way out of its sector.
+// Every sector whose way to the target passes through it gets searched
+// again, starting from its neighbours outside that set.
+//
+//==========================================================================
+
+void FSectorNavigation::CloseEdge(FField *field, unsigned index)
+{
+	enum { Unknown, Cut, Kept };
+
+	int cut = Edges[index].From;
+	if (field->Exit[cut] != int(index))
+		return;
+
+	TArray<uint8_t> state;
+	state.Resize(Nodes.Size());
+	memset(&state[0], Unknown, state.Size());
+	state[cut] = Cut;
+
+	TArray<int> path;
+	for (unsigned i = 0; i < Nodes.Size(); i++)
+	{
+		int node = i;
+		while (state[node] == Unknown && field->Exit[node] >= 0)
+		{
+			path.Push(node);
+			node = Edges[field->Exit[node]].To;
+		}
+		uint8_t result = state[node] == Unknown ? Kept : state[node];
+		for (int n : path) state[n] = result;
+		state[node] = result;
+		path.Clear();
+	}
+
+	TArray<int> seeds;
+	for (unsigned i = 0; i < Nodes.Size(); i++)
+	{
+		if (state[i] != Cut) continue;
+		field->Distance[i] = FLT_MAX;
+		field->Exit[i] = -1;
+	}
+	for (unsigned i = 0; i < Nodes.Size(); i++)
+	{
+		if (state[i] != Cut) continue;
+
+		const FNode &node = Nodes[i];
+		for (unsigned e = node.FirstEdge; e < node.FirstEdge + node.NumEdges; e++)
+		{
+			const FEdge &edge = Edges[e];
+			if (!edge.Open || state[edge.To] == Cut || field->Distance[edge.To] == FLT_MAX)
+				continue;
+
+			float distance = field->Distance[edge.To] + edge.Cost;
+			if (distance < field->Distance[i])
+			{
+				field->Distance[i] = distance;
+				field->Exit[i] = e;
+			}
+		}
+		if (field->Exit[i] >= 0) seeds.Push(i);
+	}
+	Propagate(field, seeds);
+	FieldsRepaired++;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+double FSectorNavigation::GetDistance(sector_t *from, sector_t *to)
+{
+	if (!IsActive())
+		return -1;
+
+	FField *field = GetField(to->Index());
+	float distance = field->Distance[from->Index()];
+	return distance == FLT_MAX ? -1 : distance;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FSectorNavigation::GetWaypoint(sector_t *from, sector_t *to, const DVector2 &pos, double radius, DVector2 &waypoint)
+{
+	if (!IsActive() || from == to)
+		return false;
+
+	Queries++;
+	FField *field = GetField(to->Index());
+	int exit = field->Exit[from->Index()];
+	if (exit < 0)
+		return false;
+
+	// Head for the closest spot on any of the lines that can be crossed
+	const FEdge &edge = Edges[exit];
+	double bestdist = DBL_MAX;
+	for (int pass = 0; pass < 2 && bestdist == DBL_MAX; pass++)
+	{
+		// If none of them can be passed right now, take any.
+		for (unsigned i = 0; i < edge.NumLines; i++)
+		{
+			line_t *line = EdgeLines[edge.FirstLine + i];
+			if (pass == 0 && !CanPassLine(line, from, &level.sectors[edge.To]))
+				continue;
+
+			DVector2 v1 = line->v1->fPos();
+			DVector2 delta = line->Delta();
+			double length = delta.Length();
+			if (length == 0)
+				continue;
+
+			double margin = MIN(radius, length / 2);
+			double along = clamp(((pos - v1) | delta) / length, margin, length - margin);
+			DVector2 spot = v1 + delta * (along / length);
+
+			// The front side is on the right of the line
+			DVector2 normal(delta.Y / length, -delta.X / length);
+			if (line->frontsector == from) normal = -normal;
+			spot += normal * (radius + NAV_OVERSHOOT);
+
+			double dist = (spot - pos).LengthSquared();
+			if (dist < bestdist)
+			{
+				bestdist = dist;
+				waypoint = spot;
+			}
+		}
+	}
+	return bestdist < DBL_MAX;
+}
+
+//==========================================================================
+//
+// For P_NewChaseDir and the bots
+//
+// The graph only knows about walking, so anything that flies or floats
+// keeps going straight for its target.
+//
+//==========================================================================
+
+bool FSectorNavigation::GetChaseDelta(AActor *actor, AActor *dest, DVector2 &delta)
+{
+	if (!sv_monsternavigation || !IsActive() || actor->Sector == dest->Sector ||
+		(actor->flags & (MF_NOCLIP | MF_FLOAT | MF_NOGRAVITY)) ||
+		actor->Sector->PortalGroup != dest->Sector->PortalGroup)
+	{
+		return false;
+	}
+
+	DVector2 waypoint;
+	if (!GetWaypoint(actor->Sector, dest->Sector, actor->Pos().XY(), actor->radius, waypoint))
+	{
+		return false;
+	}
+
+	// No sight check here: if the route leads roughly the direct way,
+	// the monster does what it would have done without the graph.
+	DVector2 route = waypoint - actor->Pos().XY();
+	if ((route | delta) >= route.Length() * delta.Length() * NAV_DIRECTCOS)
+	{
+		return false;
+	}
+	delta = route;
+	return true;
+}
+
+//==========================================================================
+//
+// Only the edge state is saved. The fields are rebuilt from it on demand
+// and come out the same as the ones they replace.
+//
+//==========================================================================
+
+void FSectorNavigation::Serialize(FSerializer &arc)
+{
+	if (!IsActive() || !arc.BeginObject("navigation"))
+	{
+		return;
+	}
+
+	TArray<uint8_t> open;
+	if (arc.isWriting())
+	{
+		open.Resize(Edges.Size());
+		for (unsigned i = 0; i < Edges.Size(); i++) open[i] = Edges[i].Open;
+	}
+	arc("openedges", open)
+		("nextcheck", NextCheck)
+		("dirtysectors", DirtySectors);
+
+	if (arc.isReading())
+	{
+		for (auto field : Fields)
+		{
+			delete field;
+		}
+		Fields.Clear();
+
+		if (open.Size() == Edges.Size())
+		{
+			for (unsigned i = 0; i < Edges.Size(); i++) Edges[i].Open = !!open[i];
+		}
+		for (auto &node : Nodes) node.Dirty = false;
+		for (unsigned i = DirtySectors.Size(); i-- > 0; )
+		{
+			if (unsigned(DirtySectors[i]) >= Nodes.Size() || Nodes[DirtySectors[i]].Dirty) DirtySectors.Delete(i);
+			else Nodes[DirtySectors[i]].Dirty = true;
+		}
+	}
+	arc.EndObject();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FSectorNavigation::GetStats(int &fields, int &built, int &repaired, int &queries) const
+{
+	fields = Fields.Size();
+	built = FieldsBuilt;
+	repaired = FieldsRepaired;
+	queries = Queries;
+}
+
+ADD_STAT (navigation)
+{
+	FString out;
+	int fields, built, repaired, queries;
+	Navigation.GetStats(fields, built, repaired, queries);
+	out.Format("%d fields (%d built, %d repaired), %d waypoints\n", fields, built, repaired, queries);
+	return out;
+}
+
+//==========================================================================
+//
+// ZScript access. Unlike the native AI this is not tied to sv_monsternavigation.
+//
+//==========================================================================
+
+DEFINE_ACTION_FUNCTION(AActor, GetNavigationDistance)
+{
+	PARAM_SELF_PROLOGUE(AActor);
+	PARAM_OBJECT_NOT_NULL(dest, AActor);
+	ACTION_RETURN_FLOAT(Navigation.GetDistance(self->Sector, dest->Sector));
+}
+
+DEFINE_ACTION_FUNCTION(AActor, GetNavigationWaypoint)
+{
+	PARAM_SELF_PROLOGUE(AActor);
+	PARAM_OBJECT_NOT_NULL(dest, AActor);
+
+	DVector2 waypoint = self->Pos().XY() + self->Vec2To(dest);
+	bool found = Navigation.GetWaypoint(self->Sector, dest->Sector, self->Pos().XY(), self->radius, waypoint);
+	if (numret > 1)
+	{
+		ret[1].SetVector2(waypoint);
+		numret = 2;
+	}
+	if (numret > 0)
+	{
+		ret[0].SetInt(found);
+	}
+	return numret;
+}
@@ -0,0 +1,148 @@
+/*
+** p_navigation.h
+**
+** Sector graph and flow fields for monster navigation
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** The graph has one node per sector and one directed edge per pair of
+** sectors that share two-sided lines. An edge is open if a walking monster
+** of standard size can pass at least one of these lines: not blocked by
+** line flags, high enough, and neither a step up nor a drop down beyond
+** 24 units. Lines with a special a monster can use or push always count as
+** open, so that doors do not cut the graph.
+**
+** A flow field holds, for every sector, the distance to one target sector
+** and the edge to leave through. Monsters chasing targets in the same
+** sector share one field. When an edge opens or closes, only the affected
+** part of each field is repaired.
+**
+** Equally short routes are broken by edge index, so a field only depends
+** on the edge state, which is saved with the level.
+**
+** 3D floors and portals are not part of the graph. Polyobjects are
+** ignored as well.
+**
+*/
+
+#ifndef __P_NAVIGATION_H
+#define __P_NAVIGATION_H
+
+#include "tarray.h"
+#include "vectors.h"
+#include "r_defs.h"
+
+class AActor;
+class FSerializer;
+
+class FSectorNavigation
+{
+public:
+	void Build();
+	void Clear();
+
+	bool IsActive() const { return Nodes.Size() > 0; }
+
+	// Called once per tic. Rechecks edges that may have changed and drops unused fields.
+	void Tick();
+
+	// Marks a sector whose planes moved
+	void SectorChanged(sector_t *sector)
+	{
+		if (IsActive() && !Nodes[sector->Index()].Dirty)
+		{
+			Nodes[sector->Index()].Dirty = true;
+			DirtySectors.Push(sector->Index());
+		}
+	}
+
+	// Returns the distance along the graph from one sector to another, or -1 if there is no route.
+	double GetDistance(sector_t *from, sector_t *to);
+
+	// Finds the point a monster in sector 'from' has to walk to in order to reach sector 'to'.
+	// The point lies just behind the line to cross.
+	bool GetWaypoint(sector_t *from, sector_t *to, const DVector2 &pos, double radius, DVector2 &waypoint);
+
+	// Replaces delta with the direction towards the next waypoint to dest if the route does not lead straight there.
+	// Returns false for anything that does not walk.
+	bool GetChaseDelta(AActor *actor, AActor *dest, DVector2 &delta);
+
+	void Serialize(FSerializer &arc);
+
+	void GetStats(int &fields, int &built, int &repaired, int &queries) const;
+
+private:
+	struct FNode
+	{
+		DVector2 Center;
+		unsigned FirstEdge;
+		unsigned NumEdges;
+		bool Dirty;
+	};
+
+	// Leads from one sector to another
+	struct FEdge
+	{
+		int From, To;
+		unsigned Reverse;		// the edge going the other way
+		unsigned FirstLine;
+		unsigned NumLines;
+		float Cost;
+		bool Open;
+	};
+
+	struct FField
+	{
+		int Target;
+		int LastUsed;
+		TArray<float> Distance;
+		TArray<int> Exit;		// edge to leave each sector through, -1 if there is none
+	};
+
+	bool CheckEdge(const FEdge &edge) const;
+	void UpdateEdge(unsigned index);
+	FField *GetField(int target);
+	void BuildField(FField *field);
+	void OpenEdge(FField *field, unsigned edge);
+	void CloseEdge(FField *field, unsigned edge);
+	void Propagate(FField *field, TArray<int> &queue);
+
+	TArray<FNode> Nodes;
+	TArray<FEdge> Edges;
+	TArray<line_t *> EdgeLines;
+	TArray<FField *> Fields;
+	TArray<int> DirtySectors;
+	unsigned NextCheck = 0;
+
+	int FieldsBuilt = 0;
+	int FieldsRepaired = 0;
+	int Queries = 0;
+};
+
+extern FSectorNavigation Navigation;
+
+#endif
@@ -0,0 +1,647 @@
+/*
+** p_pvs.cpp
+**
+** Potentially visible set between subsectors
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** This is the portal flow of Quake's vis tool reduced to two dimensions.
+** The subsectors are the leaves and the open segs between them are the
+** portals. A coarse pass first floods from every portal through all
+** portals that face away from it. The exact pass then follows every
+** chain of portals from a source subsector and clips each new portal to
+** the region that can be seen from the source portal through the last
+** one, stopping when nothing is left.
+**
+** The build has a time limit. Subsectors whose exact pass does not finish
+** in time keep what the coarse pass found for them. If even the coarse
+** pass runs out of time, the level gets no PVS. Only complete sets are
+** stored in the level data cache.
+**
+*/
+
+#include <atomic>
+#include <chrono>
+#include "doomdef.h"
+#include "p_local.h"
+#include "p_setup.h"
+#include "p_pvs.h"
+#include "po_man.h"
+#include "portal.h"
+#include "r_utility.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include "jobsystem.h"
+#include "g_levellocals.h"
+#include "actorinlines.h"
+
+CVAR(Bool, pvs_enable, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Float, pvs_maxbuildtime, 1.f, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// in seconds
+CVAR(Bool, pvs_verify, false, 0)	// trace every actor pair the PVS rejects and report the visible ones
+
+FPotentiallyVisibleSet PVS;
+
+// Anything closer than this to a line counts as being on it. It keeps the
+// clipping conservative for rays that graze a vertex.
+static const double PVS_EPSILON = 1 / 64.;
+
+// The per portal flood data and the final set both grow quadratically,
+// so very large maps go without.
+static const size_t MaxPortalBytes = 64 << 20;
+static const size_t MaxSetBytes = 32 << 20;
+
+// A source subsector whose portal chains get longer or more numerous than
+// this sees everything its coarse pass found.
+static const int MaxFlowDepth = 256;
+static const int MaxFlowSteps = 100000;
+
+//==========================================================================
+//
+// 2D portal geometry
+//
+//==========================================================================
+
+struct FPVSWinding
+{
+	DVector2 V1, V2;
+};
+
+struct FPVSPortal
+{
+	DVector2 V1, V2;
+	DVector2 Normal;	// points into Leaf
+	double Dist;
+	int Leaf;			// subsector on the far side
+	uint32_t *MightSee;	// coarse set of subsectors visible through this portal
+
+	double PointDist(const DVector2 &pos) const
+	{
+		return (Normal | pos) - Dist;
+	}
+};
+
+static inline bool TestBit(const uint32_t *bits, int index)
+{
+	return !!(bits[index >> 5] & (1u << (index & 31)));
+}
+
+static inline void SetBit(uint32_t *bits, int index)
+{
+	bits[index >> 5] |= 1u << (index & 31);
+}
+
+//==========================================================================
+//
+// Keeps the part of the winding in front of the line. Returns false
+// if nothing is left.
+//
+//==========================================================================
+
+static bool ClipWinding(FPVSWinding &w, const DVector2 &normal, double dist)
+{
+	double d1 = (normal | w.V1) - dist;
+	double d2 = (normal | w.V2) - dist;
+
+	if (d1 >= -PVS_EPSILON && d2 >= -PVS_EPSILON) return true;
+	if (d1 < -PVS_EPSILON && d2 < -PVS_EPSILON) return false;
+
+	DVector2 mid = w.V1 + (w.V2 - w.V1) * ((d1 + PVS_EPSILON) / (d1 - d2));
+	if (d1 < -PVS_EPSILON) w.V1 = mid;
+	else w.V2 = mid;
+	return true;
+}
+
+//==========================================================================
+//
+// Clips target to the region that is visible from source through pass.
+// That region is bounded by the lines through one end of source and one
+// end of pass that have the rest of source and pass on opposite sides.
+//
+//==========================================================================
+
+static bool ClipToSeparators(const FPVSWinding &source, const FPVSWinding &pass, FPVSWinding &target)
+{
+	const DVector2 *s[2] = { &source.V1, &source.V2 };
+	const DVector2 *p[2] = { &pass.V1, &pass.V2 };
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			DVector2 dir = *p[j] - *s[i];
+			double len = dir.Length();
+			if (len < PVS_EPSILON) continue;
+
+			DVector2 normal(-dir.Y / len, dir.X / len);
+			double dist = normal | *s[i];
+			double sourceside = (normal | *s[i ^ 1]) - dist;
+			double passside = (normal | *p[j ^ 1]) - dist;
+
+			if (sourceside > PVS_EPSILON && passside < -PVS_EPSILON)
+			{
+				normal = -normal;
+				dist = -dist;
+			}
+			else if (!(sourceside < -PVS_EPSILON && passside > PVS_EPSILON))
+			{
+				continue;	// not a separating line
+			}
+			if (!ClipWinding(target, normal, dist)) return false;
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// FPVSBuilder
+//
+//==========================================================================
+
+class FPVSBuilder
+{
+public:
+	bool CollectPortals();
+	unsigned GetNumPortals() const { return Portals.Size(); }
+	bool CheckSize(size_t maxportalbytes, size_t maxsetbytes) const;
+	// Returns false if the coarse pass could not be finished in time.
+	bool Build(TArray<uint32_t> &bits, unsigned &rowwords, double maxtime);
+
+	int GetCoarseLeaves() const { return CoarseLeaves; }
+
+private:
+	struct FFlowContext
+	{
+		uint32_t *Visible;
+		TArray<uint8_t> InChain;
+		TArray<uint32_t> Might;		// one row per recursion depth
+		int Steps;
+		bool Overflow;
+	};
+
+	bool OutOfTime();
+	void BaseVis(int portal);
+	void LeafFlow(int leaf, uint32_t *visible);
+	void RecursiveFlow(FFlowContext &ctx, int leaf, int depth, const FPVSPortal &sourceportal, const FPVSWinding &source, const FPVSPortal *passportal, const FPVSWinding *pass);
+
+	TArray<FPVSPortal> Portals;
+	TArray<int> LeafFirstPortal;	// index of each leaf's first portal, plus the total count
+	TArray<uint32_t> MightSee;
+	unsigned NumLeaves = 0;
+	unsigned RowWords = 0;
+
+	std::chrono::steady_clock::time_point Deadline;
+	std::atomic<bool> TimeUp { false };
+	std::atomic<int> CoarseLeaves { 0 };
+};
+
+//==========================================================================
+//
+// Turns every seg of a subsector into a portal, unless it is part of a
+// one-sided line. Fails if the nodes lack the partner segs needed to
+// find the neighbors.
+//
+//==========================================================================
+
+bool FPVSBuilder::CollectPortals()
+{
+	NumLeaves = level.subsectors.Size();
+	RowWords = (NumLeaves + 31) / 32;
+	LeafFirstPortal.Resize(NumLeaves + 1);
+
+	for (unsigned i = 0; i < NumLeaves; i++)
+	{
+		subsector_t *sub = &level.subsectors[i];
+		LeafFirstPortal[i] = Portals.Size();
+
+		for (uint32_t j = 0; j < sub->numlines; j++)
+		{
+			seg_t *seg = &sub->firstline[j];
+			if (seg->linedef != nullptr && seg->backsector == nullptr) continue;	// solid wall
+			if (seg->PartnerSeg == nullptr || seg->PartnerSeg->Subsector == nullptr)
+			{
+				return false;
+			}
+
+			DVector2 v1 = seg->v1->fPos(), v2 = seg->v2->fPos();
+			DVector2 dir = v2 - v1;
+			double len = dir.Length();
+			if (len < PVS_EPSILON) continue;
+
+			// Segs run clockwise around their subsector, so the neighbor is on the left.
+			FPVSPortal portal;
+			portal.V1 = v1;
+			portal.V2 = v2;
+			portal.Normal = DVector2(-dir.Y / len, dir.X / len);
+			portal.Dist = portal.Normal | v1;
+			portal.Leaf = seg->PartnerSeg->Subsector->Index();
+			portal.MightSee = nullptr;
+			Portals.Push(portal);
+		}
+	}
+	LeafFirstPortal[NumLeaves] = Portals.Size();
+	return true;
+}
+
+bool FPVSBuilder::CheckSize(size_t maxportalbytes, size_t maxsetbytes) const
+{
+	size_t rowbytes = RowWords * sizeof(uint32_t);
+	return rowbytes * Portals.Size() <= maxportalbytes && rowbytes * NumLeaves <= maxsetbytes;
+}
+
+//==========================================================================
+//
+// Checked by all build jobs. Once the time is up, it stays up.
+//
+//==========================================================================
+
+bool FPVSBuilder::OutOfTime()
+{
+	if (TimeUp.load(std::memory_order_relaxed)) return true;
+	if (std::chrono::steady_clock::now() < Deadline) return false;
+	TimeUp.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+//==========================================================================
+//
+// Coarse pass: everything reachable from a portal through portals that
+// have a part in front of it and that it is partly behind of. A ray
+// through the portal can only pass such portals afterwards.
+//
+//==========================================================================
+
+void FPVSBuilder::BaseVis(int index)
+{
+	FPVSPortal &portal = Portals[index];
+	uint32_t *bits = portal.MightSee;
+	TArray<int> stack;
+
+	if (OutOfTime()) return;	// the whole build gets thrown away
+
+	SetBit(bits, portal.Leaf);
+	stack.Push(portal.Leaf);
+	while (stack.Size() > 0)
+	{
+		int leaf;
+		stack.Pop(leaf);
+		for (int i = LeafFirstPortal[leaf]; i < LeafFirstPortal[leaf + 1]; i++)
+		{
+			const FPVSPortal &next = Portals[i];
+			if (TestBit(bits, next.Leaf)) continue;
+			if (portal.PointDist(next.V1) < -PVS_EPSILON && portal.PointDist(next.V2) < -PVS_EPSILON) continue;
+			if (next.PointDist(portal.V1) > PVS_EPSILON && next.PointDist(portal.V2) > PVS_EPSILON) continue;
+			SetBit(bits, next.Leaf);
+			stack.Push(next.Leaf);
+		}
+	}
+}
+
+//==========================================================================
+//
+// Exact pass
+//
+//==========================================================================
+
+void FPVSBuilder::RecursiveFlow(FFlowContext &ctx, int leaf, int depth, const FPVSPortal &sourceportal, const FPVSWinding &source, const FPVSPortal *passportal, const FPVSWinding *pass)
+{
+	ctx.InChain[leaf] = 1;
+	const uint32_t *might = &ctx.Might[depth * RowWords];
+	uint32_t *nextmight = &ctx.Might[(depth + 1) * RowWords];
+
+	for (int i = LeafFirstPortal[leaf]; i < LeafFirstPortal[leaf + 1] && !ctx.Overflow; i++)
+	{
+		const FPVSPortal &portal = Portals[i];
+
+		// A straight line cannot enter a convex subsector twice.
+		if (ctx.InChain[portal.Leaf]) continue;
+		if (!TestBit(might, portal.Leaf)) continue;
+
+		if (++ctx.Steps > MaxFlowSteps || depth + 2 >= MaxFlowDepth || ((ctx.Steps & 1023) == 0 && OutOfTime()))
+		{
+			ctx.Overflow = true;
+			break;
+		}
+
+		// If the portal can't see anything that hasn't been seen already, skip it.
+		bool more = false;
+		for (unsigned w = 0; w < RowWords; w++)
+		{
+			nextmight[w] = might[w] & portal.MightSee[w];
+			if (nextmight[w] & ~ctx.Visible[w]) more = true;
+		}
+		if (!more && TestBit(ctx.Visible, portal.Leaf)) continue;
+
+		FPVSWinding target = { portal.V1, portal.V2 };
+		FPVSWinding newsource = source;
+		if (!ClipWinding(target, sourceportal.Normal, sourceportal.Dist)) continue;
+		if (pass != nullptr)
+		{
+			if (!ClipWinding(target, passportal->Normal, passportal->Dist)) continue;
+			// Only the part of the source behind the target can look through it.
+			if (!ClipWinding(newsource, -portal.Normal, -portal.Dist)) continue;
+			if (!ClipToSeparators(newsource, *pass, target)) continue;
+			if (!ClipToSeparators(target, *pass, newsource)) continue;
+		}
+
+		SetBit(ctx.Visible, portal.Leaf);
+		RecursiveFlow(ctx, portal.Leaf, depth + 1, sourceportal, newsource, &portal, &target);
+
+		// The recursion reused the next level's row.
+		might = &ctx.Might[depth * RowWords];
+		nextmight = &ctx.Might[(depth + 1) * RowWords];
+	}
+	ctx.InChain[leaf] = 0;
+}
+
+void FPVSBuilder::LeafFlow(int leaf, uint32_t *visible)
+{
+	FFlowContext ctx;
+	ctx.Visible = visible;
+	ctx.InChain.Resize(NumLeaves);
+	memset(&ctx.InChain[0], 0, NumLeaves);
+	ctx.Might.Resize(MaxFlowDepth * RowWords);
+	ctx.Steps = 0;
+	ctx.Overflow = OutOfTime();
+
+	SetBit(visible, leaf);
+	ctx.InChain[leaf] = 1;
+	for (int i = LeafFirstPortal[leaf]; i < LeafFirstPortal[leaf + 1] && !ctx.Overflow; i++)
+	{
+		const FPVSPortal &portal = Portals[i];
+		FPVSWinding source = { portal.V1, portal.V2 };
+		SetBit(visible, portal.Leaf);
+		memcpy(&ctx.Might[0], portal.MightSee, RowWords * sizeof(uint32_t));
+		RecursiveFlow(ctx, portal.Leaf, 0, portal, source, nullptr, nullptr);
+	}
+
+	if (ctx.Overflow)
+	{
+		CoarseLeaves++;
+		for (int i = LeafFirstPortal[leaf]; i < LeafFirstPortal[leaf + 1]; i++)
+		{
+			const uint32_t *might = Portals[i].MightSee;
+			for (unsigned w = 0; w < RowWords; w++) visible[w] |= might[w];
+		}
+	}
+}
+
+bool FPVSBuilder::Build(TArray<uint32_t> &bits, unsigned &rowwords, double maxtime)
+{
+	auto jobs = FJobSystem::Instance();
+	Deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(int64_t(maxtime * 1000000));
+
+	MightSee.Resize(Portals.Size() * RowWords);
+	if (MightSee.Size() > 0) memset(&MightSee[0], 0, MightSee.Size() * sizeof(uint32_t));
+	for (unsigned i = 0; i < Portals.Size(); i++)
+	{
+		Portals[i].MightSee = &MightSee[i * RowWords];
+	}
+	jobs->ParallelFor(0, Portals.Size(), [=](int i) { BaseVis(i); }, 64);
+	if (TimeUp)
+	{
+		return false;
+	}
+
+	rowwords = RowWords;
+	bits.Resize(NumLeaves * RowWords);
+	memset(&bits[0], 0, bits.Size() * sizeof(uint32_t));
+	jobs->ParallelFor(0, NumLeaves, [&](int i) { LeafFlow(i, &bits[i * RowWords]); }, 16);
+	return true;
+}
+
+//==========================================================================
+//
+// FPotentiallyVisibleSet
+//
+//==========================================================================
+
+void FPotentiallyVisibleSet::Build(MapData *map)
+{
+	Clear();
+
+	if (!pvs_enable || !hasglnodes || level.subsectors.Size() == 0 || po_NumPolyobjs > 0 ||
+		linePortals.Size() > 0 || PortalBlockmap.hasLinkedSectorPortals)
+	{
+		return;
+	}
+
+	cycle_t time;
+	time.Reset();
+	time.Clock();
+
+	FPVSBuilder builder;
+	if (!builder.CollectPortals())
+	{
+		DPrintf(DMSG_NOTIFY, "No PVS: the nodes do not connect all subsectors\n");
+		return;
+	}
+	if (!builder.CheckSize(MaxPortalBytes, MaxSetBytes))
+	{
+		DPrintf(DMSG_NOTIFY, "No PVS: %u subsectors are too many\n", level.subsectors.Size());
+		return;
+	}
+
+	// The cached set starts with the number of portals it was made from.
+	unsigned numleaves = level.subsectors.Size();
+	unsigned rowwords = (numleaves + 31) / 32;
+	TArray<uint8_t> data;
+	if (map != nullptr && P_ReadLevelCache(map, ".pvs", numleaves, data) &&
+		data.Size() == (numleaves * rowwords + 1) * sizeof(uint32_t))
+	{
+		const uint32_t *cached = (const uint32_t *)&data[0];
+		if (LittleLong(cached[0]) == builder.GetNumPortals())
+		{
+			Bits.Resize(numleaves * rowwords);
+			for (unsigned i = 0; i < Bits.Size(); i++)
+			{
+				Bits[i] = LittleLong(cached[i + 1]);
+			}
+			RowWords = rowwords;
+			DPrintf(DMSG_NOTIFY, "Using cached PVS\n");
+			return;
+		}
+	}
+	if (!builder.Build(Bits, RowWords, MAX<double>(pvs_maxbuildtime, 0)))
+	{
+		Clear();
+		DPrintf(DMSG_NOTIFY, "No PVS: the build took longer than %.3f sec\n", double(pvs_maxbuildtime));
+		return;
+	}
+
+	time.Unclock();
+
+	if (map != nullptr && builder.GetCoarseLeaves() == 0)
+	{
+		TArray<uint32_t> swapped;
+		swapped.Resize(Bits.Size() + 1);
+		swapped[0] = LittleLong(builder.GetNumPortals());
+		for (unsigned i = 0; i < Bits.Size(); i++)
+		{
+			swapped[i + 1] = LittleLong(Bits[i]);
+		}
+		P_WriteLevelCache(map, ".pvs", numleaves, &swapped[0], swapped.Size() * sizeof(uint32_t), time.TimeMS() / 1000.);
+	}
+
+	unsigned visible = 0;
+	for (auto word : Bits)
+	{
+		for (; word != 0; word &= word - 1) visible++;
+	}
+	DPrintf(DMSG_NOTIFY, "PVS generation took %.3f sec (%.1f%% visible, %d subsectors only coarse)\n", time.TimeMS() * 0.001,
+		visible * 100. / (double(level.subsectors.Size()) * level.subsectors.Size()), builder.GetCoarseLeaves());
+}
+
+void FPotentiallyVisibleSet::Clear()
+{
+	Bits.Reset();
+	RowWords = 0;
+}
+
+bool FPotentiallyVisibleSet::IsActive() const
+{
+	// Portals may also be created after the level was loaded.
+	return RowWords > 0 && pvs_enable && linePortals.Size() == 0 && !PortalBlockmap.hasLinkedSectorPortals;
+}
+
+//==========================================================================
+//
+// Returns the index of the subsector if pos is inside of it. The nodes
+// only cover the inside of the map, so this fails for positions in the
+// void that still end up in a subsector.
+//
+//==========================================================================
+
+int FPotentiallyVisibleSet::FindLeaf(const DVector2 &pos, const subsector_t *sub) const
+{
+	if (sub == nullptr)
+	{
+		sub = R_PointInSubsector(pos);
+	}
+	for (uint32_t i = 0; i < sub->numlines; i++)
+	{
+		const seg_t *seg = &sub->firstline[i];
+		DVector2 v1 = seg->v1->fPos();
+		DVector2 dir = seg->v2->fPos() - v1;
+		double len = dir.Length();
+		if (len > 0 && (dir.X * (pos.Y - v1.Y) - dir.Y * (pos.X - v1.X)) / len > PVS_EPSILON)
+		{
+			return -1;
+		}
+	}
+	return sub->Index();
+}
+
+const uint32_t *FPotentiallyVisibleSet::GetVisibleRow(const DVector2 &pos, const subsector_t *sub) const
+{
+	if (!IsActive()) return nullptr;
+	int leaf = FindLeaf(pos, sub);
+	return leaf < 0 ? nullptr : &Bits[leaf * RowWords];
+}
+
+//==========================================================================
+//
+// Checks the set against the blockmap: for every pair of subsectors the
+// set keeps apart, the line between their centers must cross a one-sided
+// wall. Returns the number of pairs where it does not.
+//
+//==========================================================================
+
+int FPotentiallyVisibleSet::Verify(int maxreports) const
+{
+	if (RowWords == 0) return 0;
+
+	unsigned numleaves = level.subsectors.Size();
+	TArray<DVector2> centers;
+	centers.Resize(numleaves);
+	for (unsigned i = 0; i < numleaves; i++)
+	{
+		auto &sub = level.subsectors[i];
+		DVector2 center = { 0, 0 };
+		for (uint32_t j = 0; j < sub.numlines; j++)
+		{
+			center += sub.firstline[j].v1->fPos();
+		}
+		centers[i] = sub.numlines > 0 ? center / sub.numlines : center;
+	}
+
+	int errors = 0;
+	for (unsigned i = 0; i < numleaves; i++)
+	{
+		const uint32_t *row = &Bits[i * RowWords];
+		for (unsigned j = 0; j < numleaves; j++)
+		{
+			if (TestBit(row, j)) continue;
+
+			FPathTraverse it(centers[i].X, centers[i].Y, centers[j].X, centers[j].Y, PT_ADDLINES);
+			intercept_t *in;
+			bool blocked = false;
+			while ((in = it.Next()) != nullptr)
+			{
+				if (in->d.line->sidedef[1] == nullptr)
+				{
+					blocked = true;
+					break;
+				}
+			}
+			if (!blocked)
+			{
+				if (errors < maxreports)
+				{
+					Printf("Subsector %u at (%.2f, %.2f) does not see subsector %u at (%.2f, %.2f)\n", i, centers[i].X, centers[i].Y, j, centers[j].X, centers[j].Y);
+				}
+				errors++;
+			}
+		}
+	}
+	return errors;
+}
+
+CCMD(pvs_check)
+{
+	if (!PVS.IsActive())
+	{
+		Printf("This level has no PVS\n");
+		return;
+	}
+	Printf("The PVS rejects %d visible subsector pairs\n", PVS.Verify(20));
+}
+
+bool FPotentiallyVisibleSet::CheckActors(AActor *t1, AActor *t2) const
+{
+	if (!IsActive()) return true;
+
+	// With separate gameplay nodes the actors' subsectors are no render subsectors.
+	bool gamenodes = level.gamesubsectors.Size() > 0;
+	DVector2 pos1 = t1->Pos().XY(), pos2 = t2->Pos().XY();
+	int leaf1 = FindLeaf(pos1, gamenodes ? nullptr : t1->subsector);
+	if (leaf1 < 0) return true;
+	int leaf2 = FindLeaf(pos2, gamenodes ? nullptr : t2->subsector);
+	if (leaf2 < 0) return true;
+	return TestBit(&Bits[leaf1 * RowWords], leaf2);
+}
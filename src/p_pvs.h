@@ -0,0 +1,88 @@
+/*
+** p_pvs.h
+**
+** Potentially visible set between subsectors
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** The set is computed in 2D from the GL nodes at level load. Every seg
+** between two subsectors that is not a one-sided wall counts as open, no
+** matter how far the sectors' floors and ceilings are apart, so doors,
+** lifts and any other moving sector stay covered. If subsector A does not
+** see subsector B, no straight line from a point in A to a point in B
+** crosses only two-sided lines.
+**
+** Maps with line portals, linked sector portals or polyobjects get no
+** PVS. Neither do maps without GL nodes.
+**
+*/
+
+#ifndef __P_PVS_H
+#define __P_PVS_H
+
+#include "tarray.h"
+#include "vectors.h"
+#include "r_defs.h"
+
+class AActor;
+struct MapData;
+
+class FPotentiallyVisibleSet
+{
+public:
+	// The result is cached with the other level data if the map is given.
+	void Build(MapData *map);
+	void Clear();
+
+	bool IsActive() const;
+
+	// Returns the set of subsectors visible from pos, or nullptr if nothing can be culled for it.
+	// sub is the render subsector containing pos, if known.
+	const uint32_t *GetVisibleRow(const DVector2 &pos, const subsector_t *sub = nullptr) const;
+
+	// False if there is no straight line between the two actors' positions
+	bool CheckActors(AActor *t1, AActor *t2) const;
+
+	// Prints up to maxreports subsector pairs that are rejected but can see each other, and returns how many there are.
+	int Verify(int maxreports) const;
+
+	static bool IsVisible(const uint32_t *row, const subsector_t *sub)
+	{
+		int index = sub->Index();
+		return !!(row[index >> 5] & (1u << (index & 31)));
+	}
+
+private:
+	int FindLeaf(const DVector2 &pos, const subsector_t *sub) const;
+
+	TArray<uint32_t> Bits;
+	unsigned RowWords = 0;
+};
+
+extern FPotentiallyVisibleSet PVS;
+
+#endif
@@ -64,6 +64,7 @@
 #include "serializer.h"
 #include "g_levellocals.h"
 #include "events.h"
+#include "p_navigation.h"
 
 //==========================================================================
 //
@@ -89,6 +90,23 @@ FSerializer &Serialize(FSerializer &arc, const char *key, line_t &line, line_t *
 
 }
 
+//==========================================================================
+//
+// Checks whether a line differs from its state at map load in anything
+// the serializer above would write.
+//
+//==========================================================================
+
+static bool LineChanged(line_t &line, line_t &def)
+{
+	return line.flags != def.flags ||
+		line.activation != def.activation ||
+		line.special != def.special ||
+		line.alpha != def.alpha ||
+		memcmp(line.args, def.args, sizeof(line.args)) ||
+		line.portalindex != def.portalindex;
+}
+
 //==========================================================================
 //
 //
@@ -144,6 +162,20 @@ FSerializer &Serialize(FSerializer &arc, const char *key, side_t &side, side_t *
 //
 //==========================================================================
 
+static bool SideChanged(side_t &side, side_t &def)
+{
+	return memcmp(side.textures, def.textures, sizeof(side.textures)) ||
+		side.Light != def.Light ||
+		side.Flags != def.Flags ||
+		side.AttachedDecals != nullptr;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FSerializer &Serialize(FSerializer &arc, const char *key, FLinkedSector &ls, FLinkedSector *def)
 {
 	if (arc.BeginObject(key))
@@ -317,6 +349,65 @@ FSerializer &Serialize(FSerializer &arc, const char *key, sector_t &p, sector_t
 	return arc;
 }
 
+//==========================================================================
+//
+// The pointers and lists are always written by the serializer above. Their
+// map load state is empty, except for the extsector lists which the map
+// setup creates again, so any sector using them counts as changed.
+//
+//==========================================================================
+
+static bool SectorChanged(sector_t &p, sector_t &def)
+{
+	if (memcmp(&p.floorplane, &def.floorplane, sizeof(p.floorplane)) ||
+		memcmp(&p.ceilingplane, &def.ceilingplane, sizeof(p.ceilingplane)) ||
+		memcmp(p.planes, def.planes, sizeof(p.planes)) ||
+		p.lightlevel != def.lightlevel ||
+		p.special != def.special ||
+		p.seqType != def.seqType ||
+		p.SeqName != def.SeqName ||
+		p.friction != def.friction ||
+		p.movefactor != def.movefactor ||
+		p.stairlock != def.stairlock ||
+		p.prevsec != def.prevsec ||
+		p.nextsec != def.nextsec ||
+		p.damageamount != def.damageamount ||
+		p.damageinterval != def.damageinterval ||
+		p.leakydamage != def.leakydamage ||
+		p.damagetype != def.damagetype ||
+		p.sky != def.sky ||
+		p.MoreFlags != def.MoreFlags ||
+		p.Flags != def.Flags ||
+		memcmp(p.Portals, def.Portals, sizeof(p.Portals)) ||
+		p.ZoneNumber != def.ZoneNumber ||
+		!(p.Colormap == def.Colormap) ||
+		memcmp(p.SpecialColors, def.SpecialColors, sizeof(p.SpecialColors)) ||
+		p.gravity != def.gravity ||
+		memcmp(p.terrainnum, def.terrainnum, sizeof(p.terrainnum)) ||
+		memcmp(p.reflect, def.reflect, sizeof(p.reflect)))
+	{
+		return true;
+	}
+
+	for (auto &interp : p.interpolations)
+	{
+		if (interp != nullptr) return true;
+	}
+	if (p.SoundTarget != nullptr || p.SecActTarget != nullptr ||
+		p.floordata != nullptr || p.ceilingdata != nullptr || p.lightingdata != nullptr)
+	{
+		return true;
+	}
+	if (p.e->FakeFloor.Sectors.Size() > 0 ||
+		p.e->Midtex.Floor.AttachedLines.Size() > 0 || p.e->Midtex.Floor.AttachedSectors.Size() > 0 ||
+		p.e->Midtex.Ceiling.AttachedLines.Size() > 0 || p.e->Midtex.Ceiling.AttachedSectors.Size() > 0 ||
+		p.e->Linked.Floor.Sectors.Size() > 0 || p.e->Linked.Ceiling.Sectors.Size() > 0)
+	{
+		return true;
+	}
+	return level.Scrolls.Size() > 0 && !level.Scrolls[p.sectornum].isZero();
+}
+
 //==========================================================================
 //
 // RecalculateDrawnSubsectors
@@ -908,6 +999,70 @@ static void SpawnExtraPlayers()
 	}
 }
 
+//============================================================================
+//
+// Map arrays are stored as a delta against the state at map load:
+// only the elements that were changed get written, with their indices.
+// Since a level is always set up from scratch before loading a snapshot
+// the missing elements are already correct when reading.
+//
+// Savegames older than SAVEVER 4553 contain the full arrays.
+//
+//============================================================================
+
+template<class T>
+static void SerializeMapArray(FSerializer &arc, const char *key, TArray<T> &value, TArray<T> &def, bool (*changed)(T &, T &))
+{
+	if (arc.isReading() && arc.GetSize(key) != ~0u)
+	{
+		arc(key, value, def);
+		return;
+	}
+
+	if (arc.BeginObject(key))
+	{
+		unsigned count = value.Size();
+		TArray<uint32_t> indices;
+		if (arc.isWriting())
+		{
+			for (unsigned i = 0; i < count; i++)
+			{
+				if (save_full || changed(value[i], def[i])) indices.Push(i);
+			}
+		}
+		arc("count", count)
+			("indices", indices);
+
+		if (arc.BeginArray("elements"))
+		{
+			count = indices.Size();
+			if (arc.isReading() && arc.ArraySize() < count) count = arc.ArraySize();
+			for (unsigned i = 0; i < count; i++)
+			{
+				unsigned index = indices[i];
+				if (index >= value.Size())
+				{
+					I_Error("Invalid element %u in '%s'", index, key);
+				}
+				Serialize(arc, nullptr, value[index], save_full ? nullptr : &def[index]);
+			}
+			arc.EndArray();
+		}
+		arc.EndObject();
+	}
+}
+
+static unsigned MapArraySize(FSerializer &arc, const char *key)
+{
+	unsigned size = arc.GetSize(key);
+	if (size == ~0u && arc.BeginObject(key))
+	{
+		arc("count", size);
+		arc.EndObject();
+	}
+	return size;
+}
+
 //============================================================================
 //
 //
@@ -929,9 +1084,9 @@ void G_SerializeLevel(FSerializer &arc, bool hubload)
 		// deep down in the deserializer or just a crash if the few insufficient safeguards were not triggered.
 		uint8_t chk[16] = { 0 };
 		arc.Array("checksum", chk, 16);
-		if (arc.GetSize("linedefs") != level.lines.Size() ||
-			arc.GetSize("sidedefs") != level.sides.Size() ||
-			arc.GetSize("sectors") != level.sectors.Size() ||
+		if (MapArraySize(arc, "linedefs") != level.lines.Size() ||
+			MapArraySize(arc, "sidedefs") != level.sides.Size() ||
+			MapArraySize(arc, "sectors") != level.sectors.Size() ||
 			arc.GetSize("polyobjs") != (unsigned)po_NumPolyobjs ||
 			memcmp(chk, level.md5, 16))
 		{
@@ -986,9 +1141,9 @@ void G_SerializeLevel(FSerializer &arc, bool hubload)
 
 	FBehavior::StaticSerializeModuleStates(arc);
 	// The order here is important: First world state, then portal state, then thinkers, and last polyobjects.
-	arc("linedefs", level.lines, level.loadlines);
-	arc("sidedefs", level.sides, level.loadsides);
-	arc("sectors", level.sectors, level.loadsectors);
+	SerializeMapArray(arc, "linedefs", level.lines, level.loadlines, LineChanged);
+	SerializeMapArray(arc, "sidedefs", level.sides, level.loadsides, SideChanged);
+	SerializeMapArray(arc, "sectors", level.sectors, level.loadsectors, SectorChanged);
 	arc("zones", level.Zones);
 	arc("lineportals", linePortals);
 	arc("sectorportals", level.sectorPortals);
@@ -998,6 +1153,7 @@ void G_SerializeLevel(FSerializer &arc, bool hubload)
 	E_SerializeEvents(arc);
 	DThinker::SerializeThinkers(arc, hubload);
 	arc.Array("polyobjs", polyobjs, po_NumPolyobjs);
+	Navigation.Serialize(arc);
 	SerializeSubsectors(arc, "subsectors");
 	StatusBar->SerializeMessages(arc);
 	AM_SerializeMarkers(arc);
@@ -81,6 +81,7 @@ public:
 
 	void Serialize(FSerializer &arc);
 	void Tick ();
+	int GetTickKey(bool &parallel) const override;
 
 	bool AffectsWall (int wallnum) const { return m_Type == EScroll::sc_side && m_Affectee == wallnum; }
 	int GetWallNum () const { return m_Type == EScroll::sc_side ? m_Affectee : -1; }
@@ -268,6 +269,22 @@ void DScroller::Tick ()
 	}
 }
 
+//-----------------------------------------------------------------------------
+//
+// Wall and flat scrollers only move the texture offsets of their affectee.
+// The control sector is only read and its heights only change when the
+// sector effects tick, which happens after all scrollers are done.
+// Carrying scrollers mark the actors touching the sector and must not
+// leave the main thread.
+//
+//-----------------------------------------------------------------------------
+
+int DScroller::GetTickKey(bool &parallel) const
+{
+	parallel = m_Type != EScroll::sc_carry;
+	return m_Type == EScroll::sc_side ? level.sectors.Size() + m_Affectee : m_Affectee;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Add_Scroller()
@@ -24,21 +24,65 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <mutex>
 #include "g_levellocals.h"
 #include "r_state.h"
 #include "p_maputl.h"
 #include "p_blockmap.h"
 #include "memarena.h"
 #include "actor.h"
+#include "po_man.h"
+#include "stats.h"
 
 //=============================================================================
 // phares 3/21/98
 //
 // Maintain a freelist of msecnode_t's to reduce memory allocs and frees.
+//
+// Every thread has its own freelist and arena, so taking and returning
+// nodes needs no locking. A node may be returned to another thread's
+// pool than the one it came from. The pools are only ever freed all at
+// once, when no thread is using them.
 //=============================================================================
 
-msecnode_t *headsecnode = nullptr;
-FMemArena secnodearena;
+struct FSecnodePool
+{
+	msecnode_t *FreeList = nullptr;
+	FMemArena Arena;
+	FSecnodePool *Next = nullptr;
+
+	// Per tic statistics
+	int Allocated = 0;
+	int Freed = 0;
+	int Rebuilt = 0;
+	int Skipped = 0;
+	int Searched = 0;
+	int Found = 0;
+};
+
+static std::mutex SecnodePoolMutex;
+static FSecnodePool *SecnodePools;
+static thread_local FSecnodePool *ThreadSecnodePool;
+
+static FSecnodePool *GetSecnodePool()
+{
+	FSecnodePool *pool = ThreadSecnodePool;
+	if (pool == nullptr)
+	{
+		pool = new FSecnodePool;
+		std::lock_guard<std::mutex> lock(SecnodePoolMutex);
+		pool->Next = SecnodePools;
+		SecnodePools = pool;
+		ThreadSecnodePool = pool;
+	}
+	return pool;
+}
+
+// Free boxes stored in actors are only valid for the level they were made in
+static uint32_t SecnodeLevel = 1;
+
+// How far a free box extends beyond the actor's own box
+static const double SECNODE_FREEMARGIN = 32.;
 
 //=============================================================================
 //
@@ -51,17 +95,19 @@ FMemArena secnodearena;
 
 msecnode_t *P_GetSecnode()
 {
+	FSecnodePool *pool = GetSecnodePool();
 	msecnode_t *node;
 
-	if (headsecnode)
+	if (pool->FreeList)
 	{
-		node = headsecnode;
-		headsecnode = headsecnode->m_snext;
+		node = pool->FreeList;
+		pool->FreeList = node->m_snext;
 	}
 	else
 	{
-		node = (msecnode_t *)secnodearena.Alloc(sizeof(*node));
+		node = (msecnode_t *)pool->Arena.Alloc(sizeof(*node));
 	}
+	pool->Allocated++;
 	return node;
 }
 
@@ -75,8 +121,76 @@ msecnode_t *P_GetSecnode()
 
 void P_PutSecnode(msecnode_t *node)
 {
-	node->m_snext = headsecnode;
-	headsecnode = node;
+	FSecnodePool *pool = GetSecnodePool();
+	node->m_snext = pool->FreeList;
+	pool->FreeList = node;
+	pool->Freed++;
+}
+
+//=============================================================================
+//
+// P_FreeSecnodes
+//
+// Releases the memory of all nodes. Nothing may be linked anymore.
+//
+//=============================================================================
+
+void P_FreeSecnodes()
+{
+	std::lock_guard<std::mutex> lock(SecnodePoolMutex);
+	for (FSecnodePool *pool = SecnodePools; pool != nullptr; pool = pool->Next)
+	{
+		pool->Arena.FreeAllBlocks();
+		pool->FreeList = nullptr;
+	}
+}
+
+//=============================================================================
+//
+// P_ResetSecnodeBoxes
+//
+// Called when the level's geometry goes away
+//
+//=============================================================================
+
+void P_ResetSecnodeBoxes()
+{
+	if (++SecnodeLevel == 0) SecnodeLevel = 1;
+}
+
+//=============================================================================
+//
+// Statistics
+//
+//=============================================================================
+
+ADD_STAT (secnodes)
+{
+	FString out;
+	int allocated = 0, freed = 0, rebuilt = 0, skipped = 0, searched = 0, found = 0;
+	std::lock_guard<std::mutex> lock(SecnodePoolMutex);
+	for (FSecnodePool *pool = SecnodePools; pool != nullptr; pool = pool->Next)
+	{
+		allocated += pool->Allocated;
+		freed += pool->Freed;
+		rebuilt += pool->Rebuilt;
+		skipped += pool->Skipped;
+		searched += pool->Searched;
+		found += pool->Found;
+	}
+	out.Format("nodes touched %d (%d added, %d removed), lists %d rebuilt, %d unchanged, free boxes %d searched, %d found\n",
+		allocated + freed, allocated, freed, rebuilt, skipped, searched, found);
+	return out;
+}
+
+void P_ResetSecnodeCounters()
+{
+	std::lock_guard<std::mutex> lock(SecnodePoolMutex);
+	for (FSecnodePool *pool = SecnodePools; pool != nullptr; pool = pool->Next)
+	{
+		pool->Allocated = pool->Freed = pool->Rebuilt = pool->Skipped = 0;
+		pool->Searched = pool->Found = 0;
+	}
 }
 
 //=============================================================================
@@ -214,6 +328,48 @@ void P_DelSeclist(portnode_t *node, portnode_t *FLinePortal::*sechead)
 }
 
 
+//=============================================================================
+//
+// Looks for lines crossing a box around the actor's that is larger by
+// SECNODE_FREEMARGIN. If there are none, no line crosses any box inside
+// it either, because the tests below only get more true for larger boxes.
+// As long as the lines do not move, an actor that only touches its own
+// sector keeps that list while it stays inside the box.
+//
+// A failed search is remembered as well, so an actor standing next to a
+// wall does not scan the blockmap again on every move. Its box is only
+// searched again once it has left the blocked one.
+//
+//=============================================================================
+
+static void P_FindSecnodeFreeBox(FSecnodePool *pool, AActor *thing, const FBoundingBox &box)
+{
+	FBoundingBox freebox(box.Left() - SECNODE_FREEMARGIN, box.Bottom() - SECNODE_FREEMARGIN,
+		box.Right() + SECNODE_FREEMARGIN, box.Top() + SECNODE_FREEMARGIN);
+	FBlockLinesIterator it(freebox, true);
+	line_t *ld;
+
+	pool->Searched++;
+	thing->SecnodeFreeBox = freebox;
+	thing->SecnodeFreeLevel = SecnodeLevel;
+	thing->SecnodeFreeBlocked = true;
+	while ((ld = it.Next()))
+	{
+		if (freebox.inRange(ld) && freebox.BoxOnLineSide(ld) == -1)
+			return;
+	}
+	thing->SecnodeFreeBlocked = false;
+	pool->Found++;
+}
+
+static bool P_InSecnodeFreeBox(AActor *thing, const FBoundingBox &box)
+{
+	const FBoundingBox &freebox = thing->SecnodeFreeBox;
+	return thing->SecnodeFreeLevel == SecnodeLevel &&
+		box.Left() > freebox.Left() && box.Right() < freebox.Right() &&
+		box.Bottom() > freebox.Bottom() && box.Top() < freebox.Top();
+}
+
 //=============================================================================
 // phares 3/14/98
 //
@@ -225,8 +381,22 @@ void P_DelSeclist(portnode_t *node, portnode_t *FLinePortal::*sechead)
 
 msecnode_t *P_CreateSecNodeList(AActor *thing, double radius, msecnode_t *sector_list, msecnode_t *sector_t::*seclisthead)
 {
+	FSecnodePool *pool = GetSecnodePool();
+	FBoundingBox box(thing->X(), thing->Y(), radius);
+	bool staticlines = po_NumPolyobjs == 0;
+	bool insearched = staticlines && P_InSecnodeFreeBox(thing, box);
 	msecnode_t *node;
 
+	// A list with only the actor's own sector stays the same as long as no
+	// line crosses the actor's box. Rebuilding it would keep the same node.
+	if (insearched && !thing->SecnodeFreeBlocked && sector_list != nullptr && sector_list->m_tnext == nullptr &&
+		sector_list->m_sector == thing->Sector && sector_list->m_thing == thing)
+	{
+		pool->Skipped++;
+		return sector_list;
+	}
+	pool->Rebuilt++;
+
 	// First, clear out the existing m_thing fields. As each node is
 	// added or verified as needed, m_thing will be set properly. When
 	// finished, delete all nodes where m_thing is still nullptr. These
@@ -239,8 +409,7 @@ msecnode_t *P_CreateSecNodeList(AActor *thing, double radius, msecnode_t *sector
 		node = node->m_tnext;
 	}
 
-	FBoundingBox box(thing->X(), thing->Y(), radius);
-	FBlockLinesIterator it(box);
+	FBlockLinesIterator it(box, true);
 	line_t *ld;
 
 	while ((ld = it.Next()))
@@ -289,6 +458,14 @@ msecnode_t *P_CreateSecNodeList(AActor *thing, double radius, msecnode_t *sector
 			node = node->m_tnext;
 		}
 	}
+
+	// Fast movers leave any box of this size within a tic or two, so
+	// searching one for them would only double the blockmap work.
+	if (staticlines && !insearched && sector_list->m_tnext == nullptr &&
+		thing->Vel.XY().LengthSquared() < (SECNODE_FREEMARGIN / 2) * (SECNODE_FREEMARGIN / 2))
+	{
+		P_FindSecnodeFreeBox(pool, thing, box);
+	}
 	return sector_list;
 }
 
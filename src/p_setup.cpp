@@ -106,6 +106,8 @@
 #include "r_renderer.h"
 #include "r_data/colormaps.h"
 #include "p_blockmap.h"
+#include "p_pvs.h"
+#include "p_navigation.h"
 #include "r_utility.h"
 #include "p_spec.h"
 #include "p_saveg.h"
@@ -138,6 +140,16 @@ extern unsigned int R_OldBlend;
 EXTERN_CVAR(Bool, am_textured)
 
 CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
+// Anything but the default size forces the blockmap to be generated.
+// Since it changes the order in which lines are checked, demos may not
+// play back correctly with a different size than they were recorded with.
+CUSTOM_CVAR (Int, blockmapsize, FBlockmap::MAPBLOCKUNITS, CVAR_SERVERINFO|CVAR_GLOBALCONFIG)
+{
+	// Must be a power of 2 for P_CreateBlockMap.
+	int size = 32;
+	while (size < 1024 && size < self) size <<= 1;
+	if (size != self) self = size;
+}
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, genglnodes, false, CVAR_SERVERINFO);
 CVAR (Bool, showloadtimes, false, 0);
@@ -2794,11 +2806,9 @@ static void CreatePackedBlockmap (TArray<int> &BlockMap, TArray<int> *blocks, in
 //	printf ("%d blocks written, %d blocks saved\n", nothashed, hashed);
 }
 
-#define BLOCKBITS 7
-#define BLOCKSIZE 128
-
-static void P_CreateBlockMap ()
+static int P_CreateBlockMap (int blocksize)
 {
+	int blockbits = 0;
 	TArray<int> *BlockLists, *block, *endblock;
 	int adder;
 	int bmapwidth, bmapheight;
@@ -2807,7 +2817,10 @@ static void P_CreateBlockMap ()
 	int line;
 
 	if (level.vertexes.Size() == 0)
-		return;
+		return 0;
+
+	while ((1 << blockbits) < blocksize)
+		blockbits++;
 
 	// Find map extents for the blockmap
 	dminx = dmaxx = level.vertexes[0].fX();
@@ -2826,8 +2839,8 @@ static void P_CreateBlockMap ()
 	maxx = int(dmaxx);
 	maxy = int(dmaxy);
 
-	bmapwidth =	 ((maxx - minx) >> BLOCKBITS) + 1;
-	bmapheight = ((maxy - miny) >> BLOCKBITS) + 1;
+	bmapwidth =	 ((maxx - minx) >> blockbits) + 1;
+	bmapheight = ((maxy - miny) >> blockbits) + 1;
 
 	TArray<int> BlockMap (bmapwidth * bmapheight * 3 + 4);
 
@@ -2846,10 +2859,10 @@ static void P_CreateBlockMap ()
 		int y2 = int(level.lines[line].v2->fY());
 		int dx = x2 - x1;
 		int dy = y2 - y1;
-		int bx = (x1 - minx) >> BLOCKBITS;
-		int by = (y1 - miny) >> BLOCKBITS;
-		int bx2 = (x2 - minx) >> BLOCKBITS;
-		int by2 = (y2 - miny) >> BLOCKBITS;
+		int bx = (x1 - minx) >> blockbits;
+		int by = (y1 - miny) >> blockbits;
+		int bx2 = (x2 - minx) >> blockbits;
+		int by2 = (y2 - miny) >> blockbits;
 
 		block = &BlockLists[bx + by * bmapwidth];
 		endblock = &BlockLists[bx2 + by2 * bmapwidth];
@@ -2892,25 +2905,25 @@ static void P_CreateBlockMap ()
 
 			if (adx == ady)		// 45 degrees
 			{
-				int xb = (x1 - minx) & (BLOCKSIZE-1);
-				int yb = (y1 - miny) & (BLOCKSIZE-1);
+				int xb = (x1 - minx) & (blocksize-1);
+				int yb = (y1 - miny) & (blocksize-1);
 				if (dx < 0)
 				{
-					xb = BLOCKSIZE-xb;
+					xb = blocksize-xb;
 				}
 				if (dy < 0)
 				{
-					yb = BLOCKSIZE-yb;
+					yb = blocksize-yb;
 				}
 				if (xb < yb)
 					adx--;
 			}
 			if (adx >= ady)		// X-major
 			{
-				int yadd = dy < 0 ? -1 : BLOCKSIZE;
+				int yadd = dy < 0 ? -1 : blocksize;
 				do
 				{
-					int stop = (Scale ((by << BLOCKBITS) + yadd - (y1 - miny), dx, dy) + (x1 - minx)) >> BLOCKBITS;
+					int stop = (Scale ((by << blockbits) + yadd - (y1 - miny), dx, dy) + (x1 - minx)) >> blockbits;
 					while (bx != stop)
 					{
 						block->Push (line);
@@ -2930,10 +2943,10 @@ static void P_CreateBlockMap ()
 			}
 			else					// Y-major
 			{
-				int xadd = dx < 0 ? -1 : BLOCKSIZE;
+				int xadd = dx < 0 ? -1 : blocksize;
 				do
 				{
-					int stop = (Scale ((bx << BLOCKBITS) + xadd - (x1 - minx), dy, dx) + (y1 - miny)) >> BLOCKBITS;
+					int stop = (Scale ((bx << blockbits) + xadd - (x1 - minx), dy, dx) + (y1 - miny)) >> blockbits;
 					while (by != stop)
 					{
 						block->Push (line);
@@ -2963,6 +2976,58 @@ static void P_CreateBlockMap ()
 	{
 		level.blockmap.blockmaplump[ii] = BlockMap[ii];
 	}
+	return BlockMap.Size();
+}
+
+//===========================================================================
+//
+// P_GenerateBlockMap
+//
+// Gets a generated blockmap from the level cache, or creates and caches it.
+//
+//===========================================================================
+
+static void P_GenerateBlockMap (MapData *map, int blocksize)
+{
+	TArray<uint8_t> data;
+
+	if (P_ReadLevelCache(map, ".bmc", blocksize, data) && data.Size() >= 4 * sizeof(int) && data.Size() % sizeof(int) == 0)
+	{
+		int count = data.Size() / sizeof(int);
+		const int *cached = (const int *)&data[0];
+
+		level.blockmap.blockmaplump = new int[count];
+		for (int i = 0; i < count; i++)
+		{
+			level.blockmap.blockmaplump[i] = LittleLong(cached[i]);
+		}
+		if (level.blockmap.VerifyBlockMap(count))
+		{
+			DPrintf (DMSG_SPAMMY, "Using cached BLOCKMAP\n");
+			return;
+		}
+		delete[] level.blockmap.blockmaplump;
+		level.blockmap.blockmaplump = nullptr;
+	}
+
+	DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
+
+	cycle_t buildtime;
+	buildtime.Reset();
+	buildtime.Clock();
+	int count = P_CreateBlockMap (blocksize);
+	buildtime.Unclock();
+
+	if (count > 0)
+	{
+		TArray<int> swapped;
+		swapped.Resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			swapped[i] = LittleLong(level.blockmap.blockmaplump[i]);
+		}
+		P_WriteLevelCache(map, ".bmc", blocksize, &swapped[0], count * sizeof(int), buildtime.TimeMS() / 1000.);
+	}
 }
 
 
@@ -3065,13 +3130,15 @@ void P_LoadBlockMap (MapData * map)
 {
 	int count = map->Size(ML_BLOCKMAP);
 
+	level.blockmap.BlockSize = FBlockmap::MAPBLOCKUNITS;
 	if (ForceNodeBuild || genblockmap ||
 		count/2 >= 0x10000 || count == 0 ||
+		blockmapsize != FBlockmap::MAPBLOCKUNITS ||
 		Args->CheckParm("-blockmap")
 		)
 	{
-		DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
-		P_CreateBlockMap ();
+		level.blockmap.BlockSize = blockmapsize;
+		P_GenerateBlockMap (map, level.blockmap.BlockSize);
 	}
 	else
 	{
@@ -3102,8 +3169,9 @@ void P_LoadBlockMap (MapData * map)
 
 		if (!level.blockmap.VerifyBlockMap(count))
 		{
-			DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
-			P_CreateBlockMap();
+			delete[] level.blockmap.blockmaplump;
+			level.blockmap.blockmaplump = nullptr;
+			P_GenerateBlockMap (map, level.blockmap.BlockSize);
 		}
 
 	}
@@ -3118,6 +3186,67 @@ void P_LoadBlockMap (MapData * map)
 	level.blockmap.blocklinks = new FBlockNode *[count];
 	memset (level.blockmap.blocklinks, 0, count*sizeof(*level.blockmap.blocklinks));
 	level.blockmap.blockmap = level.blockmap.blockmaplump+4;
+	level.blockmap.BuildFlatLines();
+}
+
+//===========================================================================
+//
+// FBlockmap :: BuildFlatLines
+//
+// Must be called again once the polyobjects have been spawned. Their lines
+// remain in the lists of the blocks they started in but can move anywhere,
+// so their boxes cannot be used to reject them.
+//
+//===========================================================================
+
+void FBlockmap::BuildFlatLines()
+{
+	int count = bmapwidth * bmapheight;
+	int total = 0;
+
+	FlatStart.Resize(count + 1);
+	for (int i = 0; i < count; i++)
+	{
+		int num = 0;
+		for (int *list = GetLines(i % bmapwidth, i / bmapwidth); *list != -1; list++) num++;
+		FlatStart[i] = total;
+		total += (num + 3) & ~3;
+	}
+	FlatStart[count] = total;
+
+	FlatLines.Resize(total);
+	FlatLeft.Resize(total);
+	FlatBottom.Resize(total);
+	FlatRight.Resize(total);
+	FlatTop.Resize(total);
+
+	for (int i = 0; i < count; i++)
+	{
+		int pos = FlatStart[i];
+		for (int *list = GetLines(i % bmapwidth, i / bmapwidth); *list != -1; list++, pos++)
+		{
+			line_t *ld = &level.lines[*list];
+			FlatLines[pos] = *list;
+			if (ld->sidedef[0] != nullptr && (ld->sidedef[0]->Flags & WALLF_POLYOBJ))
+			{
+				FlatLeft[pos] = FlatBottom[pos] = -FLT_MAX;
+				FlatRight[pos] = FlatTop[pos] = FLT_MAX;
+			}
+			else
+			{
+				FlatLeft[pos] = RoundDown(ld->bbox[BOXLEFT]);
+				FlatBottom[pos] = RoundDown(ld->bbox[BOXBOTTOM]);
+				FlatRight[pos] = RoundUp(ld->bbox[BOXRIGHT]);
+				FlatTop[pos] = RoundUp(ld->bbox[BOXTOP]);
+			}
+		}
+		for (; pos < FlatStart[i + 1]; pos++)
+		{
+			FlatLines[pos] = -1;
+			FlatLeft[pos] = FlatBottom[pos] = FLT_MAX;
+			FlatRight[pos] = FlatTop[pos] = -FLT_MAX;
+		}
+	}
 }
 
 //===========================================================================
@@ -3484,6 +3613,19 @@ static void P_PrecacheLevel()
 		if (tex.Exists()) hitlist[tex.GetIndex()] |= FTextureManager::HIT_Wall;
 	}
 
+	// Decompress the textures' source lumps on the job system while the
+	// renderer works through them.
+	TArray<int> lumps;
+	for (i = 0; i < cnt; i++)
+	{
+		if (hitlist[i] != 0)
+		{
+			int lump = TexMan.ByIndex(i)->GetSourceLump();
+			if (lump >= 0) lumps.Push(lump);
+		}
+	}
+	Wads.PrefetchLumps(lumps);
+
 	Renderer->Precache(hitlist, actorhitlist);
 
 	delete[] hitlist;
@@ -3499,6 +3641,10 @@ extern polyblock_t **PolyBlockMap;
 
 void P_FreeLevelData ()
 {
+	P_ClearSightCache();
+	P_ResetSecnodeBoxes();
+	PVS.Clear();
+	Navigation.Clear();
 	// [ZZ] delete per-map event handlers
 	E_Shutdown(true);
 	MapThingsConverted.Clear();
@@ -3586,9 +3732,6 @@ void P_FreeLevelData ()
 //
 //===========================================================================
 
-extern FMemArena secnodearena;
-extern msecnode_t *headsecnode;
-
 void P_FreeExtraLevelData()
 {
 	// Free all blocknodes and msecnodes.
@@ -3604,8 +3747,7 @@ void P_FreeExtraLevelData()
 		}
 		FBlockNode::FreeBlocks = NULL;
 	}
-	secnodearena.FreeAllBlocks();
-	headsecnode = nullptr;
+	P_FreeSecnodes();
 }
 
 
@@ -4058,7 +4200,6 @@ void P_SetupLevel (const char *lumpname, int position)
 		}
 		delete[] buildthings;
 	}
-	delete map;
 	if (oldvertextable != NULL)
 	{
 		delete[] oldvertextable;
@@ -4086,9 +4227,14 @@ void P_SetupLevel (const char *lumpname, int position)
 	times[16].Clock();
 	if (reloop) P_LoopSidedefs (false);
 	PO_Init ();				// Initialize the polyobjs
+	level.blockmap.BuildFlatLines();
 	P_FinalizePortals();	// finalize line portals after polyobjects have been initialized. This info is needed for properly flagging them.
 	times[16].Unclock();
 
+	PVS.Build(map);			// needs to know about portals and polyobjects
+	Navigation.Build();
+	delete map;
+
 	assert(sidetemp != NULL);
 	delete[] sidetemp;
 	sidetemp = NULL;
@@ -127,6 +127,8 @@ int GetUDMFInt(int type, int index, FName key);
 double GetUDMFFloat(int type, int index, FName key);
 
 bool P_LoadGLNodes(MapData * map);
+bool P_ReadLevelCache(MapData *map, const char *ext, uint32_t param, TArray<uint8_t> &data);
+void P_WriteLevelCache(MapData *map, const char *ext, uint32_t param, const void *data, uint32_t size, double buildtime);
 bool P_CheckNodes(MapData * map, bool rebuilt, int buildtime);
 bool P_CheckForGLNodes();
 void P_SetRenderSector();
@@ -36,6 +36,9 @@
 #include "b_bot.h"
 #include "p_spec.h"
 #include "vm.h"
+#include "c_cvars.h"
+#include "jobsystem.h"
+#include "p_pvs.h"
 
 // State.
 #include "r_state.h"
@@ -57,10 +60,14 @@ This uses specialized forms of the maputils routines for optimized performance
 ==============================================================================
 */
 
+CVAR(Bool, sight_cache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+EXTERN_CVAR(Bool, pvs_verify)
+
 // Performance meters
-static int sightcounts[6];
+static thread_local int sightcounts[6];
 static cycle_t SightCycles;
 static cycle_t MaxSightCycles;
+static int SightCacheHits, SightCacheMisses, SightCacheBatched;
 
 enum
 {
@@ -94,8 +101,190 @@ struct SightTask
 };
 
 
-static TArray<intercept_t> intercepts (128);
-static TArray<SightTask> portals(32);
+// Scratch data is per thread so that cached sight checks can be computed
+// on the job system. Lines and polyobjects get marked in a thread's own
+// stamp arrays instead of their shared validcount fields.
+static thread_local TArray<intercept_t> intercepts (128);
+static thread_local TArray<SightTask> portals(32);
+
+struct FSightStamps
+{
+	TArray<unsigned> Lines;
+	TArray<unsigned> Polys;
+	unsigned Current = 0;
+
+	void Next()
+	{
+		if (Lines.Size() != level.lines.Size())
+		{
+			Lines.Resize(level.lines.Size());
+			Reset(Lines);
+		}
+		if (Polys.Size() != (unsigned)po_NumPolyobjs)
+		{
+			Polys.Resize(po_NumPolyobjs);
+			Reset(Polys);
+		}
+		if (++Current == 0)
+		{
+			// Wrapped around, so old marks could match again.
+			Reset(Lines);
+			Reset(Polys);
+			Current = 1;
+		}
+	}
+
+private:
+	static void Reset(TArray<unsigned> &marks)
+	{
+		for (auto &mark : marks) mark = 0;
+	}
+};
+static thread_local FSightStamps SightStamps;
+
+//==========================================================================
+//
+// Sight cache
+//
+// Remembers the result of the line traversal for a looker/target pair
+// together with everything the traversal read: the endpoints, the lines
+// it crossed and the sectors on either side of them. A later check for
+// the same pair reuses the result if none of that changed, which is much
+// cheaper than walking the blockmap again. Maps with linked portals, line
+// portals or polyobjects are not cached because the set of lines a trace
+// crosses is not fixed there.
+//
+//==========================================================================
+
+struct FSightLineDep
+{
+	line_t *Line;
+	uint32_t Flags;
+	int Special;
+	int Args1;
+	uint32_t Activation;
+};
+
+struct FSightCacheEntry
+{
+	AActor *Looker;
+	AActor *Target;
+	int Flags;
+	DVector3 LookerPos, TargetPos;
+	double LookerHeight, TargetHeight;
+	sector_t *LookerSector, *TargetSector;
+	bool Result;
+	bool Valid;
+	unsigned LastUsed;		// SightCacheTic of the last lookup
+
+	TArray<FSightLineDep> Lines;
+	TArray<sector_t *> Sectors;
+	TArray<uint64_t> SectorSignatures;
+};
+
+static TMap<uint64_t, FSightCacheEntry *> SightCache;
+static const unsigned MaxSightCacheEntries = 16384;
+static unsigned SightCacheLimit = MaxSightCacheEntries;	// size at which unused entries get dropped
+static unsigned SightCacheTic;
+
+enum
+{
+	SF_CACHEDFLAGS = SF_SEEPASTSHOOTABLELINES | SF_SEEPASTBLOCKEVERYTHING | SF_IGNOREWATERBOUNDARY,
+	SF_COMPATTRACE = 16,	// COMPATF_TRACE was set when the entry was made
+};
+
+static inline uint64_t SightMix(uint64_t h, uint64_t v)
+{
+	h ^= v;
+	h *= 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 29);
+}
+
+static inline uint64_t SightMix(uint64_t h, double v)
+{
+	uint64_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	return SightMix(h, bits);
+}
+
+static uint64_t SightMixPlane(uint64_t h, const secplane_t &plane)
+{
+	const DVector3 &n = plane.Normal();
+	h = SightMix(h, n.X);
+	h = SightMix(h, n.Y);
+	h = SightMix(h, n.Z);
+	return SightMix(h, plane.fD());
+}
+
+// Everything about a sector a sight trace looks at
+static uint64_t SectorSightSignature(const sector_t *sec)
+{
+	uint64_t h = SightMixPlane(0, sec->floorplane);
+	h = SightMixPlane(h, sec->ceilingplane);
+	for (int plane = sector_t::floor; plane <= sector_t::ceiling; plane++)
+	{
+		// Portals can be attached, retargeted or toggled at run time.
+		auto &portal = level.sectorPortals[sec->Portals[plane]];
+		h = SightMix(h, (uint64_t)sec->Portals[plane]);
+		h = SightMix(h, (uint64_t)sec->planes[plane].Flags);
+		h = SightMix(h, (uint64_t)portal.mType);
+		h = SightMix(h, (uint64_t)portal.mFlags);
+	}
+	for (auto rover : sec->e->XFloor.ffloors)
+	{
+		h = SightMix(h, (uint64_t)rover->flags);
+		h = SightMixPlane(h, *rover->top.plane);
+		h = SightMixPlane(h, *rover->bottom.plane);
+	}
+	return h;
+}
+
+static bool SightCacheUsable()
+{
+	return sight_cache && po_NumPolyobjs == 0 && linePortals.Size() == 0 &&
+		!PortalBlockmap.containsLines && !PortalBlockmap.hasLinkedSectorPortals;
+}
+
+static int SightCacheFlags(int flags)
+{
+	flags &= SF_CACHEDFLAGS;
+	if (i_compatflags & COMPATF_TRACE) flags |= SF_COMPATTRACE;
+	return flags;
+}
+
+static uint64_t SightCacheKey(AActor *t1, AActor *t2, int flags)
+{
+	uint64_t h = SightMix(0, (uint64_t)(uintptr_t)t1);
+	h = SightMix(h, (uint64_t)(uintptr_t)t2);
+	return SightMix(h, (uint64_t)flags);
+}
+
+static bool SightCacheValid(const FSightCacheEntry *entry, AActor *t1, AActor *t2, int flags)
+{
+	if (!entry->Valid || entry->Looker != t1 || entry->Target != t2 || entry->Flags != flags ||
+		entry->LookerPos != t1->Pos() || entry->TargetPos != t2->Pos() ||
+		entry->LookerHeight != t1->Height || entry->TargetHeight != t2->Height ||
+		entry->LookerSector != t1->Sector || entry->TargetSector != t2->Sector)
+	{
+		return false;
+	}
+	for (auto &dep : entry->Lines)
+	{
+		line_t *ld = dep.Line;
+		if (ld->flags != dep.Flags || ld->special != dep.Special || ld->args[1] != dep.Args1 || ld->activation != dep.Activation)
+		{
+			return false;
+		}
+	}
+	for (unsigned i = 0; i < entry->Sectors.Size(); i++)
+	{
+		if (SectorSightSignature(entry->Sectors[i]) != entry->SectorSignatures[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
 class SightCheck
 {
@@ -114,6 +303,7 @@ class SightCheck
 	int portalgroup;
 	bool portalfound;
 	unsigned int myseethrough;
+	FSightCacheEntry *record = nullptr;	// collects the lines this check depends on
 
 	void P_SightOpening(SightOpening &open, const line_t *linedef, double x, double y);
 	bool PTR_SightTraverse (intercept_t *in);
@@ -125,6 +315,11 @@ class SightCheck
 public:
 	bool P_SightPathTraverse ();
 
+	void SetRecord(FSightCacheEntry *entry)
+	{
+		record = entry;
+	}
+
 	void init(AActor * t1, AActor * t2, sector_t *startsector, SightTask *task, int flags)
 	{
 		sightstart = t1->PosRelative(task->portalgroup);
@@ -432,11 +627,12 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 {
 	divline_t dl;
 
-	if (ld->validcount == validcount)
+	unsigned &mark = SightStamps.Lines[ld->Index()];
+	if (mark == SightStamps.Current)
 	{
 		return true;
 	}
-	ld->validcount = validcount;
+	mark = SightStamps.Current;
 	if (P_PointOnDivlineSide (ld->v1->fPos(), &Trace) ==
 		P_PointOnDivlineSide (ld->v2->fPos(), &Trace))
 	{
@@ -449,6 +645,11 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 		return true;		// line isn't crossed
 	}
 
+	if (record != nullptr)
+	{
+		record->Lines.Push({ ld, ld->flags, ld->special, ld->args[1], ld->activation });
+	}
+
 	if (!portalfound)	// when portals come into play, the quick-outs here may not be performed
 	{
 		if (LineBlocksSight(ld)) return false;
@@ -494,9 +695,10 @@ int SightCheck::P_SightBlockLinesIterator (int x, int y)
 	{
 		if (polyLink->polyobj)
 		{ // only check non-empty links
-			if (polyLink->polyobj->validcount != validcount)
+			unsigned &mark = SightStamps.Polys[int(polyLink->polyobj - polyobjs)];
+			if (mark != SightStamps.Current)
 			{
-				polyLink->polyobj->validcount = validcount;
+				mark = SightStamps.Current;
 				for (i = 0; i < polyLink->polyobj->Linedefs.Size(); i++)
 				{
 					if (!P_SightCheckLine(polyLink->polyobj->Linedefs[i]))
@@ -626,7 +828,7 @@ bool SightCheck::P_SightPathTraverse ()
 	int mapx, mapy, mapxstep, mapystep;
 	int count;
 
-	validcount++;
+	SightStamps.Next();
 	intercepts.Clear ();
 	x1 = sightstart.X + Startfrac * Trace.dx;
 	y1 = sightstart.Y + Startfrac * Trace.dy;
@@ -667,13 +869,13 @@ bool SightCheck::P_SightPathTraverse ()
 
 	x1 -= level.blockmap.bmaporgx;
 	y1 -= level.blockmap.bmaporgy;
-	xt1 = x1 / FBlockmap::MAPBLOCKUNITS;
-	yt1 = y1 / FBlockmap::MAPBLOCKUNITS;
+	xt1 = x1 / level.blockmap.BlockSize;
+	yt1 = y1 / level.blockmap.BlockSize;
 
 	x2 -= level.blockmap.bmaporgx;
 	y2 -= level.blockmap.bmaporgy;
-	xt2 = x2 / FBlockmap::MAPBLOCKUNITS;
-	yt2 = y2 / FBlockmap::MAPBLOCKUNITS;
+	xt2 = x2 / level.blockmap.BlockSize;
+	yt2 = y2 / level.blockmap.BlockSize;
 
 	mapx = xs_FloorToInt(xt1);
 	mapy = xs_FloorToInt(yt1);
@@ -824,6 +1026,133 @@ sightcounts[2]++;
 	return traverseres;
 }
 
+//==========================================================================
+//
+// P_SightTraverse
+//
+// The precise part of the sight check. Only touches thread local state,
+// so it may run on the job system while the playsim is not modifying
+// the level. If record is non-null, the lines and sectors the result
+// depends on are stored in it.
+//
+//==========================================================================
+
+static bool P_SightTraverse(AActor *t1, AActor *t2, int flags, FSightCacheEntry *record)
+{
+	bool res;
+
+	portals.Clear();
+
+	sector_t *sec;
+	double lookheight = t1->Z() + t1->Height*0.75;
+	t1->GetPortalTransition(lookheight, &sec);
+
+	double bottomslope = t2->Z() - lookheight;
+	double topslope = bottomslope + t2->Height;
+	SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
+
+
+	SightCheck s;
+	s.init(t1, t2, sec, &task, flags);
+	s.SetRecord(record);
+	res = s.P_SightPathTraverse ();
+	if (!res)
+	{
+		double dist = t1->Distance2D(t2);
+		for (unsigned i = 0; i < portals.Size(); i++)
+		{
+			portals[i].Frac += 1 / dist;
+			s.init(t1, t2, NULL, &portals[i], flags);
+			if (s.P_SightPathTraverse())
+			{
+				res = true;
+				break;
+			}
+		}
+	}
+
+	if (record != nullptr)
+	{
+		// Collect the sectors whose planes and 3D floors the result depends on.
+		auto addsector = [=](sector_t *sector)
+		{
+			if (sector != nullptr && record->Sectors.Find(sector) == record->Sectors.Size())
+			{
+				record->Sectors.Push(sector);
+				record->SectorSignatures.Push(SectorSightSignature(sector));
+			}
+		};
+		addsector(sec);
+		addsector(t2->Sector);
+		for (auto &dep : record->Lines)
+		{
+			addsector(dep.Line->frontsector);
+			addsector(dep.Line->backsector);
+		}
+		record->Result = res;
+		record->Valid = true;
+	}
+	return res;
+}
+
+//==========================================================================
+//
+// Fills in a cache entry for the given pair
+//
+//==========================================================================
+
+static void P_FillSightCacheEntry(FSightCacheEntry *entry, AActor *t1, AActor *t2, int flags, int cacheflags)
+{
+	entry->Looker = t1;
+	entry->Target = t2;
+	entry->Flags = cacheflags;
+	entry->LookerPos = t1->Pos();
+	entry->TargetPos = t2->Pos();
+	entry->LookerHeight = t1->Height;
+	entry->TargetHeight = t2->Height;
+	entry->LookerSector = t1->Sector;
+	entry->TargetSector = t2->Sector;
+	entry->Valid = false;
+	entry->Lines.Clear();
+	entry->Sectors.Clear();
+	entry->SectorSignatures.Clear();
+	P_SightTraverse(t1, t2, flags, entry);
+}
+
+static FSightCacheEntry *P_GetSightCacheEntry(AActor *t1, AActor *t2, int cacheflags)
+{
+	FSightCacheEntry *&entry = SightCache[SightCacheKey(t1, t2, cacheflags)];
+	if (entry == nullptr)
+	{
+		entry = new FSightCacheEntry;
+		entry->Valid = false;
+	}
+	entry->LastUsed = SightCacheTic;
+	return entry;
+}
+
+//==========================================================================
+//
+// With pvs_verify on, every pair the PVS rejects still gets the full
+// trace, and the ones that turn out visible are reported.
+//
+//==========================================================================
+
+static bool PVSCheckActors(AActor *t1, AActor *t2, int flags)
+{
+	if (PVS.CheckActors(t1, t2))
+	{
+		return true;
+	}
+	if (pvs_verify && P_SightTraverse(t1, t2, flags, nullptr))
+	{
+		Printf("PVS rejected a visible pair: %s at (%.2f, %.2f, %.2f) and %s at (%.2f, %.2f, %.2f)\n",
+			t1->GetClass()->TypeName.GetChars(), t1->X(), t1->Y(), t1->Z(),
+			t2->GetClass()->TypeName.GetChars(), t2->X(), t2->Y(), t2->Z());
+	}
+	return false;
+}
+
 /*
 =====================
 =
@@ -903,35 +1232,30 @@ sightcounts[0]++;
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
 
-	validcount++;
-	portals.Clear();
+	if (!PVSCheckActors(t1, t2, flags))
 	{
-		sector_t *sec;
-		double lookheight = t1->Z() + t1->Height*0.75;
-		t1->GetPortalTransition(lookheight, &sec);
-
-		double bottomslope = t2->Z() - lookheight;
-		double topslope = bottomslope + t2->Height;
-		SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
-
+		res = false;
+		goto done;
+	}
 
-		SightCheck s;
-		s.init(t1, t2, sec, &task, flags);
-		res = s.P_SightPathTraverse ();
-		if (!res)
+	if (SightCacheUsable())
+	{
+		int cacheflags = SightCacheFlags(flags);
+		FSightCacheEntry *entry = P_GetSightCacheEntry(t1, t2, cacheflags);
+		if (SightCacheValid(entry, t1, t2, cacheflags))
 		{
-			double dist = t1->Distance2D(t2);
-			for (unsigned i = 0; i < portals.Size(); i++)
-			{
-				portals[i].Frac += 1 / dist;
-				s.init(t1, t2, NULL, &portals[i], flags);
-				if (s.P_SightPathTraverse())
-				{
-					res = true;
-					break;
-				}
-			}
+			SightCacheHits++;
+		}
+		else
+		{
+			SightCacheMisses++;
+			P_FillSightCacheEntry(entry, t1, t2, flags, cacheflags);
 		}
+		res = entry->Result;
+	}
+	else
+	{
+		res = P_SightTraverse(t1, t2, flags, nullptr);
 	}
 
 done:
@@ -939,6 +1263,25 @@ done:
 	return res;
 }
 
+//==========================================================================
+//
+// P_SightPossible
+//
+// Cheap early-out for callers that do more work before P_CheckSight.
+// Only returns false if the PVS rules out the pair and P_CheckSight would
+// not have called the random number generator for it.
+//
+//==========================================================================
+
+bool P_SightPossible(AActor *t1, AActor *t2, int flags)
+{
+	if ((flags & SF_IGNOREVISIBILITY) == 0 && ((t2->renderflags & RF_INVISIBLE) || !t2->RenderStyle.IsVisible(t2->Alpha)))
+	{
+		return true;
+	}
+	return PVSCheckActors(t1, t2, flags);
+}
+
 DEFINE_ACTION_FUNCTION(AActor, CheckSight)
 {
 	PARAM_SELF_PROLOGUE(AActor);
@@ -947,12 +1290,154 @@ DEFINE_ACTION_FUNCTION(AActor, CheckSight)
 	ACTION_RETURN_BOOL(P_CheckSight(self, target, flags));
 }
 
+//==========================================================================
+//
+// P_PrefetchSight
+//
+// Called once per tic before the thinkers run. Every monster that enters
+// a look or chase state this tic will check sight to its target, so these
+// checks get computed up front on the job system. The thinkers then find
+// the results in the sight cache. The reject table, visibility and water
+// boundary checks still run when P_CheckSight is called, so the outcome
+// and the random number sequence are unaffected.
+//
+//==========================================================================
+
+static bool WillCheckSightThisTic(AActor *mo)
+{
+	static const char *const names[] = { "A_Look", "A_Look2", "A_LookEx", "A_Chase", "A_FastChase", "A_VileChase", "A_ExtChase" };
+	static VMFunction *funcs[countof(names)];
+
+	if (funcs[0] == nullptr)
+	{
+		for (unsigned i = 0; i < countof(names); i++) funcs[i] = FindVMFunction(RUNTIME_CLASS(AActor), names[i]);
+	}
+
+	// Only a state change calls an action function, and that happens when the current state runs out.
+	if (mo->tics != 1) return false;
+	FState *next = mo->state->GetNextState();
+	if (next == nullptr || next->ActionFunc == nullptr) return false;
+	for (auto func : funcs)
+	{
+		if (func != nullptr && next->ActionFunc == func) return true;
+	}
+	return false;
+}
+
+void P_PrefetchSight()
+{
+	static TArray<FSightCacheEntry *> entries;
+	static TArray<AActor *> lookers;
+
+	if (!SightCacheUsable())
+	{
+		return;
+	}
+
+	SightCycles.Clock();
+
+	int cacheflags = SightCacheFlags(SF_SEEPASTBLOCKEVERYTHING);
+	entries.Clear();
+	lookers.Clear();
+
+	TThinkerIterator<AActor> it;
+	AActor *mo;
+	while ((mo = it.Next()) != nullptr)
+	{
+		if (!(mo->flags & MF_COUNTKILL) && !(mo->flags3 & MF3_ISMONSTER)) continue;
+		if (mo->health <= 0 || mo->target == nullptr || mo->target->health <= 0) continue;
+		if (!WillCheckSightThisTic(mo)) continue;
+
+		AActor *target = mo->target;
+		if (level.rejectmatrix.Size() > 0)
+		{
+			int pnum = int(mo->Sector->Index()) * level.sectors.Size() + int(target->Sector->Index());
+			if (level.rejectmatrix[pnum >> 3] & (1 << (pnum & 7))) continue;
+		}
+
+		// Entries are created here because the cache's map may not be modified by the jobs.
+		// Every looker is visited once, so no entry can be added twice.
+		FSightCacheEntry *entry = P_GetSightCacheEntry(mo, target, cacheflags);
+		if (!SightCacheValid(entry, mo, target, cacheflags))
+		{
+			entries.Push(entry);
+			lookers.Push(mo);
+		}
+	}
+
+	auto fill = [&](int i)
+	{
+		P_FillSightCacheEntry(entries[i], lookers[i], lookers[i]->target, SF_SEEPASTBLOCKEVERYTHING, cacheflags);
+	};
+	if (entries.Size() >= 32)
+	{
+		FJobSystem::Instance()->ParallelFor(0, entries.Size(), fill, 8);
+	}
+	else
+	{
+		for (unsigned i = 0; i < entries.Size(); i++) fill(i);
+	}
+	SightCacheBatched += entries.Size();
+
+	SightCycles.Unclock();
+}
+
+//==========================================================================
+//
+// The cache holds pointers to actors, lines and sectors, so it must be
+// emptied before any of them go away with the level.
+//
+//==========================================================================
+
+void P_ClearSightCache()
+{
+	TMap<uint64_t, FSightCacheEntry *>::Iterator it(SightCache);
+	TMap<uint64_t, FSightCacheEntry *>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		delete pair->Value;
+	}
+	SightCache.Clear();
+	SightCacheLimit = MaxSightCacheEntries;
+}
+
+//==========================================================================
+//
+// Drops the entries that were not looked up during the last tic. That
+// includes all entries for actors that were destroyed. If most entries
+// are still in use, the limit grows so that the next pass does not come
+// until the cache has doubled again.
+//
+//==========================================================================
+
+static void P_TrimSightCache()
+{
+	TArray<uint64_t> stale;
+	TMap<uint64_t, FSightCacheEntry *>::Iterator it(SightCache);
+	TMap<uint64_t, FSightCacheEntry *>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		if (SightCacheTic - pair->Value->LastUsed > 1)
+		{
+			stale.Push(pair->Key);
+			delete pair->Value;
+		}
+	}
+	for (auto key : stale)
+	{
+		SightCache.Remove(key);
+	}
+	SightCacheLimit = MAX(MaxSightCacheEntries, SightCache.CountUsed() * 2);
+}
+
 ADD_STAT (sight)
 {
 	FString out;
-	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
+	int lookups = SightCacheHits + SightCacheMisses;
+	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d, cache %d%% of %d, %d batched\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5],
+		lookups > 0 ? SightCacheHits * 100 / lookups : 0, lookups, SightCacheBatched);
 	return out;
 }
 
@@ -968,4 +1453,15 @@ void P_ResetSightCounters (bool full)
 	}
 	SightCycles.Reset();
 	memset (sightcounts, 0, sizeof(sightcounts));
+	SightCacheHits = SightCacheMisses = SightCacheBatched = 0;
+
+	if (full)
+	{
+		P_ClearSightCache();
+	}
+	else if (SightCache.CountUsed() > SightCacheLimit)
+	{
+		P_TrimSightCache();
+	}
+	SightCacheTic++;
 }
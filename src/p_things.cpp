@@ -427,11 +427,11 @@ bool P_Thing_Raise(AActor *thing, AActor *raiser, int nocheck)
 
 	thing->flags |= MF_SOLID;
 	thing->Height = info->Height;	// [RH] Use real height
-	thing->radius = info->radius;	// [RH] Use real radius
+	thing->SetRadius(info->radius);	// [RH] Use real radius
 	if (!nocheck && !P_CheckPosition (thing, thing->Pos()))
 	{
 		thing->flags = oldflags;
-		thing->radius = oldradius;
+		thing->SetRadius(oldradius);
 		thing->Height = oldheight;
 		return false;
 	}
@@ -468,13 +468,13 @@ bool P_Thing_CanRaise(AActor *thing)
 
 	thing->flags |= MF_SOLID;
 	thing->Height = info->Height;
-	thing->radius = info->radius;
+	thing->SetRadius(info->radius);
 
 	bool check = P_CheckPosition (thing, thing->Pos());
 
 	// Restore checked properties
 	thing->flags = oldflags;
-	thing->radius = oldradius;
+	thing->SetRadius(oldradius);
 	thing->Height = oldheight;
 
 	if (!check)
@@ -40,9 +40,12 @@
 #include "p_spec.h"
 #include "g_levellocals.h"
 #include "events.h"
+#include "p_navigation.h"
 
 extern gamestate_t wipegamestate;
 
+cycle_t TickerCycles;
+
 //==========================================================================
 //
 // P_CheckTickerPaused
@@ -78,6 +81,7 @@ void P_Ticker (void)
 {
 	int i;
 
+	TickerCycles.Reset();
 	interpolator.UpdateInterpolations ();
 	r_NoInterpolate = true;
 
@@ -92,6 +96,7 @@ void P_Ticker (void)
 	if (paused || P_CheckTickerPaused())
 		return;
 
+	TickerCycles.Clock();
 	DPSprite::NewTick();
 
 	// [RH] Frozen mode is only changed every 4 tics, to make it work with A_Tracer().
@@ -117,6 +122,7 @@ void P_Ticker (void)
 		S_ResumeSound (false);
 
 	P_ResetSightCounters (false);
+	P_ResetSecnodeCounters ();
 	R_ClearInterpolationPath();
 
 	// Since things will be moving, it's okay to interpolate them in the renderer.
@@ -133,6 +139,8 @@ void P_Ticker (void)
 	E_WorldTick();
 	StatusBar->CallTick ();		// [RH] moved this here
 	level.Tick ();			// [RH] let the level tick
+	Navigation.Tick ();
+	P_PrefetchSight ();
 	DThinker::RunThinkers ();
 
 	//if added by MC: Freeze mode.
@@ -146,4 +154,5 @@ void P_Ticker (void)
 	level.time++;
 	level.maptime++;
 	level.totaltime++;
+	TickerCycles.Unclock();
 }
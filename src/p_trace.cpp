@@ -42,6 +42,15 @@
 #include "p_spec.h"
 #include "g_levellocals.h"
 #include "p_terrain.h"
+#include "p_blockmap.h"
+#include "po_man.h"
+#include "portal.h"
+#include "c_cvars.h"
+#include "jobsystem.h"
+
+// Traces the pellets of spread attacks as one batch. Off until -benchmark
+// shows it beating the serial traces.
+CVAR(Bool, trace_batch, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
 //==========================================================================
 //
@@ -74,10 +83,18 @@ struct FTraceInfo
 	sector_t DummySector[2];	
 	int sectorsel;		
 
+	// Set for batched traces, which must not change anything
+	FTraceBatch::FRay *Ray;
+
+	void Init(const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
+		ActorFlags actorMask, uint32_t wallMask, AActor *ignore, FTraceResults &res, uint32_t flags,
+		ETraceStatus(*callback)(FTraceResults &res, void *), void *callbackdata);
 	void Setup3DFloors();
+	void ActivateLine(line_t *line, int side, int activationType);
 	bool LineCheck(intercept_t *in, double dist, DVector3 hit);
 	bool ThingCheck(intercept_t *in, double dist, DVector3 hit);
 	bool TraceTraverse (int ptflags);
+	bool TraverseIntercepts(FPathTraverse &it);
 	bool CheckPlane(const secplane_t &plane);
 	void EnterLinePortal(FPathTraverse &pt, intercept_t *in);
 	void EnterSectorPortal(FPathTraverse &pt, int position, double frac, sector_t *entersec);
@@ -143,12 +160,102 @@ static bool isLiquid(F3DFloor *ff)
 	return Terrains[terrain].IsLiquid && Terrains[terrain].Splash != -1;
 }
 
+//==========================================================================
+//
+// Path traverser for batched traces. Lines are marked as checked in a
+// per-thread array instead of their validcount, so several of these can
+// run at the same time. The map must not have any polyobjects.
+//
+//==========================================================================
+
+class FTraceBatchTraverse : public FPathTraverse
+{
+	static thread_local TArray<uint32_t> LineStamps;
+	static thread_local uint32_t LineStamp;
+	float FilterBox[4];
+
+	void StartLineChecks();
+	void AddLineIntercepts(int bx, int by);
+
+public:
+	FTraceBatchTraverse(double x1, double y1, double x2, double y2, int flags, double startfrac)
+	{
+		init(x1, y1, x2, y2, flags, startfrac);
+	}
+};
+
+thread_local TArray<uint32_t> FTraceBatchTraverse::LineStamps;
+thread_local uint32_t FTraceBatchTraverse::LineStamp;
+
+void FTraceBatchTraverse::StartLineChecks()
+{
+	if (LineStamps.Size() != level.lines.Size() || ++LineStamp == 0)
+	{
+		LineStamps.Resize(level.lines.Size());
+		for (auto &stamp : LineStamps) stamp = 0;
+		LineStamp = 1;
+	}
+	// Same filter as FBlockLinesIterator::SetBoxFilter
+	FilterBox[BOXLEFT] = FBlockmap::RoundDown(TraceBox.Left());
+	FilterBox[BOXBOTTOM] = FBlockmap::RoundDown(TraceBox.Bottom());
+	FilterBox[BOXRIGHT] = FBlockmap::RoundUp(TraceBox.Right());
+	FilterBox[BOXTOP] = FBlockmap::RoundUp(TraceBox.Top());
+}
+
+void FTraceBatchTraverse::AddLineIntercepts(int bx, int by)
+{
+	const FBlockmap &bmap = level.blockmap;
+	if (!bmap.isValidBlock(bx, by)) return;
+
+	int offset = by * bmap.bmapwidth + bx;
+	for (int pos = bmap.FlatStart[offset], end = bmap.FlatStart[offset + 1]; pos < end; pos++)
+	{
+		int lineindex = bmap.FlatLines[pos];
+		if (lineindex < 0) continue;	// padding
+
+		if (FilterBox[BOXLEFT] >= bmap.FlatRight[pos] || FilterBox[BOXRIGHT] <= bmap.FlatLeft[pos] ||
+			FilterBox[BOXTOP] <= bmap.FlatBottom[pos] || FilterBox[BOXBOTTOM] >= bmap.FlatTop[pos])
+		{
+			continue;
+		}
+		if (LineStamps[lineindex] == LineStamp) continue;
+		LineStamps[lineindex] = LineStamp;
+		AddLineIntercept(&level.lines[lineindex]);
+	}
+}
+
 //==========================================================================
 //
 // Trace entry point
 //
 //==========================================================================
 
+void FTraceInfo::Init(const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
+	ActorFlags actorMask, uint32_t wallMask, AActor *ignore, FTraceResults &res, uint32_t flags,
+	ETraceStatus(*callback)(FTraceResults &res, void *), void *callbackdata)
+{
+	Start = start;
+	GetPortalTransition(Start, sector);
+	ptflags = actorMask ? PT_ADDLINES|PT_ADDTHINGS|PT_COMPATIBLE : PT_ADDLINES;
+	Vec = direction;
+	ActorMask = actorMask;
+	WallMask = wallMask;
+	IgnoreThis = ignore;
+	CurSector = sector;
+	MaxDist = maxDist;
+	EnterDist = 0;
+	TraceCallback = callback;
+	TraceCallbackData = callbackdata;
+	TraceFlags = flags;
+	Results = &res;
+	inshootthrough = true;
+	sectorsel=0;
+	startfrac = 0;
+	limitz = Start.Z;
+	Ray = nullptr;
+	memset(&res, 0, sizeof(res));
+}
+
 bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, double maxDist,
 	ActorFlags actorMask, uint32_t wallMask, AActor *ignore, FTraceResults &res, uint32_t flags,
 	ETraceStatus(*callback)(FTraceResults &res, void *), void *callbackdata)
@@ -159,25 +266,7 @@ bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, d
 	memset(&tempResult, 0, sizeof(tempResult));
 	tempResult.Fraction = tempResult.Distance = NO_VALUE;
 
-	inf.Start = start;
-	GetPortalTransition(inf.Start, sector);
-	inf.ptflags = actorMask ? PT_ADDLINES|PT_ADDTHINGS|PT_COMPATIBLE : PT_ADDLINES;
-	inf.Vec = direction;
-	inf.ActorMask = actorMask;
-	inf.WallMask = wallMask;
-	inf.IgnoreThis = ignore;
-	inf.CurSector = sector;
-	inf.MaxDist = maxDist;
-	inf.EnterDist = 0;
-	inf.TraceCallback = callback;
-	inf.TraceCallbackData = callbackdata;
-	inf.TraceFlags = flags;
-	inf.Results = &res;
-	inf.inshootthrough = true;
-	inf.sectorsel=0;
-	inf.startfrac = 0;
-	inf.limitz = inf.Start.Z;
-	memset(&res, 0, sizeof(res));
+	inf.Init(start, sector, direction, maxDist, actorMask, wallMask, ignore, res, flags, callback, callbackdata);
 
 	if ((flags & TRACE_ReportPortals) && callback != NULL)
 	{
@@ -375,6 +464,24 @@ void FTraceInfo::Setup3DFloors()
 }
 
 
+//==========================================================================
+//
+// Batched traces only note that the ray has to be traced again
+//
+//==========================================================================
+
+void FTraceInfo::ActivateLine(line_t *line, int side, int activationType)
+{
+	if (Ray == nullptr)
+	{
+		P_ActivateLine(line, IgnoreThis, side, activationType);
+	}
+	else if (line->special != 0 || line->locknumber > 0)
+	{
+		Ray->Valid = false;
+	}
+}
+
 //==========================================================================
 //
 // Processes one line intercept
@@ -425,11 +532,11 @@ bool FTraceInfo::LineCheck(intercept_t *in, double dist, DVector3 hit)
 			// We must check special activation here because the code below is never reached.
 			if (TraceFlags & TRACE_PCross)
 			{
-				P_ActivateLine(in->d.line, IgnoreThis, lineside, SPAC_PCross);
+				ActivateLine(in->d.line, lineside, SPAC_PCross);
 			}
 			if (TraceFlags & TRACE_Impact)
 			{
-				P_ActivateLine(in->d.line, IgnoreThis, lineside, SPAC_Impact);
+				ActivateLine(in->d.line, lineside, SPAC_Impact);
 			}
 			return true;
 		}
@@ -483,7 +590,7 @@ bool FTraceInfo::LineCheck(intercept_t *in, double dist, DVector3 hit)
 			hit.Z >= bc ? TIER_Upper : TIER_Middle;
 		if (TraceFlags & TRACE_Impact)
 		{
-			P_ActivateLine(in->d.line, IgnoreThis, lineside, SPAC_Impact);
+			ActivateLine(in->d.line, lineside, SPAC_Impact);
 		}
 	}
 	else
@@ -557,7 +664,7 @@ bool FTraceInfo::LineCheck(intercept_t *in, double dist, DVector3 hit)
 						Results->ffloor = rover;
 						if ((TraceFlags & TRACE_Impact) && in->d.line->special)
 						{
-							P_ActivateLine(in->d.line, IgnoreThis, lineside, SPAC_Impact);
+							ActivateLine(in->d.line, lineside, SPAC_Impact);
 						}
 						goto cont;
 					}
@@ -568,12 +675,12 @@ bool FTraceInfo::LineCheck(intercept_t *in, double dist, DVector3 hit)
 		Results->HitType = TRACE_HitNone;
 		if (TraceFlags & TRACE_PCross)
 		{
-			P_ActivateLine(in->d.line, IgnoreThis, lineside, SPAC_PCross);
+			ActivateLine(in->d.line, lineside, SPAC_PCross);
 		}
 		if (TraceFlags & TRACE_Impact)
 		{ // This is incorrect for "impact", but Hexen did this, so
 		  // we need to as well, for compatibility
-			P_ActivateLine(in->d.line, IgnoreThis, lineside, SPAC_Impact);
+			ActivateLine(in->d.line, lineside, SPAC_Impact);
 		}
 	}
 cont:
@@ -607,7 +714,7 @@ cont:
 			}
 			if (Results->HitType == TRACE_HitWall && TraceFlags & TRACE_Impact)
 			{
-				P_ActivateLine(in->d.line, IgnoreThis, lineside, SPAC_Impact);
+				ActivateLine(in->d.line, lineside, SPAC_Impact);
 			}
 		}
 
@@ -764,12 +871,28 @@ bool FTraceInfo::TraceTraverse (int ptflags)
 	// Do a 3D floor check in the starting sector
 	Setup3DFloors();
 
+	if (Ray != nullptr)
+	{
+		FTraceBatchTraverse it(Start.X, Start.Y, Vec.X * MaxDist, Vec.Y * MaxDist, ptflags | PT_DELTA, startfrac);
+		return TraverseIntercepts(it);
+	}
 	FPathTraverse it(Start.X, Start.Y, Vec.X * MaxDist, Vec.Y * MaxDist, ptflags | PT_DELTA, startfrac);
+	return TraverseIntercepts(it);
+}
+
+bool FTraceInfo::TraverseIntercepts(FPathTraverse &it)
+{
 	intercept_t *in;
 	int lastsplashsector = -1;
 
 	while ((in = it.Next()))
 	{
+		if (Ray != nullptr)
+		{
+			if (in->isaline) Ray->AddLine(in->d.line);
+			else Ray->AddActor(in->d.thing);
+		}
+
 		// Deal with splashes in 3D floors (but only run once per sector, not each iteration - and stop if something was found.)
 		if (Results->Crossed3DWater == NULL && lastsplashsector != CurSector->sectornum)
 		{
@@ -948,3 +1071,205 @@ static bool EditTraceResult (uint32_t flags, FTraceResults &res)
 	}
 	return true;
 }
+
+//==========================================================================
+//
+// FTraceBatch
+//
+//==========================================================================
+
+bool FTraceBatch::IsUsable()
+{
+	return trace_batch && po_NumPolyobjs == 0 && linePortals.Size() == 0 &&
+		!PortalBlockmap.containsLines && !PortalBlockmap.hasLinkedSectorPortals;
+}
+
+void FTraceBatch::Clear()
+{
+	Rays.Clear();
+	NextRay = 0;
+}
+
+void FTraceBatch::AddRay(const DVector3 &direction)
+{
+	Rays[Rays.Reserve(1)].Direction = direction;
+}
+
+//==========================================================================
+//
+// Traces all rays. The playsim is not touched until all of them are done,
+// so the workers only ever read from it.
+//
+//==========================================================================
+
+void FTraceBatch::Run(const DVector3 &start, sector_t *sector, double maxDist, ActorFlags actorMask, uint32_t wallMask,
+	AActor *ignore, uint32_t traceFlags, ETraceStatus(*callback)(FTraceResults &res, void *), void *callbackdata)
+{
+	assert(IsUsable() && !(traceFlags & TRACE_ReportPortals));
+
+	Start = start;
+	StartSector = sector;
+	LinkCount = FBlockNode::LinkCount;
+	NextRay = 0;
+
+	FJobSystem::Instance()->ParallelFor(0, Rays.Size(), [&](int index)
+	{
+		FRay &ray = Rays[index];
+		FTraceInfo inf;
+
+		ray.Valid = true;
+		ray.Actors.Clear();
+		ray.Lines.Clear();
+		ray.Sectors.Clear();
+		ray.AddSector(sector);
+
+		inf.Init(start, sector, ray.Direction, maxDist, actorMask, wallMask, ignore, ray.Results, traceFlags, callback, callbackdata);
+		inf.Ray = &ray;
+		ray.Hit = inf.TraceTraverse(inf.ptflags) && (traceFlags ? EditTraceResult(traceFlags, ray.Results) : true);
+	}, 1);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FTraceBatch::Take(const DVector3 &start, sector_t *sector, const DVector3 &direction, FTraceResults &res, bool &hit)
+{
+	if (NextRay >= Rays.Size()) return false;
+
+	const FRay &ray = Rays[NextRay++];
+	if (!ray.Valid || start != Start || sector != StartSector || direction != ray.Direction ||
+		LinkCount != FBlockNode::LinkCount || !ray.IsCurrent())
+	{
+		return false;
+	}
+	res = ray.Results;
+	hit = ray.Hit;
+	return true;
+}
+
+//==========================================================================
+//
+// What a ray depends on. Actors that enter or leave a block change
+// FBlockNode::LinkCount, so only the ones the ray met need to be kept.
+//
+//==========================================================================
+
+void FTraceBatch::FRay::AddActor(AActor *actor)
+{
+	FActorState &state = Actors[Actors.Reserve(1)];
+	state.Actor = actor;
+	state.Pos = actor->Pos();
+	state.Radius = actor->radius;
+	state.Height = actor->Height;
+	state.Flags = actor->flags;
+	state.Flags3 = actor->flags3;
+	state.Flags4 = actor->flags4;
+}
+
+void FTraceBatch::FRay::AddLine(line_t *line)
+{
+	FLineState &state = Lines[Lines.Reserve(1)];
+	state.Line = line;
+	state.Flags = line->flags;
+	state.Special = line->special;
+	state.LockNumber = line->locknumber;
+	AddSector(line->frontsector);
+	if (line->backsector != nullptr) AddSector(line->backsector);
+}
+
+void FTraceBatch::FRay::AddSector(sector_t *sector)
+{
+	for (auto &state : Sectors)
+	{
+		if (state.Sector == sector) return;
+	}
+	FSectorState &state = Sectors[Sectors.Reserve(1)];
+	state.Sector = sector;
+	state.Signature = SectorSignature(sector);
+}
+
+bool FTraceBatch::FRay::IsCurrent() const
+{
+	for (auto &state : Actors)
+	{
+		AActor *actor = state.Actor;
+		if (actor->Pos() != state.Pos || actor->radius != state.Radius || actor->Height != state.Height ||
+			actor->flags != state.Flags || actor->flags3 != state.Flags3 || actor->flags4 != state.Flags4)
+		{
+			return false;
+		}
+	}
+	for (auto &state : Lines)
+	{
+		line_t *line = state.Line;
+		if (line->flags != state.Flags || line->special != state.Special || line->locknumber != state.LockNumber)
+		{
+			return false;
+		}
+	}
+	for (auto &state : Sectors)
+	{
+		if (SectorSignature(state.Sector) != state.Signature)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// Everything about a sector a trace looks at
+//
+//==========================================================================
+
+static inline uint64_t TraceMix(uint64_t h, uint64_t v)
+{
+	h ^= v;
+	h *= 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 29);
+}
+
+static inline uint64_t TraceMix(uint64_t h, double v)
+{
+	uint64_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	return TraceMix(h, bits);
+}
+
+static uint64_t TraceMixPlane(uint64_t h, const secplane_t &plane)
+{
+	const DVector3 &n = plane.Normal();
+	h = TraceMix(h, n.X);
+	h = TraceMix(h, n.Y);
+	h = TraceMix(h, n.Z);
+	return TraceMix(h, plane.fD());
+}
+
+uint64_t FTraceBatch::SectorSignature(const sector_t *sector)
+{
+	uint64_t h = TraceMixPlane(0, sector->floorplane);
+	h = TraceMixPlane(h, sector->ceilingplane);
+	h = TraceMix(h, (uint64_t)sector->GetTexture(sector_t::floor).GetIndex());
+	h = TraceMix(h, (uint64_t)sector->GetTexture(sector_t::ceiling).GetIndex());
+	h = TraceMix(h, (uint64_t)(uintptr_t)sector->heightsec);
+	if (sector->heightsec != nullptr)
+	{
+		h = TraceMix(h, (uint64_t)sector->heightsec->MoreFlags);
+		h = TraceMixPlane(h, sector->heightsec->floorplane);
+	}
+	for (auto rover : sector->e->XFloor.ffloors)
+	{
+		h = TraceMix(h, (uint64_t)rover->flags);
+		h = TraceMixPlane(h, *rover->top.plane);
+		h = TraceMixPlane(h, *rover->bottom.plane);
+		h = TraceMix(h, (uint64_t)rover->top.texture->GetIndex());
+		h = TraceMix(h, (uint64_t)rover->bottom.texture->GetIndex());
+		h = TraceMix(h, (uint64_t)rover->model->GetTexture(sector_t::floor).GetIndex());
+		h = TraceMix(h, (uint64_t)rover->model->GetTexture(sector_t::ceiling).GetIndex());
+	}
+	return h;
+}
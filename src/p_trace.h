@@ -112,4 +112,86 @@ bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, d
 	ActorFlags ActorMask, uint32_t WallMask, AActor *ignore, FTraceResults &res, uint32_t traceFlags = 0,
 	ETraceStatus(*callback)(FTraceResults &res, void *) = NULL, void *callbackdata = NULL);
 
+//==========================================================================
+//
+// Traces many rays from one start position at once, spread across the
+// job system's threads. Nothing gets activated while doing so: a ray that
+// would have triggered a line special has to be traced again.
+//
+// The results are picked up in the order the rays were added. Every ray
+// remembers the lines, sectors and actors it passed, so that a result is
+// only handed out if Trace would still return the same.
+//
+//==========================================================================
+
+class FTraceBatch
+{
+public:
+	// Map features the batched traces cannot handle
+	static bool IsUsable();
+
+	void Clear();
+	void AddRay(const DVector3 &direction);
+	unsigned Size() const { return Rays.Size(); }
+
+	// The callback is called from worker threads and must not change anything.
+	void Run(const DVector3 &start, sector_t *sector, double maxDist, ActorFlags actorMask, uint32_t wallMask,
+		AActor *ignore, uint32_t traceFlags = 0, ETraceStatus(*callback)(FTraceResults &res, void *) = NULL,
+		void *callbackdata = NULL);
+
+	// Returns false if the next ray's result is missing, was traced with
+	// different input or may be out of date. The ray is used up either way.
+	bool Take(const DVector3 &start, sector_t *sector, const DVector3 &direction, FTraceResults &res, bool &hit);
+
+	struct FActorState
+	{
+		AActor *Actor;
+		DVector3 Pos;
+		double Radius;
+		double Height;
+		ActorFlags Flags;
+		ActorFlags3 Flags3;
+		ActorFlags4 Flags4;
+	};
+
+	struct FLineState
+	{
+		line_t *Line;
+		uint32_t Flags;
+		int Special;
+		int LockNumber;
+	};
+
+	struct FSectorState
+	{
+		sector_t *Sector;
+		uint64_t Signature;
+	};
+
+	struct FRay
+	{
+		DVector3 Direction;
+		FTraceResults Results;
+		bool Hit;
+		bool Valid;		// false if the ray would have activated something
+		TArray<FActorState> Actors;
+		TArray<FLineState> Lines;
+		TArray<FSectorState> Sectors;
+
+		void AddActor(AActor *actor);
+		void AddLine(line_t *line);
+		void AddSector(sector_t *sector);
+		bool IsCurrent() const;
+	};
+
+	static uint64_t SectorSignature(const sector_t *sector);
+
+private:
+	TArray<FRay> Rays;
+	DVector3 Start;
+	sector_t *StartSector = nullptr;
+	uint32_t LinkCount = 0;
+	unsigned NextRay = 0;
+};
+
 #endif //__P_TRACE_H__
@@ -768,7 +768,7 @@ bool player_t::Resurrect()
 	viewheight = ((APlayerPawn *)mo->GetDefault())->ViewHeight;
 	mo->renderflags &= ~RF_INVISIBLE;
 	mo->Height = mo->GetDefault()->Height;
-	mo->radius = mo->GetDefault()->radius;
+	mo->SetRadius(mo->GetDefault()->radius);
 	mo->special1 = 0;	// required for the Hexen fighter's fist attack. 
 								// This gets set by AActor::Die as flag for the wimpy death and must be reset here.
 	mo->SetState(mo->SpawnState);
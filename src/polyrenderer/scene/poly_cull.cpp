@@ -25,13 +25,15 @@
 #include "doomdef.h"
 #include "sbar.h"
 #include "r_data/r_translate.h"
+#include "p_pvs.h"
 #include "poly_cull.h"
 #include "polyrenderer/poly_renderer.h"
 
-void PolyCull::CullScene(const TriMatrix &worldToClip, const PolyClipPlane &portalClipPlane)
+void PolyCull::CullScene(const TriMatrix &worldToClip, const PolyClipPlane &portalClipPlane, bool usePVS)
 {
 	PvsSectors.clear();
 	PortalClipPlane = portalClipPlane;
+	PVSRow = usePVS ? PVS.GetVisibleRow(PolyRenderer::Instance()->Viewpoint.Pos) : nullptr;
 
 	// Cull front to back
 	FirstSkyHeight = true;
@@ -65,7 +67,8 @@ void PolyCull::CullNode(void *node)
 	}
 
 	subsector_t *sub = (subsector_t *)((uint8_t *)node - 1);
-	CullSubsector(sub);
+	if (PVSRow == nullptr || FPotentiallyVisibleSet::IsVisible(PVSRow, sub))
+		CullSubsector(sub);
 }
 
 void PolyCull::CullSubsector(subsector_t *sub)
@@ -28,7 +28,7 @@ class PolyCull
 {
 public:
 	void ClearSolidSegments();
-	void CullScene(const TriMatrix &worldToClip, const PolyClipPlane &portalClipPlane);
+	void CullScene(const TriMatrix &worldToClip, const PolyClipPlane &portalClipPlane, bool usePVS);
 
 	bool GetAnglesForLine(double x1, double y1, double x2, double y2, angle_t &angle1, angle_t &angle2) const;
 	void MarkSegmentCulled(angle_t angle1, angle_t angle2);
@@ -63,6 +63,7 @@ private:
 	bool FirstSkyHeight = true;
 
 	PolyClipPlane PortalClipPlane;
+	const uint32_t *PVSRow = nullptr;
 
 	static angle_t AngleToPseudo(angle_t ang);
 };
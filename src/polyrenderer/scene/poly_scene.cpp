@@ -73,7 +73,7 @@ void RenderPolyScene::Render(int portalDepth)
 	if (!PortalSegmentsAdded)
 		Cull.ClearSolidSegments();
 	Cull.MarkViewFrustum();
-	Cull.CullScene(WorldToClip, PortalPlane);
+	Cull.CullScene(WorldToClip, PortalPlane, portalDepth == 0);	// portal views may start outside of the map
 	Cull.ClearSolidSegments();
 	RenderSectors();
 	RenderPortals(portalDepth);
@@ -1272,7 +1272,7 @@ bool P_CollectConnectedGroups(int startgroup, const DVector3 &position, double u
 			{
 				DVector2 disp = Displacements.getOffset(startgroup, thisgroup & ~FPortalGroupArray::FLAT);
 				FBoundingBox box(position.X + disp.X, position.Y + disp.Y, checkradius);
-				FBlockLinesIterator it(box);
+				FBlockLinesIterator it(box, true);
 				line_t *ld;
 				while ((ld = it.Next()))
 				{
@@ -43,6 +43,7 @@
 #include "stats.h"
 #include "version.h"
 #include "c_console.h"
+#include "m_argv.h"
 
 #include "sdlglvideo.h"
 #include "sdlvideo.h"
@@ -405,9 +406,11 @@ SDLGLFB::SDLGLFB (void *, int width, int height, int, int, bool fullscreen, bool
 
 	FString caption;
 	caption.Format(GAMESIG " %s (%s)", GetVersionString(), GetGitTime());
+	// Headless benchmarks render offscreen, so the window is never shown
+	Uint32 hidden = Args->CheckParm("-benchmark") ? SDL_WINDOW_HIDDEN : 0;
 	Screen = SDL_CreateWindow (caption,
 		SDL_WINDOWPOS_UNDEFINED_DISPLAY(vid_adapter), SDL_WINDOWPOS_UNDEFINED_DISPLAY(vid_adapter),
-		width, height, (fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0)|SDL_WINDOW_OPENGL);
+		width, height, (fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0)|SDL_WINDOW_OPENGL|hidden);
 
 	if (Screen == NULL)
 		return;
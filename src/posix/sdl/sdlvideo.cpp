@@ -45,6 +45,7 @@
 #include "sdlvideo.h"
 #include "swrenderer/r_swrenderer.h"
 #include "version.h"
+#include "m_argv.h"
 
 #include <SDL.h>
 
@@ -139,9 +140,12 @@ SDLFB::SDLFB (int width, int height, bool bgra, bool fullscreen, SDL_Window *old
 		FString caption;
 		caption.Format(GAMESIG " %s (%s)", GetVersionString(), GetGitTime());
 
+		// Headless benchmarks render offscreen, so the window is never shown
+		Uint32 hidden = Args->CheckParm("-benchmark") ? SDL_WINDOW_HIDDEN : 0;
+
 		Screen = SDL_CreateWindow (caption,
 			SDL_WINDOWPOS_UNDEFINED_DISPLAY(vid_adapter), SDL_WINDOWPOS_UNDEFINED_DISPLAY(vid_adapter),
-			width, height, (fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0)|SDL_WINDOW_RESIZABLE);
+			width, height, (fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0)|SDL_WINDOW_RESIZABLE|hidden);
 
 		if (Screen == NULL)
 			return;
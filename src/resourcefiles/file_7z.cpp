@@ -44,6 +44,7 @@
 #include "w_zip.h"
 #include "i_system.h"
 #include "w_wad.h"
+#include <mutex>
 
 
 
@@ -115,6 +116,7 @@ struct C7zArchive
 	UInt32 BlockIndex;
 	Byte *OutBuffer;
 	size_t OutBufferSize;
+	std::mutex ExtractMutex;	// the lump cache may extract from a worker thread
 
 	C7zArchive(FileReader *file) : ArchiveStream(file)
 	{
@@ -148,6 +150,7 @@ struct C7zArchive
 
 	SRes Extract(UInt32 file_index, char *buffer)
 	{
+		std::lock_guard<std::mutex> lock(ExtractMutex);
 		size_t offset, out_size_processed;
 		SRes res = SzArEx_Extract(&DB, &LookStream.s, file_index,
 			&BlockIndex, &OutBuffer, &OutBufferSize,
@@ -171,6 +174,9 @@ struct F7ZLump : public FResourceLump
 	int		Position;
 
 	virtual int FillCache();
+	virtual bool IsCompressed() const { return true; }
+	virtual FCompressedBuffer GetDecompressSource();
+	virtual bool Decompress(FCompressedBuffer &source, char *buffer);
 
 };
 
@@ -282,14 +288,13 @@ bool F7ZFile::Open(bool quiet)
 		SzArEx_GetFileNameUtf16(archPtr, i, &nameUTF16[0]);
 		for (size_t c = 0; c < nameLength; ++c)
 		{
-			nameASCII[c] = static_cast<char>(nameUTF16[c]);
+			nameASCII[c] = (char)tolower(static_cast<char>(nameUTF16[c]));
 		}
 		FixPathSeperator(&nameASCII[0]);
 
-		FString name = &nameASCII[0];
-		name.ToLower();
-
-		lump_p->LumpNameSetup(name);
+		// The name buffers are reused for every entry, so the name that gets kept
+		// as the lump's full name is the only allocation here.
+		lump_p->LumpNameSetup(FString(&nameASCII[0]));
 		lump_p->LumpSize = static_cast<int>(SzArEx_GetFileSize(archPtr, i));
 		lump_p->Owner = this;
 		lump_p->Flags = LUMPF_ZIPFILE;
@@ -352,6 +357,24 @@ int F7ZLump::FillCache()
 	return 1;
 }
 
+//==========================================================================
+//
+// Extraction works straight from the archive, so there is nothing to
+// read up front.
+//
+//==========================================================================
+
+FCompressedBuffer F7ZLump::GetDecompressSource()
+{
+	FCompressedBuffer cbuf = { (unsigned)LumpSize, 0, 0, 0, 0, nullptr };
+	return cbuf;
+}
+
+bool F7ZLump::Decompress(FCompressedBuffer &source, char *buffer)
+{
+	return static_cast<F7ZFile*>(Owner)->Archive->Extract(Position, buffer) == SZ_OK;
+}
+
 //==========================================================================
 //
 // File open
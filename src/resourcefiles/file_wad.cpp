@@ -556,11 +556,13 @@ void FWadFile::SetNamespace(const char *startmarker, const char *endmarker, name
 // they are such a pain, and breaking them like this was done on purpose.
 // This also renames any S_SKINxx lumps to just S_SKIN.
 //
+// Wads can be opened on any thread, so the namespace itself is only
+// assigned when the file gets added to the collection, in load order.
+//
 //==========================================================================
 
 void FWadFile::SkinHack ()
 {
-	static int namespc = ns_firstskin;
 	bool skinned = false;
 	bool hasmap = false;
 	uint32_t i;
@@ -577,17 +579,7 @@ void FWadFile::SkinHack ()
 			lump->Name[5] == 'N')
 		{ // Wad has at least one skin.
 			lump->Name[6] = lump->Name[7] = 0;
-			if (!skinned)
-			{
-				skinned = true;
-				uint32_t j;
-
-				for (j = 0; j < NumLumps; j++)
-				{
-					Lumps[j].Namespace = namespc;
-				}
-				namespc++;
-			}
+			skinned = true;
 		}
 		if ((lump->Name[0] == 'M' &&
 			 lump->Name[1] == 'A' &&
@@ -605,6 +597,7 @@ void FWadFile::SkinHack ()
 			hasmap = true;
 		}
 	}
+	Skinned = skinned;
 	if (skinned && hasmap)
 	{
 		Printf (TEXTCOLOR_BLUE
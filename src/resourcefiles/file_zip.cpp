@@ -34,6 +34,7 @@
 */
 
 #include <time.h>
+#include <zlib.h>
 #include "file_zip.h"
 #include "cmdlib.h"
 #include "templates.h"
@@ -116,6 +117,47 @@ bool FCompressedBuffer::Decompress(char *destbuffer)
 	return UncompressZipLump(destbuffer, &mr, mMethod, mSize, mCompressedSize, mZipFlags);
 }
 
+//-----------------------------------------------------------------------
+//
+// Calculates the CRC of a stored buffer and deflates it.
+// If compression fails the buffer is left stored.
+//
+//-----------------------------------------------------------------------
+
+void FCompressedBuffer::Compress()
+{
+	if (mMethod != METHOD_STORED) return;
+
+	mCRC32 = crc32(0, (const Bytef*)mBuffer, mSize);
+
+	char *compressbuf = new char[mSize + 1];
+	z_stream stream;
+
+	stream.next_in = (Bytef *)mBuffer;
+	stream.avail_in = mSize;
+	stream.next_out = (Bytef*)compressbuf;
+	stream.avail_out = mSize;
+	stream.zalloc = (alloc_func)0;
+	stream.zfree = (free_func)0;
+	stream.opaque = (voidpf)0;
+
+	// create output in zip-compatible form
+	if (deflateInit2(&stream, 8, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY) == Z_OK)
+	{
+		int err = deflate(&stream, Z_FINISH);
+		unsigned size = stream.total_out;
+		if (deflateEnd(&stream) == Z_OK && err == Z_STREAM_END)
+		{
+			delete[] mBuffer;
+			mBuffer = compressbuf;
+			mCompressedSize = size;
+			mMethod = METHOD_DEFLATE;
+			return;
+		}
+	}
+	delete[] compressbuf;
+}
+
 //-----------------------------------------------------------------------
 //
 // Finds the central directory end record in the end of the file.
@@ -221,14 +263,27 @@ bool FZipFile::Open(bool quiet)
 	FString name0;
 	bool foundspeciallump = false;
 
+	// The names in the directory are not null-terminated.
+	auto is = [](const char *str, int size, const char *what)
+	{
+		int n = (int)strlen(what);
+		return size == n && !strnicmp(str, what, n);
+	};
+	auto startswith = [](const char *str, int size, const char *what)
+	{
+		int n = (int)strlen(what);
+		return size >= n && !strnicmp(str, what, n);
+	};
+
 	// Check if all files have the same prefix so that this can be stripped out.
 	// This will only be done if there is either a MAPINFO, ZMAPINFO or GAMEINFO lump in the subdirectory, denoting a ZDoom mod.
+	// The names are compared in the directory itself, so this does not allocate anything per entry.
 	if (NumLumps > 1) for (uint32_t i = 0; i < NumLumps; i++)
 	{
 		FZipCentralDirectoryInfo *zip_fh = (FZipCentralDirectoryInfo *)dirptr;
 
 		int len = LittleShort(zip_fh->NameLength);
-		FString name(dirptr + sizeof(FZipCentralDirectoryInfo), len);
+		const char *name = dirptr + sizeof(FZipCentralDirectoryInfo);
 
 		dirptr += sizeof(FZipCentralDirectoryInfo) +
 			LittleShort(zip_fh->NameLength) +
@@ -242,30 +297,30 @@ bool FZipFile::Open(bool quiet)
 			return false;
 		}
 
-		name.ToLower();
 		if (i == 0)
 		{
 			// check for special names, if one of these gets found this must be treated as a normal zip.
-			bool isspecial = !name.Compare("flats/") ||
-				name.IndexOf("/") < 0 ||
-				!name.Compare("textures/") ||
-				!name.Compare("hires/") ||
-				!name.Compare("sprites/") ||
-				!name.Compare("voxels/") ||
-				!name.Compare("colormaps/") ||
-				!name.Compare("acs/") ||
-				!name.Compare("maps/") ||
-				!name.Compare("voices/") ||
-				!name.Compare("patches/") ||
-				!name.Compare("graphics/") ||
-				!name.Compare("sounds/") ||
-				!name.Compare("music/");
+			bool isspecial = is(name, len, "flats/") ||
+				memchr(name, '/', len) == nullptr ||
+				is(name, len, "textures/") ||
+				is(name, len, "hires/") ||
+				is(name, len, "sprites/") ||
+				is(name, len, "voxels/") ||
+				is(name, len, "colormaps/") ||
+				is(name, len, "acs/") ||
+				is(name, len, "maps/") ||
+				is(name, len, "voices/") ||
+				is(name, len, "patches/") ||
+				is(name, len, "graphics/") ||
+				is(name, len, "sounds/") ||
+				is(name, len, "music/");
 			if (isspecial) break;
-			name0 = name;
+			name0 = FString(name, len);
+			name0.ToLower();
 		}
 		else
 		{
-			if (name.IndexOf(name0) != 0)
+			if (!startswith(name, len, name0))
 			{
 				name0 = "";
 				break;
@@ -273,19 +328,21 @@ bool FZipFile::Open(bool quiet)
 			else if (!foundspeciallump)
 			{
 				// at least one of the more common definition lumps must be present.
-				if (name.IndexOf(name0 + "mapinfo") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "zmapinfo") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "gameinfo") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "sndinfo") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "sbarinfo") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "menudef") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "gldefs") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "animdefs") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "decorate.") == 0) foundspeciallump = true;	// DECORATE is a common subdirectory name, so the check needs to be a bit different.
-				else if (name.Compare(name0 + "decorate") == 0) foundspeciallump = true;
-				else if (name.IndexOf(name0 + "zscript.") == 0) foundspeciallump = true;	// same here.
-				else if (name.Compare(name0 + "zscript") == 0) foundspeciallump = true;
-				else if (name.Compare(name0 + "maps/") == 0) foundspeciallump = true;
+				const char *sub = name + name0.Len();
+				int sublen = len - (int)name0.Len();
+				if (startswith(sub, sublen, "mapinfo")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "zmapinfo")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "gameinfo")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "sndinfo")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "sbarinfo")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "menudef")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "gldefs")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "animdefs")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "decorate.")) foundspeciallump = true;	// DECORATE is a common subdirectory name, so the check needs to be a bit different.
+				else if (is(sub, sublen, "decorate")) foundspeciallump = true;
+				else if (startswith(sub, sublen, "zscript.")) foundspeciallump = true;	// same here.
+				else if (is(sub, sublen, "zscript")) foundspeciallump = true;
+				else if (is(sub, sublen, "maps/")) foundspeciallump = true;
 			}
 		}
 	}
@@ -297,8 +354,10 @@ bool FZipFile::Open(bool quiet)
 		FZipCentralDirectoryInfo *zip_fh = (FZipCentralDirectoryInfo *)dirptr;
 
 		int len = LittleShort(zip_fh->NameLength);
-		FString name(dirptr + sizeof(FZipCentralDirectoryInfo), len);
-		if (name0.IsNotEmpty()) name = name.Mid(name0.Len());
+		const char *rawname = dirptr + sizeof(FZipCentralDirectoryInfo);
+		bool isdir = len > 0 && rawname[len - 1] == '/';
+		// The prefix check above guarantees that every name starts with name0.
+		FString name(rawname + name0.Len(), len - name0.Len());
 		dirptr += sizeof(FZipCentralDirectoryInfo) + 
 				  LittleShort(zip_fh->NameLength) + 
 				  LittleShort(zip_fh->ExtraLength) + 
@@ -312,7 +371,7 @@ bool FZipFile::Open(bool quiet)
 		}
 		
 		// skip Directories
-		if (name[len - 1] == '/' && LittleLong(zip_fh->UncompressedSize) == 0) 
+		if (isdir && LittleLong(zip_fh->UncompressedSize) == 0)
 		{
 			skipped++;
 			continue;
@@ -467,6 +526,17 @@ int FZipLump::FillCache()
 	return 1;
 }
 
+//==========================================================================
+//
+// Stored lumps are read directly and never go through the lump cache
+//
+//==========================================================================
+
+bool FZipLump::IsCompressed() const
+{
+	return Method != METHOD_STORED;
+}
+
 //==========================================================================
 //
 //
@@ -0,0 +1,357 @@
+/*
+** lumpcache.cpp
+**
+** Shared cache for decompressed lump data
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include "lumpcache.h"
+#include "c_cvars.h"
+#include "c_console.h"
+#include "w_wad.h"
+
+CUSTOM_CVAR(Int, lumpcache_size, 64, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 0) self = 0;
+}
+
+//==========================================================================
+//
+// FLumpCache
+//
+//==========================================================================
+
+FLumpCache *FLumpCache::Instance()
+{
+	// Never destroyed: lumps may still be released after static destruction started.
+	static FLumpCache *cache = new FLumpCache;
+	return cache;
+}
+
+FLumpCache::FLumpCache()
+: Head(nullptr), Tail(nullptr), TotalSize(0)
+{
+}
+
+void FLumpCache::Link(FEntry *entry)
+{
+	entry->Prev = nullptr;
+	entry->Next = Head;
+	if (Head != nullptr) Head->Prev = entry;
+	else Tail = entry;
+	Head = entry;
+}
+
+void FLumpCache::Unlink(FEntry *entry)
+{
+	if (entry->Prev != nullptr) entry->Prev->Next = entry->Next;
+	else Head = entry->Next;
+	if (entry->Next != nullptr) entry->Next->Prev = entry->Prev;
+	else Tail = entry->Prev;
+	entry->Prev = entry->Next = nullptr;
+}
+
+//==========================================================================
+//
+// Free
+//
+// Releases an entry that is not being worked on.
+//
+//==========================================================================
+
+void FLumpCache::Free(FEntry *entry)
+{
+	Unlink(entry);
+	Entries.Remove(entry->Lump);
+	if (entry->Data != nullptr)
+	{
+		TotalSize -= entry->Size;
+		delete[] entry->Data;
+	}
+	delete entry;
+}
+
+//==========================================================================
+//
+// Evict
+//
+// Drops the oldest finished entries until the cache fits its budget.
+// Entries still waiting for a job are left alone.
+//
+//==========================================================================
+
+void FLumpCache::Evict()
+{
+	size_t limit = size_t(*lumpcache_size) << 20;
+	FEntry *entry = Tail;
+	while (TotalSize > limit && entry != nullptr)
+	{
+		FEntry *prev = entry->Prev;
+		if (entry->State == STATE_Ready)
+		{
+			Free(entry);
+		}
+		entry = prev;
+	}
+}
+
+//==========================================================================
+//
+// Take
+//
+//==========================================================================
+
+char *FLumpCache::Take(FResourceLump *lump)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	FEntry **pentry = Entries.CheckKey(lump);
+	if (pentry == nullptr) return nullptr;
+	FEntry *entry = *pentry;
+
+	// A job that has already started is likely to finish before the
+	// lump could be decompressed again, so wait for it.
+	while (entry->State == STATE_Running)
+	{
+		Finished.wait(lock);
+	}
+
+	// A queued job has not started yet. Dropping the entry makes it skip
+	// the lump, and the caller decompresses it right away.
+	char *data = entry->Data;
+	if (data != nullptr)
+	{
+		TotalSize -= entry->Size;
+		entry->Data = nullptr;
+	}
+	Free(entry);
+	return data;
+}
+
+//==========================================================================
+//
+// Store
+//
+//==========================================================================
+
+void FLumpCache::Store(FResourceLump *lump, char *data)
+{
+	if (*lumpcache_size <= 0 || data == nullptr)
+	{
+		delete[] data;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	FEntry **pentry = Entries.CheckKey(lump);
+	if (pentry != nullptr)
+	{
+		// The lump was decompressed again while a prefetch for it was
+		// pending. Keep whichever is done first.
+		FEntry *entry = *pentry;
+		if (entry->State != STATE_Queued)
+		{
+			delete[] data;
+			return;
+		}
+		entry->State = STATE_Ready;
+		entry->Data = data;
+		TotalSize += entry->Size;
+		Unlink(entry);
+		Link(entry);
+	}
+	else
+	{
+		FEntry *entry = new FEntry;
+		entry->Lump = lump;
+		entry->Data = data;
+		entry->Size = lump->LumpSize;
+		entry->State = STATE_Ready;
+		Entries[lump] = entry;
+		TotalSize += entry->Size;
+		Link(entry);
+	}
+	lump->Flags |= LUMPF_LUMPCACHE;
+	Evict();
+}
+
+//==========================================================================
+//
+// Remove
+//
+//==========================================================================
+
+void FLumpCache::Remove(FResourceLump *lump)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	FEntry **pentry = Entries.CheckKey(lump);
+	if (pentry != nullptr)
+	{
+		FEntry *entry = *pentry;
+		while (entry->State == STATE_Running)
+		{
+			Finished.wait(lock);
+		}
+		Free(entry);
+	}
+}
+
+//==========================================================================
+//
+// Prefetch
+//
+// The compressed data is read here, on the calling thread, because the
+// archive readers are not thread safe. Only decompression runs on the
+// workers.
+//
+//==========================================================================
+
+void FLumpCache::Prefetch(const TArray<FResourceLump *> &lumps)
+{
+	if (*lumpcache_size <= 0) return;
+
+	auto jobs = FJobSystem::Instance();
+	size_t limit = size_t(*lumpcache_size) << 20;
+	size_t queued = 0;
+
+	for (auto lump : lumps)
+	{
+		if (lump == nullptr || lump->Cache != nullptr || lump->LumpSize <= 0 || !lump->IsCompressed())
+			continue;
+
+		// Prefetching more than the cache can hold would only evict the
+		// first lumps before anyone got to use them.
+		if (queued + lump->LumpSize > limit)
+			break;
+
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			if (Entries.CheckKey(lump) != nullptr)
+				continue;
+
+			FEntry *entry = new FEntry;
+			entry->Lump = lump;
+			entry->Data = nullptr;
+			entry->Size = lump->LumpSize;
+			entry->State = STATE_Queued;
+			Entries[lump] = entry;
+			Link(entry);
+		}
+		lump->Flags |= LUMPF_LUMPCACHE;
+		queued += lump->LumpSize;
+
+		FPrefetchJob *job = new FPrefetchJob;
+		job->Cache = this;
+		job->Lump = lump;
+		job->Source = lump->GetDecompressSource();
+		job->Job.Func = RunPrefetch;
+		job->Job.Data = job;
+		job->Job.Group = &Jobs;
+		Jobs.Add();
+		jobs->Submit(&job->Job);
+	}
+}
+
+//==========================================================================
+//
+// RunPrefetch
+//
+// Job function. Any console output means that decompression ran into a
+// problem; the result is thrown away and the lump gets decompressed
+// again on first use, which reports the error where it can be printed.
+//
+//==========================================================================
+
+void FLumpCache::RunPrefetch(void *data)
+{
+	FPrefetchJob *job = (FPrefetchJob *)data;
+	FLumpCache *self = job->Cache;
+	FEntry *entry = nullptr;
+
+	{
+		std::unique_lock<std::mutex> lock(self->Mutex);
+		FEntry **pentry = self->Entries.CheckKey(job->Lump);
+		if (pentry != nullptr && (*pentry)->State == STATE_Queued)
+		{
+			entry = *pentry;
+			entry->State = STATE_Running;
+		}
+	}
+
+	if (entry != nullptr)
+	{
+		char *buffer = new char[entry->Size];
+		FConsoleCapture output;
+
+		output.Start();
+		bool ok = job->Lump->Decompress(job->Source, buffer);
+		output.Stop();
+		if (!ok || !output.IsEmpty())
+		{
+			delete[] buffer;
+			buffer = nullptr;
+		}
+
+		std::unique_lock<std::mutex> lock(self->Mutex);
+		if (buffer != nullptr)
+		{
+			entry->Data = buffer;
+			entry->State = STATE_Ready;
+			self->TotalSize += entry->Size;
+			self->Evict();
+		}
+		else
+		{
+			self->Free(entry);
+		}
+		self->Finished.notify_all();
+	}
+
+	job->Source.Clean();
+	delete job;
+}
+
+//==========================================================================
+//
+// Clear
+//
+//==========================================================================
+
+void FLumpCache::Clear()
+{
+	Jobs.Wait();
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	while (Head != nullptr)
+	{
+		Free(Head);
+	}
+}
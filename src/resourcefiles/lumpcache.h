@@ -0,0 +1,111 @@
+/*
+** lumpcache.h
+**
+** Shared cache for decompressed lump data
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Compressed lumps release their data into this cache instead of freeing
+** it, so that a texture or sound that is used again does not have to be
+** decompressed a second time. The cache can also decompress lumps ahead
+** of time on the job system. It is limited by lumpcache_size and drops
+** the least recently stored data first.
+**
+*/
+
+#ifndef __LUMPCACHE_H
+#define __LUMPCACHE_H
+
+#include <mutex>
+#include <condition_variable>
+#include "tarray.h"
+#include "jobsystem.h"
+#include "resourcefile.h"
+
+class FLumpCache
+{
+public:
+	static FLumpCache *Instance();
+
+	// Hands out the cached data of a lump and removes it from the cache.
+	// Returns NULL if nothing is cached.
+	char *Take(FResourceLump *lump);
+
+	// Takes ownership of the lump's decompressed data.
+	void Store(FResourceLump *lump, char *data);
+
+	// Forgets a lump that is being destroyed.
+	void Remove(FResourceLump *lump);
+
+	// Queues decompression of the given lumps on the job system.
+	void Prefetch(const TArray<FResourceLump *> &lumps);
+
+	// Waits for all queued work and frees everything.
+	void Clear();
+
+private:
+	enum EState
+	{
+		STATE_Queued,
+		STATE_Running,
+		STATE_Ready,
+	};
+
+	struct FEntry
+	{
+		FResourceLump *Lump;
+		char *Data;
+		unsigned Size;
+		EState State;
+		FEntry *Prev, *Next;	// most recently stored first
+	};
+
+	struct FPrefetchJob
+	{
+		FJob Job;
+		FLumpCache *Cache;
+		FResourceLump *Lump;
+		FCompressedBuffer Source;
+	};
+
+	FLumpCache();
+
+	static void RunPrefetch(void *data);
+	void Link(FEntry *entry);
+	void Unlink(FEntry *entry);
+	void Free(FEntry *entry);
+	void Evict();
+
+	std::mutex Mutex;
+	std::condition_variable Finished;
+	TMap<FResourceLump *, FEntry *> Entries;
+	FEntry *Head, *Tail;
+	size_t TotalSize;
+	FJobGroup Jobs;
+};
+
+#endif
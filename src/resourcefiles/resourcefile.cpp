@@ -41,6 +41,7 @@
 #include "gi.h"
 #include "doomstat.h"
 #include "w_zip.h"
+#include "lumpcache.h"
 
 
 //==========================================================================
@@ -76,6 +77,10 @@ public:
 
 FResourceLump::~FResourceLump()
 {
+	if (Flags & LUMPF_LUMPCACHE)
+	{
+		FLumpCache::Instance()->Remove(this);
+	}
 	if (Cache != NULL && RefCount >= 0)
 	{
 		delete [] Cache;
@@ -93,12 +98,16 @@ FResourceLump::~FResourceLump()
 
 void FResourceLump::LumpNameSetup(FString iname)
 {
-	long slash = iname.LastIndexOf('/');
-	FString base = (slash >= 0) ? iname.Mid(slash + 1) : iname;
-	auto dot = base.LastIndexOf('.');
-	if (dot >= 0) base.Truncate(dot);
-	uppercopy(Name, base);
-	Name[8] = 0;
+	// Called for every entry of an archive, so the short name is cut out in place.
+	const char *base = strrchr(iname.GetChars(), '/');
+	base = base != nullptr ? base + 1 : iname.GetChars();
+	const char *dot = strrchr(base, '.');
+	size_t baselen = dot != nullptr ? size_t(dot - base) : strlen(base);
+	size_t i;
+	for (i = 0; i < 8 && i < baselen; i++)
+		Name[i] = toupper(base[i]);
+	for (; i < 9; i++)
+		Name[i] = 0;
 	FullName = iname;
 
 	// Map some directories to WAD namespaces.
@@ -246,7 +255,14 @@ void *FResourceLump::CacheLump()
 	}
 	else if (LumpSize > 0)
 	{
-		FillCache();
+		if ((Flags & LUMPF_LUMPCACHE) && (Cache = FLumpCache::Instance()->Take(this)) != NULL)
+		{
+			RefCount = 1;
+		}
+		else
+		{
+			FillCache();
+		}
 	}
 	return Cache;
 }
@@ -263,7 +279,14 @@ int FResourceLump::ReleaseCache()
 	{
 		if (--RefCount == 0)
 		{
-			delete [] Cache;
+			if (IsCompressed())
+			{
+				FLumpCache::Instance()->Store(this, Cache);
+			}
+			else
+			{
+				delete [] Cache;
+			}
 			Cache = NULL;
 		}
 	}
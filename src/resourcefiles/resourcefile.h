@@ -19,6 +19,7 @@ struct FCompressedBuffer
 	char *mBuffer;
 
 	bool Decompress(char *destbuffer);
+	void Compress();
 	void Clean()
 	{
 		mSize = mCompressedSize = 0;
@@ -70,6 +71,13 @@ struct FResourceLump
 	void CheckEmbedded();
 	virtual FCompressedBuffer GetRawData();
 
+	// Compressed lumps keep their data in the lump cache after release and
+	// can be decompressed ahead of time. GetDecompressSource is called on
+	// the main thread, Decompress may run on any thread.
+	virtual bool IsCompressed() const { return false; }
+	virtual FCompressedBuffer GetDecompressSource() { return GetRawData(); }
+	virtual bool Decompress(FCompressedBuffer &source, char *buffer) { return source.Decompress(buffer); }
+
 	void *CacheLump();
 	int ReleaseCache();
 
@@ -85,6 +93,7 @@ public:
 	const char *Filename;
 protected:
 	uint32_t NumLumps;
+	bool Skinned = false;	// all lumps go into a namespace of their own (see FWadFile::SkinHack)
 
 	FResourceFile(const char *filename, FileReader *r);
 
@@ -107,6 +116,7 @@ public:
 	uint32_t LumpCount() const { return NumLumps; }
 	uint32_t GetFirstLump() const { return FirstLump; }
 	void SetFirstLump(uint32_t f) { FirstLump = f; }
+	bool IsSkinned() const { return Skinned; }
 
 	virtual void FindStrifeTeaserVoices ();
 	virtual bool Open(bool quiet) = 0;
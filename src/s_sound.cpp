@@ -535,6 +535,16 @@ void S_PrecacheLevel ()
 			chan->SoundID.MarkUsed();
 		}
 
+		TArray<int> lumps;
+		for (i = 1; i < S_sfx.Size(); ++i)
+		{
+			if (S_sfx[i].bUsed && !S_sfx[i].data.isValid() && S_sfx[i].lumpnum >= 0)
+			{
+				lumps.Push(S_sfx[i].lumpnum);
+			}
+		}
+		Wads.PrefetchLumps(lumps);
+
 		for (i = 1; i < S_sfx.Size(); ++i)
 		{
 			if (S_sfx[i].bUsed)
@@ -142,6 +142,11 @@ void VMFunctionBuilder::MakeFunction(VMScriptFunction *func)
 	func->NumRegS = Registers[REGT_STRING].MostUsed;
 	func->MaxParam = MaxParam;
 	func->StackSize = VMFrame::FrameSize(func->NumRegD, func->NumRegF, func->NumRegS, func->NumRegA, func->MaxParam, func->ExtraSpace);
+	func->BuildFusedCode();
+	if (VMJitSelected())
+	{
+		VMJitCompile(func);
+	}
 
 	// Technically, there's no reason why we can't end the function with
 	// entries on the parameter stack, but it means the caller probably
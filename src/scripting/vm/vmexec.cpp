@@ -100,6 +100,14 @@ void ThrowVMException(VMException *x);
 		pc += 1; \
 	}
 
+// Second half of a superinstruction: continue directly with the handler
+// of the following instruction instead of dispatching to it.
+#if COMPGOTO
+#define FUSEDOP(x)	do { pc++; a = pc->a; goto x; } while(0)
+#else
+#define FUSEDOP(x)	NEXTOP
+#endif
+
 #define GETADDR(a,o,x) \
 	if (a == NULL) { ThrowAbortException(x, nullptr); return 0; } \
 	ptr = (VM_SBYTE *)a + o
@@ -132,13 +140,31 @@ struct VMExec_Unchecked
 {
 #include "vmexec.h"
 };
+#define VMEXEC_FUSED 1
+struct VMExec_Fused
+{
+#include "vmexec.h"
+};
+#undef VMEXEC_FUSED
+#define VMEXEC_JIT 1
+struct VMExec_JIT
+{
+#include "vmexec.h"
+};
+#undef VMEXEC_JIT
+#define VMEXEC_JIT 2
+struct VMExec_JITValidate
+{
+#include "vmexec.h"
+};
+#undef VMEXEC_JIT
 #if !WAS_NDEBUG
 #undef NDEBUG
 #endif
 #undef assert
 #include <assert.h>
 
-int (*VMExec)(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret) =
+VMExecFunc VMExec =
 #ifdef NDEBUG
 VMExec_Unchecked::Exec
 #else
@@ -157,12 +183,24 @@ thread_local VMFrameStack GlobalVMStack;
 // VMSelectEngine
 //
 // Selects the VM engine, either checked or unchecked. Default will decide
-// based on the NDEBUG preprocessor definition.
+// based on the NDEBUG preprocessor definition. Fused is the unchecked engine
+// running the superinstruction version of each function's code. JIT runs
+// native code for every function that could be compiled and interprets
+// the rest; JITValidate also interprets those and reports differences.
+// Nothing gets compiled to native code before one of these two is picked.
 //
 //===========================================================================
 
+static bool JitSelected;
+
 void VMSelectEngine(EVMEngine engine)
 {
+	JitSelected = engine == VMEngine_JIT || engine == VMEngine_JITValidate;
+	if (JitSelected)
+	{
+		VMJitCompileAll();
+	}
+
 	switch (engine)
 	{
 	case VMEngine_Default:
@@ -178,9 +216,23 @@ void VMSelectEngine(EVMEngine engine)
 	case VMEngine_Checked:
 		VMExec = VMExec_Checked::Exec;
 		break;
+	case VMEngine_Fused:
+		VMExec = VMExec_Fused::Exec;
+		break;
+	case VMEngine_JIT:
+		VMExec = VMExec_JIT::Exec;
+		break;
+	case VMEngine_JITValidate:
+		VMExec = VMExec_JITValidate::Exec;
+		break;
 	}
 }
 
+bool VMJitSelected()
+{
+	return JitSelected;
+}
+
 //===========================================================================
 //
 // VMFillParams
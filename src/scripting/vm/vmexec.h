@@ -63,6 +63,23 @@ static int Exec(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret)
 		konstf = sfunc->KonstF;
 		konsts = sfunc->KonstS;
 		konsta = sfunc->KonstA;
+#if VMEXEC_FUSED
+		if (sfunc->FusedCode != NULL)
+		{
+			pc = sfunc->FusedCode + (pc - sfunc->Code);
+		}
+#endif
+#if VMEXEC_JIT == 1
+		if (sfunc->JitFunc != NULL)
+		{
+			return VMJitExec(stack, sfunc, ret, numret);
+		}
+#elif VMEXEC_JIT == 2
+		if (sfunc->JitFunc != NULL)
+		{
+			return VMJitValidate(stack, sfunc, ret, numret, VMExec_Unchecked::Exec);
+		}
+#endif
 	}
 	else
 	{
@@ -579,87 +596,7 @@ static int Exec(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret)
 		}
 		NEXTOP;
 	OP(PARAM):
-		assert(f->NumParam < sfunc->MaxParam);
-		{
-			VMValue *param = &reg.param[f->NumParam++];
-			b = B;
-			if (b == REGT_NIL)
-			{
-				::new(param) VMValue();
-			}
-			else
-			{
-				switch(b)
-				{
-				case REGT_INT:
-					assert(C < f->NumRegD);
-					::new(param) VMValue(reg.d[C]);
-					break;
-				case REGT_INT | REGT_ADDROF:
-					assert(C < f->NumRegD);
-					::new(param) VMValue(&reg.d[C]);
-					break;
-				case REGT_INT | REGT_KONST:
-					assert(C < sfunc->NumKonstD);
-					::new(param) VMValue(konstd[C]);
-					break;
-				case REGT_STRING:
-					assert(C < f->NumRegS);
-					::new(param) VMValue(&reg.s[C]);
-					break;
-				case REGT_STRING | REGT_ADDROF:
-					assert(C < f->NumRegS);
-					::new(param) VMValue((void*)&reg.s[C]);	// Note that this may not use the FString* version of the constructor!
-					break;
-				case REGT_STRING | REGT_KONST:
-					assert(C < sfunc->NumKonstS);
-					::new(param) VMValue(&konsts[C]);
-					break;
-				case REGT_POINTER:
-					assert(C < f->NumRegA);
-					::new(param) VMValue(reg.a[C]);
-					break;
-				case REGT_POINTER | REGT_ADDROF:
-					assert(C < f->NumRegA);
-					::new(param) VMValue(&reg.a[C]);
-					break;
-				case REGT_POINTER | REGT_KONST:
-					assert(C < sfunc->NumKonstA);
-					::new(param) VMValue(konsta[C].v);
-					break;
-				case REGT_FLOAT:
-					assert(C < f->NumRegF);
-					::new(param) VMValue(reg.f[C]);
-					break;
-				case REGT_FLOAT | REGT_MULTIREG2:
-					assert(C < f->NumRegF - 1);
-					assert(f->NumParam < sfunc->MaxParam);
-					::new(param) VMValue(reg.f[C]);
-					::new(param + 1) VMValue(reg.f[C + 1]);
-					f->NumParam++;
-					break;
-				case REGT_FLOAT | REGT_MULTIREG3:
-					assert(C < f->NumRegF - 2);
-					assert(f->NumParam < sfunc->MaxParam - 1);
-					::new(param) VMValue(reg.f[C]);
-					::new(param + 1) VMValue(reg.f[C + 1]);
-					::new(param + 2) VMValue(reg.f[C + 2]);
-					f->NumParam += 2;
-					break;
-				case REGT_FLOAT | REGT_ADDROF:
-					assert(C < f->NumRegF);
-					::new(param) VMValue(&reg.f[C]);
-					break;
-				case REGT_FLOAT | REGT_KONST:
-					assert(C < sfunc->NumKonstF);
-					::new(param) VMValue(konstf[C]);
-					break;
-				default:
-					assert(0);
-					break;
-				}
-			}
-		}
+		DoParam(reg, f, sfunc, B, C);
 		NEXTOP;
 	OP(VTBL):
 		ASSERTA(a); ASSERTA(B);
@@ -1703,6 +1640,98 @@ static int Exec(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret)
 		CMPJMP(reg.a[B] == konsta[C].v);
 		NEXTOP;
 
+	OP(LW_EQ_K):
+		ASSERTD(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.d[a] = *(VM_SWORD *)ptr;
+		FUSEDOP(EQ_K);
+	OP(LW_LT_RK):
+		ASSERTD(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.d[a] = *(VM_SWORD *)ptr;
+		FUSEDOP(LT_RK);
+	OP(LW_LT_KR):
+		ASSERTD(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.d[a] = *(VM_SWORD *)ptr;
+		FUSEDOP(LT_KR);
+	OP(LW_LE_RK):
+		ASSERTD(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.d[a] = *(VM_SWORD *)ptr;
+		FUSEDOP(LE_RK);
+	OP(LW_LE_KR):
+		ASSERTD(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.d[a] = *(VM_SWORD *)ptr;
+		FUSEDOP(LE_KR);
+	OP(LBU_EQ_K):
+		ASSERTD(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.d[a] = *(VM_UBYTE *)ptr;
+		FUSEDOP(EQ_K);
+	OP(LO_EQA_K):
+		ASSERTA(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.a[a] = GC::ReadBarrier(*(DObject **)ptr);
+		FUSEDOP(EQA_K);
+	OP(LP_EQA_K):
+		ASSERTA(a); ASSERTA(B); ASSERTKD(C);
+		GETADDR(PB,KC,X_READ_NIL);
+		reg.a[a] = *(void **)ptr;
+		FUSEDOP(EQA_K);
+	OP(PARAM_CALL):
+		// Push the whole parameter list, then do the call without going through dispatch again.
+		DoParam(reg, f, sfunc, B, C);
+		for (pc++; pc->op != OP_CALL && pc->op != OP_CALL_K; pc++)
+		{
+			if (pc->op == OP_PARAMI)
+			{
+				assert(f->NumParam < sfunc->MaxParam);
+				::new(&reg.param[f->NumParam++]) VMValue(ABCs);
+			}
+			else
+			{
+				assert(pc->op == OP_PARAM);
+				DoParam(reg, f, sfunc, B, C);
+			}
+		}
+		a = pc->a;
+		if (pc->op == OP_CALL_K)
+		{
+			ASSERTKA(a);
+			ptr = konsta[a].o;
+		}
+		else
+		{
+			ASSERTA(a);
+			ptr = reg.a[a];
+		}
+		goto Do_CALL;
+	OP(RET_N):
+		// Multiple return values: store all of them in one go.
+		assert(ret != NULL || numret == 0);
+		for (;; pc++)
+		{
+			int retnum = pc->a & ~RET_FINAL;
+			if (retnum < numret)
+			{
+				if (pc->op == OP_RETI)
+				{
+					ret[retnum].SetInt(BCs);
+				}
+				else
+				{
+					assert(pc->op == OP_RET || pc->op == OP_RET_N);
+					SetReturn(reg, f, &ret[retnum], B, C);
+				}
+			}
+			if (pc->a & RET_FINAL)
+			{
+				return retnum < numret ? retnum + 1 : numret;
+			}
+		}
+
 	OP(NOP):
 		NEXTOP;
 	}
@@ -1918,6 +1947,96 @@ static void DoCast(const VMRegisters &reg, const VMFrame *f, int a, int b, int c
 	}
 }
 
+//===========================================================================
+//
+// DoParam
+//
+// Pushes a parameter encoded in the B and C operands of a PARAM instruction.
+//
+//===========================================================================
+
+static void DoParam(const VMRegisters &reg, VMFrame *f, const VMScriptFunction *sfunc, int b, int c)
+{
+	assert(f->NumParam < sfunc->MaxParam);
+	VMValue *param = &reg.param[f->NumParam++];
+	if (b == REGT_NIL)
+	{
+		::new(param) VMValue();
+	}
+	else
+	{
+		switch(b)
+		{
+		case REGT_INT:
+			assert(c < f->NumRegD);
+			::new(param) VMValue(reg.d[c]);
+			break;
+		case REGT_INT | REGT_ADDROF:
+			assert(c < f->NumRegD);
+			::new(param) VMValue(&reg.d[c]);
+			break;
+		case REGT_INT | REGT_KONST:
+			assert(c < sfunc->NumKonstD);
+			::new(param) VMValue(sfunc->KonstD[c]);
+			break;
+		case REGT_STRING:
+			assert(c < f->NumRegS);
+			::new(param) VMValue(&reg.s[c]);
+			break;
+		case REGT_STRING | REGT_ADDROF:
+			assert(c < f->NumRegS);
+			::new(param) VMValue((void*)&reg.s[c]);	// Note that this may not use the FString* version of the constructor!
+			break;
+		case REGT_STRING | REGT_KONST:
+			assert(c < sfunc->NumKonstS);
+			::new(param) VMValue(&sfunc->KonstS[c]);
+			break;
+		case REGT_POINTER:
+			assert(c < f->NumRegA);
+			::new(param) VMValue(reg.a[c]);
+			break;
+		case REGT_POINTER | REGT_ADDROF:
+			assert(c < f->NumRegA);
+			::new(param) VMValue(&reg.a[c]);
+			break;
+		case REGT_POINTER | REGT_KONST:
+			assert(c < sfunc->NumKonstA);
+			::new(param) VMValue(sfunc->KonstA[c].v);
+			break;
+		case REGT_FLOAT:
+			assert(c < f->NumRegF);
+			::new(param) VMValue(reg.f[c]);
+			break;
+		case REGT_FLOAT | REGT_MULTIREG2:
+			assert(c < f->NumRegF - 1);
+			assert(f->NumParam < sfunc->MaxParam);
+			::new(param) VMValue(reg.f[c]);
+			::new(param + 1) VMValue(reg.f[c + 1]);
+			f->NumParam++;
+			break;
+		case REGT_FLOAT | REGT_MULTIREG3:
+			assert(c < f->NumRegF - 2);
+			assert(f->NumParam < sfunc->MaxParam - 1);
+			::new(param) VMValue(reg.f[c]);
+			::new(param + 1) VMValue(reg.f[c + 1]);
+			::new(param + 2) VMValue(reg.f[c + 2]);
+			f->NumParam += 2;
+			break;
+		case REGT_FLOAT | REGT_ADDROF:
+			assert(c < f->NumRegF);
+			::new(param) VMValue(&reg.f[c]);
+			break;
+		case REGT_FLOAT | REGT_KONST:
+			assert(c < sfunc->NumKonstF);
+			::new(param) VMValue(sfunc->KonstF[c]);
+			break;
+		default:
+			assert(0);
+			break;
+		}
+	}
+}
+
 //===========================================================================
 //
 // FillReturns
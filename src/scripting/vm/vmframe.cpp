@@ -56,6 +56,10 @@ VMScriptFunction::VMScriptFunction(FName name)
 	Name = name;
 	LineInfo = nullptr;
 	Code = NULL;
+	FusedCode = NULL;
+	JitFunc = NULL;
+	JitWritesMemory = false;
+	JitCompiled = false;
 	KonstD = NULL;
 	KonstF = NULL;
 	KonstS = NULL;
@@ -194,7 +198,7 @@ int VMScriptFunction::AllocExtraStack(PType *type)
 
 int VMScriptFunction::PCToLine(const VMOP *pc)
 {
-	int PCIndex = int(pc - Code);
+	int PCIndex = int(pc - (FusedCode != NULL && pc >= FusedCode && pc < FusedCode + CodeSize ? FusedCode : Code));
 	if (LineInfoCount == 1) return LineInfo[0].LineNumber;
 	for (unsigned i = 1; i < LineInfoCount; i++)
 	{
@@ -206,6 +210,100 @@ int VMScriptFunction::PCToLine(const VMOP *pc)
 	return -1;
 }
 
+//===========================================================================
+//
+// VMScriptFunction :: BuildFusedCode
+//
+// Creates a copy of the code where the first instruction of some common
+// sequences is replaced by a superinstruction that executes the entire
+// sequence with a single dispatch. The remaining instructions are left
+// untouched so that the copy has the same layout as the original.
+//
+//===========================================================================
+
+static bool IsRetChainOp(const VMOP &op)
+{
+	return (op.op == OP_RET && op.b != REGT_NIL) || op.op == OP_RETI;
+}
+
+void VMScriptFunction::BuildFusedCode()
+{
+	TArray<VMOP> fused;
+	int numfused = 0;
+
+	fused.Resize(CodeSize);
+	memcpy(&fused[0], Code, CodeSize * sizeof(VMOP));
+	for (int i = 0; i < CodeSize; i++)
+	{
+		VMOP &op = fused[i];
+
+		// Field load, compare and branch
+		if (i + 2 < CodeSize && fused[i + 2].op == OP_JMP)
+		{
+			int cmp = fused[i + 1].op;
+			int newop = OP_NOP;
+
+			switch (op.op)
+			{
+			case OP_LW:
+				newop = cmp == OP_EQ_K ? OP_LW_EQ_K : cmp == OP_LT_RK ? OP_LW_LT_RK : cmp == OP_LT_KR ? OP_LW_LT_KR :
+					cmp == OP_LE_RK ? OP_LW_LE_RK : cmp == OP_LE_KR ? OP_LW_LE_KR : OP_NOP;
+				break;
+			case OP_LBU:
+				newop = cmp == OP_EQ_K ? OP_LBU_EQ_K : OP_NOP;
+				break;
+			case OP_LO:
+				newop = cmp == OP_EQA_K ? OP_LO_EQA_K : OP_NOP;
+				break;
+			case OP_LP:
+				newop = cmp == OP_EQA_K ? OP_LP_EQA_K : OP_NOP;
+				break;
+			}
+			if (newop != OP_NOP)
+			{
+				op.op = newop;
+				numfused++;
+				i += 2;
+				continue;
+			}
+		}
+
+		// Parameter list followed by a call
+		if (op.op == OP_PARAM)
+		{
+			int j = i + 1;
+			while (j < CodeSize && (fused[j].op == OP_PARAM || fused[j].op == OP_PARAMI)) j++;
+			if (j < CodeSize && (fused[j].op == OP_CALL || fused[j].op == OP_CALL_K))
+			{
+				op.op = OP_PARAM_CALL;
+				numfused++;
+			}
+			i = j - 1;
+			continue;
+		}
+
+		// Multiple return values
+		if (op.op == OP_RET && op.b != REGT_NIL && !(op.a & RET_FINAL))
+		{
+			int j = i + 1;
+			while (j < CodeSize && IsRetChainOp(fused[j]) && !(fused[j].a & RET_FINAL)) j++;
+			if (j < CodeSize && IsRetChainOp(fused[j]))
+			{
+				op.op = OP_RET_N;
+				numfused++;
+			}
+			i = j - 1;
+			continue;
+		}
+	}
+
+	if (numfused > 0)
+	{
+		FusedCode = (VMOP *)ClassDataAllocator.Alloc(CodeSize * sizeof(VMOP));
+		memcpy(FusedCode, &fused[0], CodeSize * sizeof(VMOP));
+	}
+}
+
 //===========================================================================
 //
 // VMFrame :: InitRegS
@@ -633,7 +731,22 @@ CCMD(vmengine)
 			VMSelectEngine(VMEngine_Unchecked);
 			return;
 		}
+		else if (stricmp(argv[1], "fused") == 0)
+		{
+			VMSelectEngine(VMEngine_Fused);
+			return;
+		}
+		else if (stricmp(argv[1], "jit") == 0)
+		{
+			VMSelectEngine(VMEngine_JIT);
+			return;
+		}
+		else if (stricmp(argv[1], "jitvalidate") == 0)
+		{
+			VMSelectEngine(VMEngine_JITValidate);
+			return;
+		}
 	}
-	Printf("Usage: vmengine <default|checked|unchecked>\n");
+	Printf("Usage: vmengine <default|checked|unchecked|fused|jit|jitvalidate>\n");
 }
 
@@ -423,11 +423,18 @@ enum EVMEngine
 {
 	VMEngine_Default,
 	VMEngine_Unchecked,
-	VMEngine_Checked
+	VMEngine_Checked,
+	VMEngine_Fused,
+	VMEngine_JIT,
+	VMEngine_JITValidate
 };
 
+typedef int (*VMExecFunc)(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret);
+typedef int (*VMJitFunc)(const VMRegisters *reg, VMReturn *ret, int numret);
+
 void VMSelectEngine(EVMEngine engine);
-extern int (*VMExec)(VMFrameStack *stack, const VMOP *pc, VMReturn *ret, int numret);
+bool VMJitSelected();
+extern VMExecFunc VMExec;
 void VMFillParams(VMValue *params, VMFrame *callee, int numparam);
 
 void VMDumpConstants(FILE *out, const VMScriptFunction *func);
@@ -445,6 +452,10 @@ public:
 	void Alloc(int numops, int numkonstd, int numkonstf, int numkonsts, int numkonsta, int numlinenumbers);
 
 	VMOP *Code;
+	VMOP *FusedCode;		// Code with superinstructions, same layout. Only used by the fused engine.
+	VMJitFunc JitFunc;		// Native code, or null if the function can only be interpreted
+	bool JitWritesMemory;
+	bool JitCompiled;		// VMJitCompile has run. Until then JitFunc is null.
 	FStatementInfo *LineInfo;
 	FString SourceFileName;
 	int *KonstD;
@@ -471,4 +482,10 @@ public:
 	void DestroyExtra(void *addr);
 	int AllocExtraStack(PType *type);
 	int PCToLine(const VMOP *pc);
+	void BuildFusedCode();
 };
+
+void VMJitCompile(VMScriptFunction *func);
+void VMJitCompileAll();
+int VMJitExec(VMFrameStack *stack, VMScriptFunction *sfunc, VMReturn *ret, int numret);
+int VMJitValidate(VMFrameStack *stack, VMScriptFunction *sfunc, VMReturn *ret, int numret, VMExecFunc interpreter);
@@ -0,0 +1,1154 @@
+/*
+** vmjit.cpp
+** Native x86-64 code generation for VM script functions
+**
+**---------------------------------------------------------------------------
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Only a subset of the instruction set is compiled: register moves,
+** integer and floating point arithmetic, field loads and stores with
+** constant offsets, comparisons, jumps and returns. Functions using
+** anything else (calls, strings, casts, ...) stay with the interpreter.
+**
+** Generated code never calls back into the engine. Script errors are
+** reported through the return value so that no C++ exception ever has
+** to unwind through a native frame.
+**
+*/
+
+#include <string.h>
+#include "dobject.h"
+#include "v_text.h"
+#include "cmdlib.h"
+#include "templates.h"
+#include "vmintern.h"
+#include "types.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HAVE_VM_JIT 1
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#else
+#define HAVE_VM_JIT 0
+#endif
+
+#if HAVE_VM_JIT
+
+namespace
+{
+
+enum
+{
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Registers holding the VM register file and return info for the whole function.
+// All of them are callee saved in both the SysV and the Win64 ABI.
+enum
+{
+	REGD = RBX,
+	REGF = R12,
+	REGA = R13,
+	RETS = R14,
+	NUMRET = R15
+};
+
+enum
+{
+	CC_P = 0xa,
+	CC_B = 2,
+	CC_AE = 3,
+	CC_E = 4,
+	CC_NE = 5,
+	CC_BE = 6,
+	CC_A = 7,
+	CC_L = 0xc,
+	CC_GE = 0xd,
+	CC_LE = 0xe,
+	CC_G = 0xf
+};
+
+//==========================================================================
+//
+// Machine code buffer with just the instruction forms the compiler needs.
+// Memory operands are always encoded as [base + disp32].
+//
+//==========================================================================
+
+class FJitAssembler
+{
+public:
+	TArray<uint8_t> Code;
+
+	int Pos() const { return Code.Size(); }
+
+	void Byte(int b)
+	{
+		Code.Push((uint8_t)b);
+	}
+
+	void Dword(int32_t d)
+	{
+		for (int i = 0; i < 4; i++) Byte((d >> (i * 8)) & 0xff);
+	}
+
+	void Qword(uint64_t q)
+	{
+		for (int i = 0; i < 8; i++) Byte((q >> (i * 8)) & 0xff);
+	}
+
+	void Patch(int pos, int target)
+	{
+		int32_t rel = target - (pos + 4);
+		memcpy(&Code[pos], &rel, 4);
+	}
+
+	// Two byte opcodes are passed as 0x0Fxx
+	void OpMem(int prefix, bool w, int opcode, int reg, int base, int32_t disp)
+	{
+		Prefix(prefix, w, reg, base, opcode);
+		Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+		if ((base & 7) == RSP) Byte(0x24);
+		Dword(disp);
+	}
+
+	void OpReg(int prefix, bool w, int opcode, int reg, int rm)
+	{
+		Prefix(prefix, w, reg, rm, opcode);
+		Byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+	}
+
+	void MovImm32(int reg, int32_t imm)
+	{
+		if (reg & 8) Byte(0x41);
+		Byte(0xb8 + (reg & 7));
+		Dword(imm);
+	}
+
+	void MovImm64(int reg, uint64_t imm)
+	{
+		Byte(0x48 | ((reg & 8) ? 1 : 0));
+		Byte(0xb8 + (reg & 7));
+		Qword(imm);
+	}
+
+	void Push(int reg)
+	{
+		if (reg & 8) Byte(0x41);
+		Byte(0x50 + (reg & 7));
+	}
+
+	void Pop(int reg)
+	{
+		if (reg & 8) Byte(0x41);
+		Byte(0x58 + (reg & 7));
+	}
+
+	// Returns the position of the displacement to patch
+	int Jmp()
+	{
+		Byte(0xe9);
+		Dword(0);
+		return Pos() - 4;
+	}
+
+	int Jcc(int cc)
+	{
+		Byte(0x0f);
+		Byte(0x80 | cc);
+		Dword(0);
+		return Pos() - 4;
+	}
+
+	void Bind(int patchpos)
+	{
+		Patch(patchpos, Pos());
+	}
+
+private:
+	void Prefix(int prefix, bool w, int reg, int rm, int opcode)
+	{
+		if (prefix) Byte(prefix);
+		int rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+		if (rex != 0x40) Byte(rex);
+		if (opcode > 0xff) Byte(opcode >> 8);
+		Byte(opcode & 0xff);
+	}
+};
+
+//==========================================================================
+//
+// Bytecode to machine code translation
+//
+//==========================================================================
+
+class FJitCompiler
+{
+public:
+	FJitCompiler(const VMScriptFunction *func) : WritesMemory(false), Func(func) {}
+
+	bool Compile();
+
+	FJitAssembler as;
+	bool WritesMemory;
+
+private:
+	struct FFixup
+	{
+		int PatchPos;
+		int Target;
+	};
+
+	bool EmitOp(int i);
+	void Prologue();
+	void Epilogue();
+
+	void VMJump(int target)
+	{
+		FFixup fix = { as.Jmp(), target };
+		Fixups.Push(fix);
+	}
+
+	void VMJcc(int cc, int target)
+	{
+		FFixup fix = { as.Jcc(cc), target };
+		Fixups.Push(fix);
+	}
+
+	void LoadD(int reg, bool konst, int index)
+	{
+		if (konst) as.MovImm32(reg, Func->KonstD[index]);
+		else as.OpMem(0, false, 0x8b, reg, REGD, index * 4);
+	}
+
+	void StoreD(int index, int reg)
+	{
+		as.OpMem(0, false, 0x89, reg, REGD, index * 4);
+	}
+
+	void LoadF(int xmm, bool konst, int index)
+	{
+		if (konst)
+		{
+			as.MovImm64(RAX, (uint64_t)(uintptr_t)&Func->KonstF[index]);
+			as.OpMem(0xf2, false, 0x0f10, xmm, RAX, 0);
+		}
+		else
+		{
+			as.OpMem(0xf2, false, 0x0f10, xmm, REGF, index * 8);
+		}
+	}
+
+	void StoreF(int index, int xmm)
+	{
+		as.OpMem(0xf2, false, 0x0f11, xmm, REGF, index * 8);
+	}
+
+	void LoadA(int reg, int index)
+	{
+		as.OpMem(0, true, 0x8b, reg, REGA, index * 8);
+	}
+
+	void StoreA(int index, int reg)
+	{
+		as.OpMem(0, true, 0x89, reg, REGA, index * 8);
+	}
+
+	// Loads pointer register aindex into RAX and bails out if it is null
+	void GetAddr(int aindex, bool write)
+	{
+		LoadA(RAX, aindex);
+		as.OpReg(0, true, 0x85, RAX, RAX);		// test rax, rax
+		(write ? WriteNilJumps : ReadNilJumps).Push(as.Jcc(CC_E));
+		if (write) WritesMemory = true;
+	}
+
+	// op eax, operand. aluop is the /r form, immop the /n for 81
+	void AluD(int a, int b, bool bk, int c, bool ck, int aluop, int immop)
+	{
+		LoadD(RAX, bk, b);
+		if (ck)
+		{
+			as.OpReg(0, false, 0x81, immop, RAX);
+			as.Dword(Func->KonstD[c]);
+		}
+		else
+		{
+			as.OpMem(0, false, aluop, RAX, REGD, c * 4);
+		}
+		StoreD(a, RAX);
+	}
+
+	void ShiftD(int a, int b, bool bk, int c, int shiftop)
+	{
+		LoadD(RAX, bk, b);
+		LoadD(RCX, false, c);
+		as.OpReg(0, false, 0xd3, shiftop, RAX);
+		StoreD(a, RAX);
+	}
+
+	void ShiftDImm(int a, int b, int c, int shiftop)
+	{
+		LoadD(RAX, false, b);
+		as.OpReg(0, false, 0xc1, shiftop, RAX);
+		as.Byte(c & 31);
+		StoreD(a, RAX);
+	}
+
+	void MinMaxD(int a, int b, int c, bool ck, int cmovcc)
+	{
+		LoadD(RAX, false, b);
+		LoadD(RCX, ck, c);
+		as.OpReg(0, false, 0x3b, RAX, RCX);				// cmp eax, ecx
+		as.OpReg(0, false, 0x0f40 | cmovcc, RAX, RCX);	// cmovcc eax, ecx
+		StoreD(a, RAX);
+	}
+
+	void ArithF(int a, int b, bool bk, int c, bool ck, int sseop)
+	{
+		LoadF(0, bk, b);
+		LoadF(1, ck, c);
+		as.OpReg(0xf2, false, sseop, 0, 1);
+		StoreF(a, 0);
+	}
+
+	bool CompareJump(int i, int cc);
+	bool CompareJumpF(int i, bool bk, int b, bool ck, int c, int cc);
+	bool Return(int i, int retnum, int regtype, int regnum);
+
+	const VMScriptFunction *Func;
+	TArray<int> InstrPos;
+	TArray<FFixup> Fixups;
+	TArray<int> ReadNilJumps;
+	TArray<int> WriteNilJumps;
+	TArray<int> ExitJumps;
+};
+
+//==========================================================================
+//
+// FJitCompiler :: Compile
+//
+// Returns false if the function uses anything the compiler can't handle.
+//
+//==========================================================================
+
+bool FJitCompiler::Compile()
+{
+	Prologue();
+
+	InstrPos.Resize(Func->CodeSize);
+	for (int i = 0; i < Func->CodeSize; i++)
+	{
+		InstrPos[i] = as.Pos();
+		if (!EmitOp(i))
+		{
+			return false;
+		}
+	}
+
+	// Running off the end can't happen in valid code, but don't execute garbage if it does.
+	as.OpReg(0, false, 0x33, RAX, RAX);
+	ExitJumps.Push(as.Jmp());
+
+	int readnil = as.Pos();
+	as.MovImm32(RAX, -X_READ_NIL);
+	ExitJumps.Push(as.Jmp());
+
+	int writenil = as.Pos();
+	as.MovImm32(RAX, -X_WRITE_NIL);
+
+	for (auto pos : ExitJumps) as.Bind(pos);
+	Epilogue();
+
+	for (auto pos : ReadNilJumps) as.Patch(pos, readnil);
+	for (auto pos : WriteNilJumps) as.Patch(pos, writenil);
+	for (auto &fix : Fixups)
+	{
+		if (fix.Target < 0 || fix.Target >= Func->CodeSize)
+		{
+			return false;
+		}
+		as.Patch(fix.PatchPos, InstrPos[fix.Target]);
+	}
+	return true;
+}
+
+void FJitCompiler::Prologue()
+{
+#ifdef _WIN32
+	const int arg0 = RCX, arg1 = RDX, arg2 = R8;
+#else
+	const int arg0 = RDI, arg1 = RSI, arg2 = RDX;
+#endif
+	as.Push(RBX);
+	as.Push(R12);
+	as.Push(R13);
+	as.Push(R14);
+	as.Push(R15);
+	// Keeps the stack 16 byte aligned and doubles as Win64 shadow space.
+	as.OpReg(0, true, 0x83, 5, RSP);	// sub rsp, 32
+	as.Byte(32);
+
+	as.OpMem(0, true, 0x8b, REGD, arg0, (int)offsetof(VMRegisters, d));
+	as.OpMem(0, true, 0x8b, REGF, arg0, (int)offsetof(VMRegisters, f));
+	as.OpMem(0, true, 0x8b, REGA, arg0, (int)offsetof(VMRegisters, a));
+	as.OpReg(0, true, 0x8b, RETS, arg1);
+	as.OpReg(0, false, 0x8b, NUMRET, arg2);
+}
+
+void FJitCompiler::Epilogue()
+{
+	as.OpReg(0, true, 0x83, 0, RSP);	// add rsp, 32
+	as.Byte(32);
+	as.Pop(R15);
+	as.Pop(R14);
+	as.Pop(R13);
+	as.Pop(R12);
+	as.Pop(RBX);
+	as.Byte(0xc3);
+}
+
+//==========================================================================
+//
+// Comparisons are always followed by a JMP that is taken when the result
+// of the test matches the CMP_CHECK bit. Otherwise the JMP is skipped.
+//
+//==========================================================================
+
+bool FJitCompiler::CompareJump(int i, int cc)
+{
+	const VMOP *pc = &Func->Code[i];
+	if (i + 1 >= Func->CodeSize || pc[1].op != OP_JMP)
+	{
+		return false;
+	}
+	int target = i + 2 + pc[1].i24;
+	VMJcc((pc->a & CMP_CHECK) ? cc : cc ^ 1, target);
+	VMJump(i + 2);
+	return true;
+}
+
+bool FJitCompiler::CompareJumpF(int i, bool bk, int b, bool ck, int c, int cc)
+{
+	const VMOP *pc = &Func->Code[i];
+	if (pc->a & CMP_APPROX)
+	{
+		return false;
+	}
+	if (i + 1 >= Func->CodeSize || pc[1].op != OP_JMP)
+	{
+		return false;
+	}
+	int target = i + 2 + pc[1].i24;
+
+	// ucomisd xmm0, xmm1 compares C against B. An unordered result sets ZF, PF and CF,
+	// so 'above' and 'above or equal' are false for NaNs just like in C.
+	LoadF(0, ck, c);
+	LoadF(1, bk, b);
+	as.OpReg(0x66, false, 0x0f2e, 0, 1);
+
+	bool check = !!(pc->a & CMP_CHECK);
+	if (cc == CC_E)
+	{
+		if (check)
+		{
+			int skip = as.Jcc(CC_P);
+			VMJcc(CC_E, target);
+			as.Bind(skip);
+		}
+		else
+		{
+			VMJcc(CC_P, target);
+			VMJcc(CC_NE, target);
+		}
+	}
+	else
+	{
+		VMJcc(check ? cc : cc ^ 1, target);
+	}
+	VMJump(i + 2);
+	return true;
+}
+
+//==========================================================================
+//
+// RET / RETI
+//
+//==========================================================================
+
+bool FJitCompiler::Return(int i, int retnum, int regtype, int regnum)
+{
+	const VMOP *pc = &Func->Code[i];
+	bool konst = !!(regtype & REGT_KONST);
+
+	if (regtype & REGT_MULTIREG)
+	{
+		return false;
+	}
+
+	// if (retnum < numret) *ret[retnum].Location = value
+	as.OpReg(0, false, 0x81, 7, NUMRET);
+	as.Dword(retnum);
+	int skip = as.Jcc(CC_LE);
+	as.OpMem(0, true, 0x8b, RAX, RETS, int(retnum * sizeof(VMReturn) + offsetof(VMReturn, Location)));
+	if (pc->op == OP_RETI)
+	{
+		as.MovImm32(RCX, pc->i16);
+		as.OpMem(0, false, 0x89, RCX, RAX, 0);
+	}
+	else
+	{
+		switch (regtype & REGT_TYPE)
+		{
+		case REGT_INT:
+			LoadD(RCX, konst, regnum);
+			as.OpMem(0, false, 0x89, RCX, RAX, 0);
+			break;
+
+		case REGT_FLOAT:
+			if (konst)
+			{
+				uint64_t bits;
+				memcpy(&bits, &Func->KonstF[regnum], 8);
+				as.MovImm64(RCX, bits);
+			}
+			else
+			{
+				as.OpMem(0, true, 0x8b, RCX, REGF, regnum * 8);
+			}
+			as.OpMem(0, true, 0x89, RCX, RAX, 0);
+			break;
+
+		case REGT_POINTER:
+			if (konst) as.MovImm64(RCX, (uint64_t)(uintptr_t)Func->KonstA[regnum].v);
+			else LoadA(RCX, regnum);
+			as.OpMem(0, true, 0x89, RCX, RAX, 0);
+			break;
+
+		default:
+			return false;
+		}
+	}
+	as.Bind(skip);
+
+	if (pc->a & RET_FINAL)
+	{
+		// return min(retnum + 1, numret)
+		as.MovImm32(RAX, retnum + 1);
+		as.OpReg(0, false, 0x3b, NUMRET, RAX);		// cmp r15d, eax
+		as.OpReg(0, false, 0x0f4c, RAX, NUMRET);		// cmovl eax, r15d
+		ExitJumps.Push(as.Jmp());
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// FJitCompiler :: EmitOp
+//
+//==========================================================================
+
+bool FJitCompiler::EmitOp(int i)
+{
+	const VMOP *pc = &Func->Code[i];
+	const int a = pc->a;
+	const int B = pc->b;
+	const int C = pc->c;
+
+	switch (pc->op)
+	{
+	case OP_NOP:
+		break;
+
+	// Constants and moves
+	case OP_LI:
+		as.OpMem(0, false, 0xc7, 0, REGD, a * 4);
+		as.Dword(pc->i16);
+		break;
+	case OP_LK:
+		as.OpMem(0, false, 0xc7, 0, REGD, a * 4);
+		as.Dword(Func->KonstD[pc->i16u]);
+		break;
+	case OP_LKF:
+	{
+		uint64_t bits;
+		memcpy(&bits, &Func->KonstF[pc->i16u], 8);
+		as.MovImm64(RAX, bits);
+		as.OpMem(0, true, 0x89, RAX, REGF, a * 8);
+		break;
+	}
+	case OP_LKP:
+		as.MovImm64(RAX, (uint64_t)(uintptr_t)Func->KonstA[pc->i16u].v);
+		StoreA(a, RAX);
+		break;
+	case OP_MOVE:
+		LoadD(RAX, false, B);
+		StoreD(a, RAX);
+		break;
+	case OP_MOVEF:
+	case OP_MOVEV2:
+	case OP_MOVEV3:
+	{
+		int count = pc->op == OP_MOVEF ? 1 : pc->op == OP_MOVEV2 ? 2 : 3;
+		for (int j = 0; j < count; j++)
+		{
+			as.OpMem(0, true, 0x8b, RAX, REGF, (B + j) * 8);
+			as.OpMem(0, true, 0x89, RAX, REGF, (a + j) * 8);
+		}
+		break;
+	}
+	case OP_MOVEA:
+		LoadA(RAX, B);
+		StoreA(a, RAX);
+		break;
+
+	// Loads with a constant offset. rA = *(pB + kC)
+	case OP_LB:
+	case OP_LH:
+	case OP_LW:
+	case OP_LBU:
+	case OP_LHU:
+	{
+		static const int loadops[] = { 0x0fbe, 0x0fbf, 0x8b, 0x0fb6, 0x0fb7 };
+		int index = pc->op == OP_LB ? 0 : pc->op == OP_LH ? 1 : pc->op == OP_LW ? 2 : pc->op == OP_LBU ? 3 : 4;
+		GetAddr(B, false);
+		as.OpMem(0, false, loadops[index], RCX, RAX, Func->KonstD[C]);
+		StoreD(a, RCX);
+		break;
+	}
+	case OP_LSP:
+		GetAddr(B, false);
+		as.OpMem(0xf3, false, 0x0f5a, 0, RAX, Func->KonstD[C]);	// cvtss2sd xmm0, [rax + kC]
+		StoreF(a, 0);
+		break;
+	case OP_LDP:
+	case OP_LV2:
+	case OP_LV3:
+	{
+		int count = pc->op == OP_LDP ? 1 : pc->op == OP_LV2 ? 2 : 3;
+		GetAddr(B, false);
+		for (int j = 0; j < count; j++)
+		{
+			as.OpMem(0, true, 0x8b, RCX, RAX, Func->KonstD[C] + j * 8);
+			as.OpMem(0, true, 0x89, RCX, REGF, (a + j) * 8);
+		}
+		break;
+	}
+	case OP_LP:
+		GetAddr(B, false);
+		as.OpMem(0, true, 0x8b, RCX, RAX, Func->KonstD[C]);
+		StoreA(a, RCX);
+		break;
+	case OP_LO:
+	{
+		// Same as GC::ReadBarrier: a dying object reads as null and the field gets cleared.
+		GetAddr(B, false);
+		as.OpMem(0, true, 0x8b, RCX, RAX, Func->KonstD[C]);
+		as.OpReg(0, true, 0x85, RCX, RCX);
+		int isnull = as.Jcc(CC_E);
+		as.OpMem(0, false, 0xf7, 0, RCX, (int)myoffsetof(DObject, ObjectFlags));	// test dword [rcx + flags], imm
+		as.Dword(OF_EuthanizeMe);
+		int alive = as.Jcc(CC_E);
+		as.OpReg(0, false, 0x33, RCX, RCX);
+		as.OpMem(0, true, 0x89, RCX, RAX, Func->KonstD[C]);
+		as.Bind(isnull);
+		as.Bind(alive);
+		StoreA(a, RCX);
+		break;
+	}
+	case OP_LBIT:
+		GetAddr(B, false);
+		as.OpMem(0, false, 0x0fb6, RCX, RAX, 0);		// movzx ecx, byte [rax]
+		as.OpReg(0, false, 0xf7, 0, RCX);				// test ecx, C
+		as.Dword(C);
+		as.OpReg(0, false, 0x0f95, 0, RCX);				// setne cl
+		as.OpReg(0, false, 0x0fb6, RCX, RCX);			// movzx ecx, cl
+		StoreD(a, RCX);
+		break;
+
+	// Stores with a constant offset. *(pA + kC) = rB
+	case OP_SB:
+		GetAddr(a, true);
+		LoadD(RCX, false, B);
+		as.OpMem(0, false, 0x88, RCX, RAX, Func->KonstD[C]);
+		break;
+	case OP_SH:
+		GetAddr(a, true);
+		LoadD(RCX, false, B);
+		as.OpMem(0x66, false, 0x89, RCX, RAX, Func->KonstD[C]);
+		break;
+	case OP_SW:
+		GetAddr(a, true);
+		LoadD(RCX, false, B);
+		as.OpMem(0, false, 0x89, RCX, RAX, Func->KonstD[C]);
+		break;
+	case OP_SSP:
+		GetAddr(a, true);
+		as.OpMem(0xf2, false, 0x0f5a, 0, REGF, B * 8);			// cvtsd2ss xmm0, [fB]
+		as.OpMem(0xf3, false, 0x0f11, 0, RAX, Func->KonstD[C]);	// movss [rax + kC], xmm0
+		break;
+	case OP_SDP:
+	case OP_SV2:
+	case OP_SV3:
+	{
+		int count = pc->op == OP_SDP ? 1 : pc->op == OP_SV2 ? 2 : 3;
+		GetAddr(a, true);
+		for (int j = 0; j < count; j++)
+		{
+			as.OpMem(0, true, 0x8b, RCX, REGF, (B + j) * 8);
+			as.OpMem(0, true, 0x89, RCX, RAX, Func->KonstD[C] + j * 8);
+		}
+		break;
+	}
+	case OP_SP:
+		GetAddr(a, true);
+		LoadA(RCX, B);
+		as.OpMem(0, true, 0x89, RCX, RAX, Func->KonstD[C]);
+		break;
+	case OP_SBIT:
+	{
+		GetAddr(a, true);
+		as.OpMem(0, false, 0x81, 7, REGD, B * 4);		// cmp dword [dB], 0
+		as.Dword(0);
+		int clear = as.Jcc(CC_E);
+		as.OpMem(0, false, 0x80, 1, RAX, 0);			// or byte [rax], C
+		as.Byte(C);
+		int done = as.Jmp();
+		as.Bind(clear);
+		as.OpMem(0, false, 0x80, 4, RAX, 0);			// and byte [rax], ~C
+		as.Byte(~C);
+		as.Bind(done);
+		break;
+	}
+
+	// Integer math
+	case OP_ADD_RR:	AluD(a, B, false, C, false, 0x03, 0); break;
+	case OP_ADD_RK:	AluD(a, B, false, C, true, 0x03, 0); break;
+	case OP_ADDI:
+		LoadD(RAX, false, B);
+		as.OpReg(0, false, 0x81, 0, RAX);
+		as.Dword(pc->cs);
+		StoreD(a, RAX);
+		break;
+	case OP_SUB_RR:	AluD(a, B, false, C, false, 0x2b, 5); break;
+	case OP_SUB_RK:	AluD(a, B, false, C, true, 0x2b, 5); break;
+	case OP_SUB_KR:	AluD(a, B, true, C, false, 0x2b, 5); break;
+	case OP_AND_RR:	AluD(a, B, false, C, false, 0x23, 4); break;
+	case OP_AND_RK:	AluD(a, B, false, C, true, 0x23, 4); break;
+	case OP_OR_RR:	AluD(a, B, false, C, false, 0x0b, 1); break;
+	case OP_OR_RK:	AluD(a, B, false, C, true, 0x0b, 1); break;
+	case OP_XOR_RR:	AluD(a, B, false, C, false, 0x33, 6); break;
+	case OP_XOR_RK:	AluD(a, B, false, C, true, 0x33, 6); break;
+	case OP_MUL_RR:
+		LoadD(RAX, false, B);
+		as.OpMem(0, false, 0x0faf, RAX, REGD, C * 4);	// imul eax, [dC]
+		StoreD(a, RAX);
+		break;
+	case OP_MUL_RK:
+		LoadD(RAX, false, B);
+		as.OpReg(0, false, 0x69, RAX, RAX);				// imul eax, eax, kC
+		as.Dword(Func->KonstD[C]);
+		StoreD(a, RAX);
+		break;
+	case OP_MIN_RR:	MinMaxD(a, B, C, false, CC_G); break;
+	case OP_MIN_RK:	MinMaxD(a, B, C, true, CC_G); break;
+	case OP_MAX_RR:	MinMaxD(a, B, C, false, CC_L); break;
+	case OP_MAX_RK:	MinMaxD(a, B, C, true, CC_L); break;
+	case OP_NEG:
+	case OP_NOT:
+		LoadD(RAX, false, B);
+		as.OpReg(0, false, 0xf7, pc->op == OP_NEG ? 3 : 2, RAX);
+		StoreD(a, RAX);
+		break;
+	case OP_SLL_RR:	ShiftD(a, B, false, C, 4); break;
+	case OP_SLL_KR:	ShiftD(a, B, true, C, 4); break;
+	case OP_SLL_RI:	ShiftDImm(a, B, C, 4); break;
+	case OP_SRL_RR:	ShiftD(a, B, false, C, 5); break;
+	case OP_SRL_RI:	ShiftDImm(a, B, C, 5); break;
+	case OP_SRA_RR:	ShiftD(a, B, false, C, 7); break;
+	case OP_SRA_KR:	ShiftD(a, B, true, C, 7); break;
+	case OP_SRA_RI:	ShiftDImm(a, B, C, 7); break;
+
+	// Floating point math
+	case OP_ADDF_RR: ArithF(a, B, false, C, false, 0x0f58); break;
+	case OP_ADDF_RK: ArithF(a, B, false, C, true, 0x0f58); break;
+	case OP_SUBF_RR: ArithF(a, B, false, C, false, 0x0f5c); break;
+	case OP_SUBF_RK: ArithF(a, B, false, C, true, 0x0f5c); break;
+	case OP_SUBF_KR: ArithF(a, B, true, C, false, 0x0f5c); break;
+	case OP_MULF_RR: ArithF(a, B, false, C, false, 0x0f59); break;
+	case OP_MULF_RK: ArithF(a, B, false, C, true, 0x0f59); break;
+	case OP_DIVF_RK:
+		// Division by a register needs the zero check and is left to the interpreter.
+		if (Func->KonstF[C] == 0.)
+		{
+			return false;
+		}
+		ArithF(a, B, false, C, true, 0x0f5e);
+		break;
+	case OP_FLOP:
+		if (C != FLOP_NEG && C != FLOP_ABS)
+		{
+			return false;
+		}
+		as.OpMem(0, true, 0x8b, RAX, REGF, B * 8);
+		as.OpReg(0, true, 0x0fba, C == FLOP_NEG ? 7 : 6, RAX);	// btc/btr rax, 63
+		as.Byte(63);
+		as.OpMem(0, true, 0x89, RAX, REGF, a * 8);
+		break;
+
+	// Control flow
+	case OP_JMP:
+		VMJump(i + 1 + pc->i24);
+		break;
+	case OP_TEST:
+	case OP_TESTN:
+		// Skip the next instruction if the test fails
+		LoadD(RAX, false, a);
+		if (pc->op == OP_TESTN) as.OpReg(0, false, 0xf7, 3, RAX);
+		as.OpReg(0, false, 0x81, 7, RAX);
+		as.Dword(pc->i16u);
+		VMJcc(CC_NE, i + 2);
+		break;
+
+	case OP_EQ_R:
+	case OP_EQ_K:
+	case OP_LT_RR:
+	case OP_LT_RK:
+	case OP_LT_KR:
+	case OP_LE_RR:
+	case OP_LE_RK:
+	case OP_LE_KR:
+	case OP_LTU_RR:
+	case OP_LTU_RK:
+	case OP_LTU_KR:
+	case OP_LEU_RR:
+	case OP_LEU_RK:
+	case OP_LEU_KR:
+	{
+		int op = pc->op;
+		bool bk = op == OP_LT_KR || op == OP_LE_KR || op == OP_LTU_KR || op == OP_LEU_KR;
+		bool ck = op == OP_EQ_K || op == OP_LT_RK || op == OP_LE_RK || op == OP_LTU_RK || op == OP_LEU_RK;
+		int cc =
+			(op == OP_EQ_R || op == OP_EQ_K) ? CC_E :
+			(op == OP_LT_RR || op == OP_LT_RK || op == OP_LT_KR) ? CC_L :
+			(op == OP_LE_RR || op == OP_LE_RK || op == OP_LE_KR) ? CC_LE :
+			(op == OP_LTU_RR || op == OP_LTU_RK || op == OP_LTU_KR) ? CC_B : CC_BE;
+
+		LoadD(RAX, bk, B);
+		if (ck)
+		{
+			as.OpReg(0, false, 0x81, 7, RAX);
+			as.Dword(Func->KonstD[C]);
+		}
+		else
+		{
+			as.OpMem(0, false, 0x3b, RAX, REGD, C * 4);
+		}
+		return CompareJump(i, cc);
+	}
+
+	case OP_EQF_R:	return CompareJumpF(i, false, B, false, C, CC_E);
+	case OP_EQF_K:	return CompareJumpF(i, false, B, true, C, CC_E);
+	case OP_LTF_RR:	return CompareJumpF(i, false, B, false, C, CC_A);
+	case OP_LTF_RK:	return CompareJumpF(i, false, B, true, C, CC_A);
+	case OP_LTF_KR:	return CompareJumpF(i, true, B, false, C, CC_A);
+	case OP_LEF_RR:	return CompareJumpF(i, false, B, false, C, CC_AE);
+	case OP_LEF_RK:	return CompareJumpF(i, false, B, true, C, CC_AE);
+	case OP_LEF_KR:	return CompareJumpF(i, true, B, false, C, CC_AE);
+
+	case OP_EQA_R:
+	case OP_EQA_K:
+		LoadA(RAX, B);
+		if (pc->op == OP_EQA_K) as.MovImm64(RCX, (uint64_t)(uintptr_t)Func->KonstA[C].v);
+		else LoadA(RCX, C);
+		as.OpReg(0, true, 0x3b, RAX, RCX);
+		return CompareJump(i, CC_E);
+
+	case OP_RET:
+		if (B == REGT_NIL)
+		{
+			as.OpReg(0, false, 0x33, RAX, RAX);
+			ExitJumps.Push(as.Jmp());
+			break;
+		}
+		return Return(i, a & ~RET_FINAL, B, C);
+	case OP_RETI:
+		return Return(i, a & ~RET_FINAL, REGT_INT, 0);
+
+	default:
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// Executable memory. Code is never freed, same as the bytecode.
+//
+//==========================================================================
+
+uint8_t *CodeBlock;
+size_t CodeBlockPos, CodeBlockSize;
+
+void *AllocJitCode(const TArray<uint8_t> &code)
+{
+	size_t size = (code.Size() + 15) & ~15;
+	if (CodeBlock == nullptr || CodeBlockPos + size > CodeBlockSize)
+	{
+		size_t blocksize = MAX<size_t>(size, 1024 * 1024);
+#ifdef _WIN32
+		CodeBlock = (uint8_t *)VirtualAlloc(nullptr, blocksize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+		CodeBlock = (uint8_t *)mmap(nullptr, blocksize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (CodeBlock == MAP_FAILED) CodeBlock = nullptr;
+#endif
+		if (CodeBlock == nullptr)
+		{
+			return nullptr;
+		}
+		CodeBlockPos = 0;
+		CodeBlockSize = blocksize;
+	}
+
+	// Functions are only compiled while scripts are loaded, never while any of them runs,
+	// so the block can be made writable again for a moment.
+	uint8_t *dest = CodeBlock + CodeBlockPos;
+#ifdef _WIN32
+	DWORD oldprotect;
+	VirtualProtect(CodeBlock, CodeBlockSize, PAGE_READWRITE, &oldprotect);
+	memcpy(dest, &code[0], code.Size());
+	VirtualProtect(CodeBlock, CodeBlockSize, PAGE_EXECUTE_READ, &oldprotect);
+	FlushInstructionCache(GetCurrentProcess(), dest, code.Size());
+#else
+	mprotect(CodeBlock, CodeBlockSize, PROT_READ | PROT_WRITE);
+	memcpy(dest, &code[0], code.Size());
+	mprotect(CodeBlock, CodeBlockSize, PROT_READ | PROT_EXEC);
+#endif
+	CodeBlockPos += size;
+	return dest;
+}
+
+}
+
+#endif
+
+//==========================================================================
+//
+// VMJitCompile
+//
+// Called for a function when it is built while a JIT engine is selected,
+// or when such an engine gets selected later. Functions that can't be
+// compiled keep a null JitFunc and run in the interpreter.
+//
+//==========================================================================
+
+void VMJitCompile(VMScriptFunction *func)
+{
+	func->JitFunc = nullptr;
+	func->JitWritesMemory = false;
+	func->JitCompiled = true;
+
+#if HAVE_VM_JIT
+	FJitCompiler compiler(func);
+	if (compiler.Compile())
+	{
+		func->JitFunc = (VMJitFunc)AllocJitCode(compiler.as.Code);
+		func->JitWritesMemory = compiler.WritesMemory;
+	}
+#endif
+}
+
+//==========================================================================
+//
+// VMJitCompileAll
+//
+// Compiles every function that has been built so far. The ones built
+// later are compiled by the code generator.
+//
+//==========================================================================
+
+void VMJitCompileAll()
+{
+	for (auto func : VMFunction::AllFunctions)
+	{
+		if (func->VarFlags & VARF_Native)
+			continue;
+
+		auto sfunc = static_cast<VMScriptFunction *>(func);
+		if (!sfunc->JitCompiled && sfunc->Code != nullptr)
+		{
+			VMJitCompile(sfunc);
+		}
+	}
+}
+
+//==========================================================================
+//
+// VMJitExec
+//
+// Runs the native version of the function in the top frame.
+//
+//==========================================================================
+
+int VMJitExec(VMFrameStack *stack, VMScriptFunction *sfunc, VMReturn *ret, int numret)
+{
+	const VMRegisters reg(stack->TopFrame());
+	int result = sfunc->JitFunc(&reg, ret, numret);
+	if (result < 0)
+	{
+		ThrowAbortException(EVMAbortException(-result), nullptr);
+	}
+	return result;
+}
+
+//==========================================================================
+//
+// VMJitValidate
+//
+// Runs the native code on a copy of the registers, then the interpreter
+// on the real ones, and reports any difference in the results. The
+// interpreter's results are the ones that get used. Functions writing to
+// memory can't be run twice and are only interpreted.
+//
+//==========================================================================
+
+static void JitMismatch(VMScriptFunction *sfunc, const char *fmt, ...)
+{
+	static TMap<VMScriptFunction *, bool> reported;
+
+	if (reported.CheckKey(sfunc) != nullptr)
+	{
+		return;
+	}
+	reported[sfunc] = true;
+
+	FString msg;
+	va_list ap;
+	va_start(ap, fmt);
+	msg.VFormat(fmt, ap);
+	va_end(ap);
+	Printf(TEXTCOLOR_RED "JIT mismatch in %s: %s\n", sfunc->PrintableName.GetChars(), msg.GetChars());
+}
+
+static size_t ReturnSize(int regtype)
+{
+	switch (regtype & REGT_TYPE)
+	{
+	case REGT_INT:		return sizeof(int);
+	case REGT_FLOAT:	return sizeof(double) * ((regtype & REGT_MULTIREG3) ? 3 : (regtype & REGT_MULTIREG2) ? 2 : 1);
+	case REGT_POINTER:	return sizeof(void *);
+	default:			return 0;
+	}
+}
+
+int VMJitValidate(VMFrameStack *stack, VMScriptFunction *sfunc, VMReturn *ret, int numret, VMExecFunc interpreter)
+{
+	if (sfunc->JitWritesMemory)
+	{
+		return interpreter(stack, sfunc->Code, ret, numret);
+	}
+
+	VMFrame *f = stack->TopFrame();
+	const VMRegisters reg(f);
+
+	// One spare element so that none of these is ever empty
+	TArray<int> jitd(f->NumRegD + 1);
+	TArray<double> jitf(f->NumRegF + 1);
+	TArray<void *> jita(f->NumRegA + 1);
+	jitd.Resize(f->NumRegD + 1);
+	jitf.Resize(f->NumRegF + 1);
+	jita.Resize(f->NumRegA + 1);
+	memcpy(&jitd[0], reg.d, f->NumRegD * sizeof(int));
+	memcpy(&jitf[0], reg.f, f->NumRegF * sizeof(double));
+	memcpy(&jita[0], reg.a, f->NumRegA * sizeof(void *));
+
+	VMRegisters jitreg(reg);
+	jitreg.d = &jitd[0];
+	jitreg.f = &jitf[0];
+	jitreg.a = &jita[0];
+
+	double jitretvals[MAX_RETURNS][3];
+	VMReturn jitret[MAX_RETURNS];
+	assert(numret <= MAX_RETURNS);
+	for (int i = 0; i < numret; i++)
+	{
+		jitret[i].Location = jitretvals[i];
+		jitret[i].RegType = ret[i].RegType;
+	}
+
+	int jitresult = sfunc->JitFunc(&jitreg, jitret, numret);
+	int result;
+	try
+	{
+		result = interpreter(stack, sfunc->Code, ret, numret);
+	}
+	catch (...)
+	{
+		if (jitresult >= 0)
+		{
+			JitMismatch(sfunc, "the interpreter aborted, native code returned %d", jitresult);
+		}
+		throw;
+	}
+
+	if (jitresult < 0)
+	{
+		JitMismatch(sfunc, "native code aborted with error %d, the interpreter returned %d", -jitresult, result);
+	}
+	else if (jitresult != result)
+	{
+		JitMismatch(sfunc, "returned %d values instead of %d", jitresult, result);
+	}
+	else if (memcmp(&jitd[0], reg.d, f->NumRegD * sizeof(int)) != 0)
+	{
+		JitMismatch(sfunc, "integer registers differ");
+	}
+	else if (memcmp(&jitf[0], reg.f, f->NumRegF * sizeof(double)) != 0)
+	{
+		JitMismatch(sfunc, "float registers differ");
+	}
+	else if (memcmp(&jita[0], reg.a, f->NumRegA * sizeof(void *)) != 0)
+	{
+		JitMismatch(sfunc, "pointer registers differ");
+	}
+	else
+	{
+		for (int i = 0; i < result; i++)
+		{
+			if (memcmp(jitret[i].Location, ret[i].Location, ReturnSize(ret[i].RegType)) != 0)
+			{
+				JitMismatch(sfunc, "return value %d differs", i);
+				break;
+			}
+		}
+	}
+	return result;
+}
@@ -255,4 +255,18 @@ xx(SUBA,		sub,	RIRPRP,		NOP,	0, 0),		// dA = pB - pC
 xx(EQA_R,		beq,	CPRR,		NOP,	0, 0),			// if ((pB == pkC) != A) then pc++
 xx(EQA_K,		beq,	CPRK,		EQA_R,	4, REGT_POINTER),
 
+// Superinstructions. These are never emitted by the code generator. VMScriptFunction::BuildFusedCode
+// substitutes them for the first instruction of a matching sequence and leaves the rest of the
+// sequence in place, so jumps into the middle of it and the line number table stay valid.
+xx(LW_EQ_K,		lw,		RIRPKI,		NOP,	0, 0),		// LW + EQ_K + JMP
+xx(LW_LT_RK,	lw,		RIRPKI,		NOP,	0, 0),		// LW + LT_RK + JMP
+xx(LW_LT_KR,	lw,		RIRPKI,		NOP,	0, 0),		// LW + LT_KR + JMP
+xx(LW_LE_RK,	lw,		RIRPKI,		NOP,	0, 0),		// LW + LE_RK + JMP
+xx(LW_LE_KR,	lw,		RIRPKI,		NOP,	0, 0),		// LW + LE_KR + JMP
+xx(LBU_EQ_K,	lbu,	RIRPKI,		NOP,	0, 0),		// LBU + EQ_K + JMP
+xx(LO_EQA_K,	lo,		RPRPKI,		NOP,	0, 0),		// LO + EQA_K + JMP
+xx(LP_EQA_K,	lp,		RPRPKI,		NOP,	0, 0),		// LP + EQA_K + JMP
+xx(PARAM_CALL,	param,	__BCP,		NOP,	0, 0),		// PARAM + any number of PARAM/PARAMI + CALL/CALL_K
+xx(RET_N,		ret,	I8BCP,		NOP,	0, 0),		// chain of RET/RETI up to the one with RET_FINAL set
+
 #undef xx
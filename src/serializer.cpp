@@ -65,6 +65,10 @@
 #include "v_text.h"
 #include "cmdlib.h"
 #include "g_levellocals.h"
+#include "p_saveg.h"
+#include "stats.h"
+#include "version.h"
+#include "doomstat.h"
 
 char nulspace[1024 * 1024 * 4];
 bool save_full = false;	// for testing. Should be removed afterward.
@@ -229,6 +233,343 @@ struct FJSONObject
 	}
 };
 
+//==========================================================================
+//
+// Binary savegame format
+//
+// Holds the same tree as the JSON output so that reading it only needs to
+// rebuild the JSON document. Every value starts with a tag byte. Integers
+// are varints (zigzag encoded if signed), doubles are stored as their raw
+// 8 bytes and every object key is spelled out only once. After that it is
+// referenced by its index in the key table, which for the most common
+// keys fits into the tag byte.
+//
+//==========================================================================
+
+enum EBinaryTag
+{
+	BT_Null,
+	BT_False,
+	BT_True,
+	BT_Int,
+	BT_Int64,
+	BT_Uint,
+	BT_Uint64,
+	BT_Double,
+	BT_String,
+	BT_StartObject,
+	BT_EndObject,
+	BT_StartArray,
+	BT_EndArray,
+	BT_NewKey,			// followed by the key's length and characters
+	BT_Key,				// followed by the key's index
+	BT_ShortKey = 64,	// the key's index is tag - BT_ShortKey
+};
+
+static const char BinaryMagic[4] = { 'Z', 'S', 'B', 1 };
+
+class FBinaryWriter
+{
+	rapidjson::StringBuffer &mOut;
+	TArray<char> mKeyChars;
+	TArray<unsigned> mKeyStart;		// into mKeyChars, with an end marker
+	TArray<int> mKeyHash;			// open addressing, -1 for unused buckets
+
+	void PutVarint(uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			mOut.Put(char(v | 0x80));
+			v >>= 7;
+		}
+		mOut.Put(char(v));
+	}
+
+	void PutZigZag(int64_t v)
+	{
+		PutVarint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+	}
+
+	void PutBytes(const char *p, size_t len)
+	{
+		memcpy(mOut.Push(len), p, len);
+	}
+
+	static unsigned HashKey(const char *k, size_t len)
+	{
+		unsigned hash = 2166136261u;
+		for (size_t i = 0; i < len; i++) hash = (hash ^ (uint8_t)k[i]) * 16777619u;
+		return hash;
+	}
+
+	int FindKey(const char *k, size_t len, unsigned hash) const
+	{
+		unsigned mask = mKeyHash.Size() - 1;
+		for (unsigned i = hash & mask; mKeyHash[i] >= 0; i = (i + 1) & mask)
+		{
+			int index = mKeyHash[i];
+			if (mKeyStart[index + 1] - mKeyStart[index] == len && !memcmp(&mKeyChars[mKeyStart[index]], k, len))
+			{
+				return index;
+			}
+		}
+		return -1;
+	}
+
+	void InsertKey(int index, unsigned hash)
+	{
+		unsigned mask = mKeyHash.Size() - 1;
+		unsigned i = hash & mask;
+		while (mKeyHash[i] >= 0) i = (i + 1) & mask;
+		mKeyHash[i] = index;
+	}
+
+	int AddKey(const char *k, size_t len, unsigned hash)
+	{
+		int index = mKeyStart.Size() - 1;
+		if (len > 0) memcpy(&mKeyChars[mKeyChars.Reserve(len)], k, len);
+		mKeyStart.Push(mKeyChars.Size());
+
+		if ((unsigned)index * 2 >= mKeyHash.Size())
+		{
+			mKeyHash.Resize(mKeyHash.Size() * 2);
+			for (auto &bucket : mKeyHash) bucket = -1;
+			for (int i = 0; i <= index; i++)
+			{
+				InsertKey(i, HashKey(&mKeyChars[mKeyStart[i]], mKeyStart[i + 1] - mKeyStart[i]));
+			}
+		}
+		else
+		{
+			InsertKey(index, hash);
+		}
+		return index;
+	}
+
+public:
+	FBinaryWriter(rapidjson::StringBuffer &out) : mOut(out)
+	{
+		PutBytes(BinaryMagic, sizeof(BinaryMagic));
+		mKeyStart.Push(0);
+		mKeyHash.Resize(256);
+		for (auto &bucket : mKeyHash) bucket = -1;
+	}
+
+	void StartObject() { mOut.Put(BT_StartObject); }
+	void EndObject() { mOut.Put(BT_EndObject); }
+	void StartArray() { mOut.Put(BT_StartArray); }
+	void EndArray() { mOut.Put(BT_EndArray); }
+	void Null() { mOut.Put(BT_Null); }
+	void Bool(bool k) { mOut.Put(k ? BT_True : BT_False); }
+	void Int(int32_t k) { mOut.Put(BT_Int); PutZigZag(k); }
+	void Int64(int64_t k) { mOut.Put(BT_Int64); PutZigZag(k); }
+	void Uint(uint32_t k) { mOut.Put(BT_Uint); PutVarint(k); }
+	void Uint64(uint64_t k) { mOut.Put(BT_Uint64); PutVarint(k); }
+
+	void Double(double k)
+	{
+		uint64_t bits;
+		memcpy(&bits, &k, sizeof(bits));
+		mOut.Put(BT_Double);
+		char *p = mOut.Push(8);
+		for (int i = 0; i < 8; i++) p[i] = char(bits >> (i * 8));
+	}
+
+	void String(const char *k)
+	{
+		size_t len = strlen(k);
+		mOut.Put(BT_String);
+		PutVarint(len);
+		PutBytes(k, len);
+	}
+
+	void Key(const char *k)
+	{
+		size_t len = strlen(k);
+		unsigned hash = HashKey(k, len);
+		int index = FindKey(k, len, hash);
+		if (index < 0)
+		{
+			AddKey(k, len, hash);
+			mOut.Put(BT_NewKey);
+			PutVarint(len);
+			PutBytes(k, len);
+		}
+		else if (index < 256 - BT_ShortKey)
+		{
+			mOut.Put(char(BT_ShortKey + index));
+		}
+		else
+		{
+			mOut.Put(BT_Key);
+			PutVarint(index);
+		}
+	}
+};
+
+//==========================================================================
+//
+// Turns binary data back into the JSON document.
+// This is a generator for rapidjson::Document::Populate.
+//
+//==========================================================================
+
+class FBinaryReader
+{
+	const uint8_t *mPos, *mEnd;
+	TArray<const char *> mKeys;
+	TArray<unsigned> mKeyLengths;
+
+	bool GetVarint(uint64_t &v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64 && mPos < mEnd; shift += 7)
+		{
+			uint8_t b = *mPos++;
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) return true;
+		}
+		return false;
+	}
+
+	bool GetZigZag(int64_t &v)
+	{
+		uint64_t u;
+		if (!GetVarint(u)) return false;
+		v = int64_t(u >> 1) ^ -int64_t(u & 1);
+		return true;
+	}
+
+	bool GetChars(const char *&p, unsigned &len)
+	{
+		uint64_t l;
+		if (!GetVarint(l) || l > uint64_t(mEnd - mPos)) return false;
+		p = (const char *)mPos;
+		len = unsigned(l);
+		mPos += len;
+		return true;
+	}
+
+	template<class Handler>
+	bool ReadKey(Handler &h, int tag)
+	{
+		uint64_t index;
+		if (tag == BT_NewKey)
+		{
+			const char *p;
+			unsigned len;
+			if (!GetChars(p, len)) return false;
+			mKeys.Push(p);
+			mKeyLengths.Push(len);
+			return h.Key(p, len, true);
+		}
+		else if (tag == BT_Key)
+		{
+			if (!GetVarint(index)) return false;
+		}
+		else if (tag >= BT_ShortKey)
+		{
+			index = tag - BT_ShortKey;
+		}
+		else return false;
+
+		if (index >= mKeys.Size()) return false;
+		return h.Key(mKeys[index], mKeyLengths[index], true);
+	}
+
+	template<class Handler>
+	bool ReadValue(Handler &h, int tag)
+	{
+		int64_t i;
+		uint64_t u;
+
+		switch (tag)
+		{
+		case BT_Null:
+			return h.Null();
+
+		case BT_False:
+		case BT_True:
+			return h.Bool(tag == BT_True);
+
+		case BT_Int:
+			return GetZigZag(i) && h.Int(int(i));
+
+		case BT_Int64:
+			return GetZigZag(i) && h.Int64(i);
+
+		case BT_Uint:
+			return GetVarint(u) && h.Uint(unsigned(u));
+
+		case BT_Uint64:
+			return GetVarint(u) && h.Uint64(u);
+
+		case BT_Double:
+		{
+			if (mEnd - mPos < 8) return false;
+			u = 0;
+			for (int b = 0; b < 8; b++) u |= uint64_t(mPos[b]) << (b * 8);
+			mPos += 8;
+			double d;
+			memcpy(&d, &u, sizeof(d));
+			return h.Double(d);
+		}
+
+		case BT_String:
+		{
+			const char *p;
+			unsigned len;
+			return GetChars(p, len) && h.String(p, len, true);
+		}
+
+		case BT_StartObject:
+		{
+			unsigned count = 0;
+			if (!h.StartObject()) return false;
+			while (mPos < mEnd && *mPos != BT_EndObject)
+			{
+				if (!ReadKey(h, *mPos++) || mPos >= mEnd || !ReadValue(h, *mPos++)) return false;
+				count++;
+			}
+			return mPos++ < mEnd && h.EndObject(count);
+		}
+
+		case BT_StartArray:
+		{
+			unsigned count = 0;
+			if (!h.StartArray()) return false;
+			while (mPos < mEnd && *mPos != BT_EndArray)
+			{
+				if (!ReadValue(h, *mPos++)) return false;
+				count++;
+			}
+			return mPos++ < mEnd && h.EndArray(count);
+		}
+
+		default:
+			return false;
+		}
+	}
+
+public:
+	FBinaryReader(const char *buffer, size_t length)
+	{
+		mPos = (const uint8_t *)buffer + sizeof(BinaryMagic);
+		mEnd = (const uint8_t *)buffer + length;
+	}
+
+	static bool IsBinary(const char *buffer, size_t length)
+	{
+		return length >= sizeof(BinaryMagic) && !memcmp(buffer, BinaryMagic, sizeof(BinaryMagic));
+	}
+
+	template<class Handler>
+	bool operator()(Handler &h)
+	{
+		return mPos < mEnd && ReadValue(h, *mPos++);
+	}
+};
+
 //==========================================================================
 //
 // some wrapper stuff to keep the RapidJSON dependencies out of the global headers.
@@ -243,21 +584,27 @@ struct FWriter
 
 	Writer *mWriter1;
 	PrettyWriter *mWriter2;
+	FBinaryWriter *mWriter3;
 	TArray<bool> mInObject;
 	rapidjson::StringBuffer mOutString;
 	TArray<DObject *> mDObjects;
 	TMap<DObject *, int> mObjectMap;
 	
-	FWriter(bool pretty)
+	FWriter(bool pretty, bool binary = false)
 	{
-		if (!pretty)
+		mWriter1 = nullptr;
+		mWriter2 = nullptr;
+		mWriter3 = nullptr;
+		if (binary)
+		{
+			mWriter3 = new FBinaryWriter(mOutString);
+		}
+		else if (!pretty)
 		{
 			mWriter1 = new Writer(mOutString);
-			mWriter2 = nullptr;
 		}
 		else
 		{
-			mWriter1 = nullptr;
 			mWriter2 = new PrettyWriter(mOutString);
 		}
 	}
@@ -266,6 +613,7 @@ struct FWriter
 	{
 		if (mWriter1) delete mWriter1;
 		if (mWriter2) delete mWriter2;
+		if (mWriter3) delete mWriter3;
 	}
 
 
@@ -278,36 +626,42 @@ struct FWriter
 	{
 		if (mWriter1) mWriter1->StartObject();
 		else if (mWriter2) mWriter2->StartObject();
+		else if (mWriter3) mWriter3->StartObject();
 	}
 
 	void EndObject()
 	{
 		if (mWriter1) mWriter1->EndObject();
 		else if (mWriter2) mWriter2->EndObject();
+		else if (mWriter3) mWriter3->EndObject();
 	}
 
 	void StartArray()
 	{
 		if (mWriter1) mWriter1->StartArray();
 		else if (mWriter2) mWriter2->StartArray();
+		else if (mWriter3) mWriter3->StartArray();
 	}
 
 	void EndArray()
 	{
 		if (mWriter1) mWriter1->EndArray();
 		else if (mWriter2) mWriter2->EndArray();
+		else if (mWriter3) mWriter3->EndArray();
 	}
 
 	void Key(const char *k)
 	{
 		if (mWriter1) mWriter1->Key(k);
 		else if (mWriter2) mWriter2->Key(k);
+		else if (mWriter3) mWriter3->Key(k);
 	}
 
 	void Null()
 	{
 		if (mWriter1) mWriter1->Null();
 		else if (mWriter2) mWriter2->Null();
+		else if (mWriter3) mWriter3->Null();
 	}
 
 	void String(const char *k)
@@ -315,6 +669,7 @@ struct FWriter
 		k = StringToUnicode(k);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void String(const char *k, int size)
@@ -322,36 +677,42 @@ struct FWriter
 		k = StringToUnicode(k, size);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void Bool(bool k)
 	{
 		if (mWriter1) mWriter1->Bool(k);
 		else if (mWriter2) mWriter2->Bool(k);
+		else if (mWriter3) mWriter3->Bool(k);
 	}
 
 	void Int(int32_t k)
 	{
 		if (mWriter1) mWriter1->Int(k);
 		else if (mWriter2) mWriter2->Int(k);
+		else if (mWriter3) mWriter3->Int(k);
 	}
 
 	void Int64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Int64(k);
 		else if (mWriter2) mWriter2->Int64(k);
+		else if (mWriter3) mWriter3->Int64(k);
 	}
 
 	void Uint(uint32_t k)
 	{
 		if (mWriter1) mWriter1->Uint(k);
 		else if (mWriter2) mWriter2->Uint(k);
+		else if (mWriter3) mWriter3->Uint(k);
 	}
 
 	void Uint64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Uint64(k);
 		else if (mWriter2) mWriter2->Uint64(k);
+		else if (mWriter3) mWriter3->Uint64(k);
 	}
 
 	void Double(double k)
@@ -364,6 +725,10 @@ struct FWriter
 		{
 			mWriter2->Double(k);
 		}
+		else if (mWriter3)
+		{
+			mWriter3->Double(k);
+		}
 	}
 
 };
@@ -385,8 +750,18 @@ struct FReader
 
 	FReader(const char *buffer, size_t length)
 	{
-		rapidjson::Document doc;
-		mDoc.Parse(buffer, length);
+		if (FBinaryReader::IsBinary(buffer, length))
+		{
+			FBinaryReader reader(buffer, length);
+			if (!mDoc.Populate(reader).IsObject())
+			{
+				Printf(TEXTCOLOR_RED "Corrupt binary savegame data\n");
+			}
+		}
+		else
+		{
+			mDoc.Parse(buffer, length);
+		}
 		mObjects.Push(FJSONObject(&mDoc));
 		memset(mPlayers, -1, sizeof(mPlayers));
 	}
@@ -437,6 +812,22 @@ bool FSerializer::OpenWriter(bool pretty)
 	return true;
 }
 
+//==========================================================================
+//
+// The readers detect the binary format by themselves.
+//
+//==========================================================================
+
+bool FSerializer::OpenBinaryWriter()
+{
+	if (w != nullptr || r != nullptr) return false;
+
+	mErrors = 0;
+	w = new FWriter(false, true);
+	BeginObject(nullptr);
+	return true;
+}
+
 //==========================================================================
 //
 //
@@ -1102,57 +1493,31 @@ const char *FSerializer::GetOutput(unsigned *len)
 //==========================================================================
 
 FCompressedBuffer FSerializer::GetCompressedOutput()
+{
+	FCompressedBuffer buff = GetStoredOutput();
+	buff.Compress();
+	return buff;
+}
+
+//==========================================================================
+//
+// Returns an uncompressed copy of the output. Its CRC gets calculated
+// by FCompressedBuffer::Compress, which may run on another thread.
+//
+//==========================================================================
+
+FCompressedBuffer FSerializer::GetStoredOutput()
 {
 	if (isReading()) return{ 0,0,0,0,0,nullptr };
 	FCompressedBuffer buff;
 	WriteObjects();
 	EndObject();
-	buff.mSize = (unsigned)w->mOutString.GetSize();
-	buff.mZipFlags = 0;
-	buff.mCRC32 = crc32(0, (const Bytef*)w->mOutString.GetString(), buff.mSize);
-
-	uint8_t *compressbuf = new uint8_t[buff.mSize+1];
-
-	z_stream stream;
-	int err;
-
-	stream.next_in = (Bytef *)w->mOutString.GetString();
-	stream.avail_in = buff.mSize;
-	stream.next_out = (Bytef*)compressbuf;
-	stream.avail_out = buff.mSize;
-	stream.zalloc = (alloc_func)0;
-	stream.zfree = (free_func)0;
-	stream.opaque = (voidpf)0;
-
-	// create output in zip-compatible form as required by FCompressedBuffer
-	err = deflateInit2(&stream, 8, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY);
-	if (err != Z_OK)
-	{
-		goto error;
-	}
-
-	err = deflate(&stream, Z_FINISH);
-	if (err != Z_STREAM_END) 
-	{
-		deflateEnd(&stream);
-		goto error;
-	}
-	buff.mCompressedSize = stream.total_out;
-
-	err = deflateEnd(&stream);
-	if (err == Z_OK)
-	{
-		buff.mBuffer = new char[buff.mCompressedSize];
-		buff.mMethod = METHOD_DEFLATE;
-		memcpy(buff.mBuffer, compressbuf, buff.mCompressedSize);
-		delete[] compressbuf;
-		return buff;
-	}
-
-error:
-	memcpy(compressbuf, w->mOutString.GetString(), buff.mSize + 1);
-	buff.mCompressedSize = buff.mSize;
+	buff.mSize = buff.mCompressedSize = (unsigned)w->mOutString.GetSize();
 	buff.mMethod = METHOD_STORED;
+	buff.mZipFlags = 0;
+	buff.mCRC32 = 0;
+	buff.mBuffer = new char[buff.mSize + 1];
+	memcpy(buff.mBuffer, w->mOutString.GetString(), buff.mSize + 1);
 	return buff;
 }
 
@@ -2217,3 +2582,46 @@ FSerializer &Serialize(FSerializer &arc, const char *key, NumericValue &value, N
 	}
 	return arc;
 }
+
+//==========================================================================
+//
+// Writes the current level in both formats and checks that the binary
+// data reads back to the same document as the JSON text.
+//
+//==========================================================================
+
+CCMD(checkbinarysave)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("Not in a level\n");
+		return;
+	}
+
+	FSerializer jsonarc, binarc;
+	cycle_t jsontime, bintime;
+	unsigned jsonlen, binlen;
+
+	SaveVersion = SAVEVER;
+	jsontime.Reset();
+	jsontime.Clock();
+	jsonarc.OpenWriter(false);
+	G_SerializeLevel(jsonarc, false);
+	const char *json = jsonarc.GetOutput(&jsonlen);
+	jsontime.Unclock();
+
+	bintime.Reset();
+	bintime.Clock();
+	binarc.OpenBinaryWriter();
+	G_SerializeLevel(binarc, false);
+	const char *bin = binarc.GetOutput(&binlen);
+	bintime.Unclock();
+
+	FReader jsonreader(json, jsonlen);
+	FReader binreader(bin, binlen);
+	bool same = jsonreader.mDoc == binreader.mDoc;
+
+	Printf("JSON: %u bytes, %.2f ms\n", jsonlen, jsontime.TimeMS());
+	Printf("Binary: %u bytes, %.2f ms\n", binlen, bintime.TimeMS());
+	Printf("%s\n", same ? "Both formats read back identically" : TEXTCOLOR_RED "The formats read back differently");
+}
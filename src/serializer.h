@@ -78,6 +78,7 @@ public:
 		Close();
 	}
 	bool OpenWriter(bool pretty = true);
+	bool OpenBinaryWriter();
 	bool OpenReader(const char *buffer, size_t length);
 	bool OpenReader(FCompressedBuffer *input);
 	void Close();
@@ -90,6 +91,7 @@ public:
 	const char *GetKey();
 	const char *GetOutput(unsigned *len = nullptr);
 	FCompressedBuffer GetCompressedOutput();
+	FCompressedBuffer GetStoredOutput();
 	FSerializer &Args(const char *key, int *args, int *defargs, int special);
 	FSerializer &Terrain(const char *key, int &terrain, int *def = nullptr);
 	FSerializer &Sprite(const char *key, int32_t &spritenum, int32_t *def);
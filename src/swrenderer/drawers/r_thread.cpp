@@ -55,7 +55,6 @@ DrawerThreads::DrawerThreads()
 
 DrawerThreads::~DrawerThreads()
 {
-	StopThreads();
 }
 
 void DrawerThreads::Execute(DrawerCommandQueuePtr commands)
@@ -64,26 +63,35 @@ void DrawerThreads::Execute(DrawerCommandQueuePtr commands)
 		return;
 	
 	auto queue = Instance();
+	auto jobs = FJobSystem::Instance();
 
-	// Add to queue and awaken worker threads
-	std::unique_lock<std::mutex> start_lock(queue->start_mutex);
-	std::unique_lock<std::mutex> end_lock(queue->end_mutex);
+	// Add to queue and schedule every slice that is not already working through the list
+	std::unique_lock<std::mutex> lock(queue->queue_mutex);
 	queue->StartThreads();
 	queue->active_commands.push_back(commands);
-	queue->tasks_left += queue->threads.size();
-	end_lock.unlock();
-	start_lock.unlock();
-	queue->start_condition.notify_all();
+	std::vector<DrawerThread *> start;
+	start.reserve(queue->threads.size());
+	for (auto &thread : queue->threads)
+	{
+		if (!thread.scheduled)
+		{
+			thread.scheduled = true;
+			start.push_back(&thread);
+		}
+	}
+	queue->slices_running.Add((int)start.size());
+	lock.unlock();
+
+	// Must not hold the lock here, Submit may run the job right away
+	for (auto thread : start)
+		jobs->Submit(&thread->job);
 }
 
 void DrawerThreads::WaitForWorkers()
 {
-	using namespace std::chrono_literals;
-
-	// Wait for workers to finish
+	// Wait for all slices to finish. The waiting thread helps out with the remaining jobs.
 	auto queue = Instance();
-	std::unique_lock<std::mutex> end_lock(queue->end_mutex);
-	if (!queue->end_condition.wait_for(end_lock, 5s, [&]() { return queue->tasks_left == 0; }))
+	if (!queue->slices_running.Wait(5000))
 	{
 #ifdef WIN32
 		PeekThreadedErrorPane();
@@ -92,10 +100,9 @@ void DrawerThreads::WaitForWorkers()
 		int *threadCrashed = nullptr;
 		*threadCrashed = 0xdeadbeef;
 	}
-	end_lock.unlock();
 
 	// Clean up
-	std::unique_lock<std::mutex> start_lock(queue->start_mutex);
+	std::unique_lock<std::mutex> lock(queue->queue_mutex);
 	for (auto &thread : queue->threads)
 		thread.current_queue = 0;
 
@@ -108,34 +115,47 @@ void DrawerThreads::WaitForWorkers()
 	queue->active_commands.clear();
 }
 
-void DrawerThreads::WorkerMain(DrawerThread *thread)
+double DrawerThreads::GetBusyTimeMS()
+{
+	double time = 0.0;
+	for (auto &thread : Instance()->threads)
+		time += thread.busy_cycles.TimeMS();
+	return time;
+}
+
+void DrawerThreads::ResetBusyTime()
+{
+	for (auto &thread : Instance()->threads)
+		thread.busy_cycles.Reset();
+}
+
+void DrawerThreads::RunSlice(void *data)
 {
+	DrawerThread *thread = (DrawerThread *)data;
+	auto queue = Instance();
+
+	thread->busy_cycles.Clock();
 	while (true)
 	{
-		// Wait until we are signalled to run:
-		std::unique_lock<std::mutex> start_lock(start_mutex);
-		start_condition.wait(start_lock, [&]() { return thread->current_queue < active_commands.size() || shutdown_flag; });
-		if (shutdown_flag)
+		// Grab the next command list for this slice, or retire if there is none
+		std::unique_lock<std::mutex> lock(queue->queue_mutex);
+		if (thread->current_queue == queue->active_commands.size())
+		{
+			// Execute may schedule the slice again as soon as the lock is
+			// released, so nothing of it may be touched after that.
+			thread->busy_cycles.Unclock();
+			thread->scheduled = false;
 			break;
-
-		// Grab the commands
-		DrawerCommandQueuePtr list = active_commands[thread->current_queue];
+		}
+		DrawerCommandQueue *list = queue->active_commands[thread->current_queue].get();
 		thread->current_queue++;
-		start_lock.unlock();
+		lock.unlock();
 
 		// Do the work:
 		for (auto& command : list->commands)
 		{
 			command->Execute(thread);
 		}
-
-		// Notify main thread that we finished:
-		std::unique_lock<std::mutex> end_lock(end_mutex);
-		tasks_left--;
-		bool finishedTasks = tasks_left == 0;
-		end_lock.unlock();
-		if (finishedTasks)
-			end_condition.notify_all();
 	}
 }
 
@@ -144,35 +164,23 @@ void DrawerThreads::StartThreads()
 	if (!threads.empty())
 		return;
 
-	int num_threads = std::thread::hardware_concurrency();
-	if (num_threads == 0)
-		num_threads = 4;
+	// One line slice per thread able to run jobs
+	int num_threads = FJobSystem::Instance()->GetNumThreads();
 
 	threads.resize(num_threads);
 
 	for (int i = 0; i < num_threads; i++)
 	{
-		DrawerThreads *queue = this;
 		DrawerThread *thread = &threads[i];
 		thread->core = i;
 		thread->num_cores = num_threads;
-		thread->thread = std::thread([=]() { queue->WorkerMain(thread); });
+		thread->busy_cycles.Reset();
+		thread->job.Func = &DrawerThreads::RunSlice;
+		thread->job.Data = thread;
+		thread->job.Group = &slices_running;
 	}
 }
 
-void DrawerThreads::StopThreads()
-{
-	std::unique_lock<std::mutex> lock(start_mutex);
-	shutdown_flag = true;
-	lock.unlock();
-	start_condition.notify_all();
-	for (auto &thread : threads)
-		thread.thread.join();
-	threads.clear();
-	lock.lock();
-	shutdown_flag = false;
-}
-
 #ifndef WIN32
 
 void VectoredTryCatch(void *data, void(*tryBlock)(void *data), void(*catchBlock)(void *data, const char *reason, bool fatal))
@@ -23,22 +23,26 @@
 #pragma once
 
 #include "r_draw.h"
+#include "stats.h"
+#include "jobsystem.h"
 #include <vector>
 #include <memory>
-#include <thread>
 #include <mutex>
-#include <condition_variable>
 
 // Use multiple threads when drawing
 EXTERN_CVAR(Bool, r_multithreaded)
 
-// Worker data for each thread executing drawer commands
+// Worker data for each line slice of the screen. A slice is executed by
+// whichever job system thread picks up its job, but never by two at once.
 class DrawerThread
 {
 public:
-	std::thread thread;
 	size_t current_queue = 0;
 
+	// Set while the slice job is queued or running (protected by queue_mutex)
+	bool scheduled = false;
+	FJob job;
+
 	// Thread line index of this thread
 	int core = 0;
 
@@ -48,6 +52,9 @@ public:
 	// Working buffer used by the tilted (sloped) span drawer
 	const uint8_t *tiltlighting[MAXWIDTH];
 
+	// Time spent executing commands since the last ResetBusyTime
+	cycle_t busy_cycles;
+
 	// Checks if a line is rendered by this thread
 	bool line_skipped_by_thread(int line)
 	{
@@ -105,28 +112,27 @@ public:
 
 	// Waits for all commands to finish executing
 	static void WaitForWorkers();
+
+	// Total time the worker threads spent executing commands. Only valid after WaitForWorkers
+	static double GetBusyTimeMS();
+	static void ResetBusyTime();
 	
 private:
 	DrawerThreads();
 	~DrawerThreads();
 	
 	void StartThreads();
-	void StopThreads();
-	void WorkerMain(DrawerThread *thread);
+	static void RunSlice(void *data);
 
 	static DrawerThreads *Instance();
 	static void ReportDrawerError(DrawerCommand *command, bool worker_thread, const char *reason, bool fatal);
 	
 	std::vector<DrawerThread> threads;
 
-	std::mutex start_mutex;
-	std::condition_variable start_condition;
+	std::mutex queue_mutex;
 	std::vector<DrawerCommandQueuePtr> active_commands;
-	bool shutdown_flag = false;
 
-	std::mutex end_mutex;
-	std::condition_variable end_condition;
-	size_t tasks_left = 0;
+	FJobGroup slices_running;
 
 	DrawerThread single_core_thread;
 	
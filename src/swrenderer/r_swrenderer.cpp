@@ -208,11 +208,22 @@ void FSoftwareRenderer::WriteSavePic (player_t *player, FileWriter *file, int wi
 
 	// Take a snapshot of the player's view
 	pic->Lock ();
+	RenderViewToCanvas(player, pic);
+	screen->GetFlashedPalette (palette);
+	M_CreatePNG (file, pic->GetBuffer(), palette, SS_PAL, width, height, pic->GetPitch());
+	pic->Unlock ();
+	delete pic;
+}
+
+bool FSoftwareRenderer::RenderViewToCanvas(player_t *player, DCanvas *canvas)
+{
+	int width = canvas->GetWidth();
+	int height = canvas->GetHeight();
 	if (r_polyrenderer)
 	{
 		PolyRenderer::Instance()->Viewpoint = r_viewpoint;
 		PolyRenderer::Instance()->Viewwindow = r_viewwindow;
-		PolyRenderer::Instance()->RenderViewToCanvas(player->mo, pic, 0, 0, width, height, true);
+		PolyRenderer::Instance()->RenderViewToCanvas(player->mo, canvas, 0, 0, width, height, true);
 		r_viewpoint = PolyRenderer::Instance()->Viewpoint;
 		r_viewwindow = PolyRenderer::Instance()->Viewwindow;
 	}
@@ -220,14 +231,11 @@ void FSoftwareRenderer::WriteSavePic (player_t *player, FileWriter *file, int wi
 	{
 		mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
 		mScene.MainThread()->Viewport->viewwindow = r_viewwindow;
-		mScene.RenderViewToCanvas(player->mo, pic, 0, 0, width, height);
+		mScene.RenderViewToCanvas(player->mo, canvas, 0, 0, width, height);
 		r_viewpoint = mScene.MainThread()->Viewport->viewpoint;
 		r_viewwindow = mScene.MainThread()->Viewport->viewwindow;
 	}
-	screen->GetFlashedPalette (palette);
-	M_CreatePNG (file, pic->GetBuffer(), palette, SS_PAL, width, height, pic->GetPitch());
-	pic->Unlock ();
-	delete pic;
+	return true;
 }
 
 void FSoftwareRenderer::DrawRemainingPlayerSprites()
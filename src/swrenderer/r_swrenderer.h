@@ -21,6 +21,9 @@ struct FSoftwareRenderer : public FRenderer
 	// renders view to a savegame picture
 	void WriteSavePic (player_t *player, FileWriter *file, int width, int height) override;
 
+	// renders view to an offscreen canvas
+	bool RenderViewToCanvas(player_t *player, DCanvas *canvas) override;
+
 	// draws player sprites with hardware acceleration (only useful for software rendering)
 	void DrawRemainingPlayerSprites() override;
 
@@ -69,6 +69,7 @@
 #include "po_man.h"
 #include "r_data/colormaps.h"
 #include "g_levellocals.h"
+#include "p_pvs.h"
 
 EXTERN_CVAR(Bool, r_fullbrightignoresectorcolor);
 EXTERN_CVAR(Bool, r_drawvoxels);
@@ -826,6 +827,14 @@ namespace swrenderer
 		SeenActors.clear();
 
 		InSubsector = nullptr;
+
+		// Portal views can start outside of the map, so only the main view uses the PVS.
+		RenderPortal *renderportal = Thread->Portal.get();
+		if (renderportal->CurrentPortal == nullptr && !renderportal->CurrentPortalInSkybox && renderportal->MirrorFlags == 0)
+			PVSRow = PVS.GetVisibleRow(Thread->Viewport->viewpoint.Pos);
+		else
+			PVSRow = nullptr;
+
 		RenderBSPNode(level.HeadNode());	// The head node is the last node output.
 
 		if (Thread->MainThread)
@@ -862,7 +871,9 @@ namespace swrenderer
 
 			node = bsp->children[side];
 		}
-		RenderSubsector((subsector_t *)((uint8_t *)node - 1));
+		subsector_t *sub = (subsector_t *)((uint8_t *)node - 1);
+		if (PVSRow == nullptr || FPotentiallyVisibleSet::IsVisible(PVSRow, sub))
+			RenderSubsector(sub);
 	}
 
 	void RenderOpaquePass::ClearClip()
@@ -90,6 +90,7 @@ namespace swrenderer
 		bool GetThingSprite(AActor *thing, ThingSprite &sprite);
 
 		subsector_t *InSubsector = nullptr;
+		const uint32_t *PVSRow = nullptr;	// subsectors visible from the view, if known
 		sector_t *frontsector = nullptr;
 		WaterFakeSide FakeSide = WaterFakeSide::Center;
 		bool r_fakingunderwater = false;
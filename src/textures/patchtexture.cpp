@@ -250,7 +250,7 @@ void FPatchTexture::MakeTexture ()
 	const column_t *maxcol;
 	int x;
 
-	FMemLump lump = Wads.ReadLump (SourceLump);
+	FLumpView lump = Wads.ReadLumpView (SourceLump);
 	const patch_t *patch = (const patch_t *)lump.GetMem();
 
 	maxcol = (const column_t *)((const uint8_t *)patch + Wads.LumpLength (SourceLump) - 3);
@@ -259,13 +259,13 @@ void FPatchTexture::MakeTexture ()
 #if 0	// Such textures won't be created so there's no need to check here
 	if (LittleShort(patch->width) <= 0 || LittleShort(patch->height) <= 0)
 	{
-		lump = Wads.ReadLump ("-BADPATC");
+		lump = Wads.ReadLumpView (Wads.GetNumForName ("-BADPATC"));
 		patch = (const patch_t *)lump.GetMem();
 		Printf (PRINT_BOLD, "Patch %s has a non-positive size.\n", Name);
 	}
 	else if (LittleShort(patch->width) > 2048 || LittleShort(patch->height) > 2048)
 	{
-		lump = Wads.ReadLump ("-BADPATC");
+		lump = Wads.ReadLumpView (Wads.GetNumForName ("-BADPATC"));
 		patch = (const patch_t *)lump.GetMem();
 		Printf (PRINT_BOLD, "Patch %s is too big.\n", Name);
 	}
@@ -366,8 +366,8 @@ void FPatchTexture::HackHack (int newheight)
 	// Check if this patch is likely to be a problem.
 	// It must be 256 pixels tall, and all its columns must have exactly
 	// one post, where each post has a supposed length of 0.
-	FMemLump lump = Wads.ReadLump (SourceLump);
-	const patch_t *realpatch = (patch_t *)lump.GetMem();
+	FLumpView lump = Wads.ReadLumpView (SourceLump);
+	const patch_t *realpatch = (const patch_t *)lump.GetMem();
 	const uint32_t *cofs = realpatch->columnofs;
 	int x, x2 = LittleShort(realpatch->width);
 
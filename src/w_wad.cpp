@@ -41,6 +41,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <string.h>
+#include <exception>
 
 #include "doomtype.h"
 #include "m_argv.h"
@@ -58,6 +59,12 @@
 #include "md5.h"
 #include "doomstat.h"
 #include "vm.h"
+#include "c_console.h"
+#include "jobsystem.h"
+#include "stats.h"
+#include "resourcefiles/lumpcache.h"
+
+CVAR(Bool, wad_mmap, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 
 // MACROS ------------------------------------------------------------------
 
@@ -107,9 +114,7 @@ void uppercopy (char *to, const char *from)
 }
 
 FWadCollection::FWadCollection ()
-: FirstLumpIndex(NULL), NextLumpIndex(NULL),
-  FirstLumpIndex_FullName(NULL), NextLumpIndex_FullName(NULL), 
-  NumLumps(0)
+: NumLumps(0)
 {
 }
 
@@ -120,26 +125,12 @@ FWadCollection::~FWadCollection ()
 
 void FWadCollection::DeleteAll ()
 {
-	if (FirstLumpIndex != NULL)
-	{
-		delete[] FirstLumpIndex;
-		FirstLumpIndex = NULL;
-	}
-	if (NextLumpIndex != NULL)
-	{
-		delete[] NextLumpIndex;
-		NextLumpIndex = NULL;
-	}
-	if (FirstLumpIndex_FullName != NULL)
-	{
-		delete[] FirstLumpIndex_FullName;
-		FirstLumpIndex_FullName = NULL;
-	}
-	if (NextLumpIndex_FullName != NULL)
-	{
-		delete[] NextLumpIndex_FullName;
-		NextLumpIndex_FullName = NULL;
-	}
+	FLumpCache::Instance()->Clear();
+
+	ShortNameIndex.Clear();
+	NextLumpIndex.Clear();
+	FullNameIndex.Clear();
+	NextLumpIndex_FullName.Clear();
 
 	LumpInfo.Clear();
 	NumLumps = 0;
@@ -172,10 +163,47 @@ void FWadCollection::InitMultipleFiles (TArray<FString> &filenames)
 	DeleteAll();
 	numfiles = 0;
 
+	// Opening a file and reading its directory does not depend on any other
+	// file, so all of them are opened in parallel. They get added to the
+	// lump list in load order afterwards, and so does their console output.
+	struct FOpenedFile
+	{
+		FResourceFile *Resource;
+		FileReader *Reader;
+		FConsoleCapture Output;
+		std::exception_ptr Error;
+	};
+	TArray<FOpenedFile> opened;
+	opened.Resize(filenames.Size());
+
+	FJobSystem::Instance()->ParallelFor(0, filenames.Size(), [&](int i)
+	{
+		opened[i].Output.Start();
+		opened[i].Reader = NULL;
+		opened[i].Resource = NULL;
+		try
+		{
+			opened[i].Resource = OpenFile(filenames[i], opened[i].Reader);
+		}
+		catch (...)
+		{
+			// Errors must not leave the worker; rethrow them in load order.
+			opened[i].Error = std::current_exception();
+		}
+		opened[i].Output.Stop();
+	}, 1);
+
 	for(unsigned i=0;i<filenames.Size(); i++)
 	{
-		int baselump = NumLumps;
-		AddFile (filenames[i]);
+		opened[i].Output.Flush();
+		if (opened[i].Error)
+		{
+			std::rethrow_exception(opened[i].Error);
+		}
+		if (opened[i].Resource != NULL)
+		{
+			AddResourceFile (filenames[i], opened[i].Resource, opened[i].Reader);
+		}
 	}
 
 	NumLumps = LumpInfo.Size();
@@ -188,10 +216,6 @@ void FWadCollection::InitMultipleFiles (TArray<FString> &filenames)
 	FixMacHexen();
 
 	// [RH] Set up hash table
-	FirstLumpIndex = new uint32_t[NumLumps];
-	NextLumpIndex = new uint32_t[NumLumps];
-	FirstLumpIndex_FullName = new uint32_t[NumLumps];
-	NextLumpIndex_FullName = new uint32_t[NumLumps];
 	InitHashChains ();
 	LumpInfo.ShrinkToFit();
 	Files.ShrinkToFit();
@@ -227,7 +251,24 @@ int FWadCollection::AddExternalFile(const char *filename)
 
 void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 {
-	int startlump;
+	FResourceFile *resfile = OpenFile(filename, wadinfo);
+	if (resfile != NULL)
+	{
+		AddResourceFile(filename, resfile, wadinfo);
+	}
+}
+
+//==========================================================================
+//
+// OpenFile
+//
+// Opens a file and reads its directory. This does not touch the
+// collection so it can run on any thread.
+//
+//==========================================================================
+
+FResourceFile *FWadCollection::OpenFile (const char *filename, FileReader *&wadinfo)
+{
 	bool isdir = false;
 
 	if (wadinfo == NULL)
@@ -238,7 +279,7 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 		{
 			Printf(TEXTCOLOR_RED "Could not stat %s\n", filename);
 			PrintLastError();
-			return;
+			return NULL;
 		}
 		isdir = (info.st_mode & S_IFDIR) != 0;
 
@@ -246,72 +287,112 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 		{
 			try
 			{
-				wadinfo = new FileReader(filename);
+				// Mapping the file allows using its lumps in place.
+				if (wad_mmap) wadinfo = MappedFileReader::Open(filename);
+				if (wadinfo == NULL) wadinfo = new FileReader(filename);
 			}
 			catch (CRecoverableError &err)
 			{ // Didn't find file
 				Printf (TEXTCOLOR_RED "%s\n", err.GetMessage());
 				PrintLastError ();
-				return;
+				return NULL;
 			}
 		}
 	}
 
 	if (!batchrun) Printf (" adding %s", filename);
-	startlump = NumLumps;
 
-	FResourceFile *resfile;
-	
 	if (!isdir)
-		resfile = FResourceFile::OpenResourceFile(filename, wadinfo);
+		return FResourceFile::OpenResourceFile(filename, wadinfo);
 	else
-		resfile = FResourceFile::OpenDirectory(filename);
+		return FResourceFile::OpenDirectory(filename);
+}
 
-	if (resfile != NULL)
-	{
-		uint32_t lumpstart = LumpInfo.Size();
+//==========================================================================
+//
+// AddResourceFile
+//
+// Adds the lumps of an opened file to the collection.
+//
+//==========================================================================
+
+void FWadCollection::AddResourceFile (const char *filename, FResourceFile *resfile, FileReader *wadinfo)
+{
+	uint32_t lumpstart = LumpInfo.Size();
 
-		resfile->SetFirstLump(lumpstart);
+	resfile->SetFirstLump(lumpstart);
+	if (resfile->IsSkinned())
+	{
+		static int namespc = ns_firstskin;
 		for (uint32_t i=0; i < resfile->LumpCount(); i++)
 		{
-			FResourceLump *lump = resfile->GetLump(i);
-			FWadCollection::LumpRecord *lump_p = &LumpInfo[LumpInfo.Reserve(1)];
-
-			lump_p->lump = lump;
-			lump_p->wadnum = Files.Size();
+			resfile->GetLump(i)->Namespace = namespc;
 		}
+		namespc++;
+	}
+	for (uint32_t i=0; i < resfile->LumpCount(); i++)
+	{
+		FResourceLump *lump = resfile->GetLump(i);
+		FWadCollection::LumpRecord *lump_p = &LumpInfo[LumpInfo.Reserve(1)];
 
-		if (Files.Size() == IWAD_FILENUM && gameinfo.gametype == GAME_Strife && gameinfo.flags & GI_SHAREWARE)
+		lump_p->lump = lump;
+		lump_p->wadnum = Files.Size();
+	}
+
+	if (Files.Size() == IWAD_FILENUM && gameinfo.gametype == GAME_Strife && gameinfo.flags & GI_SHAREWARE)
+	{
+		resfile->FindStrifeTeaserVoices();
+	}
+	Files.Push(resfile);
+
+	for (uint32_t i=0; i < resfile->LumpCount(); i++)
+	{
+		FResourceLump *lump = resfile->GetLump(i);
+		if (lump->Flags & LUMPF_EMBEDDED)
 		{
-			resfile->FindStrifeTeaserVoices();
+			FString path;
+			path.Format("%s:%s", filename, lump->FullName.GetChars());
+			FileReader *embedded = lump->NewReader();
+			AddFile(path, embedded);
 		}
-		Files.Push(resfile);
+	}
 
-		for (uint32_t i=0; i < resfile->LumpCount(); i++)
+	if (hashfile)
+	{
+		uint8_t cksum[16];
+		char cksumout[33];
+		memset(cksumout, 0, sizeof(cksumout));
+
+		FileReader *reader = wadinfo;
+
+		if (reader != NULL)
 		{
-			FResourceLump *lump = resfile->GetLump(i);
-			if (lump->Flags & LUMPF_EMBEDDED)
+			MD5Context md5;
+			reader->Seek(0, SEEK_SET);
+			md5.Update(reader, reader->GetLength());
+			md5.Final(cksum);
+
+			for (size_t j = 0; j < sizeof(cksum); ++j)
 			{
-				FString path;
-				path.Format("%s:%s", filename, lump->FullName.GetChars());
-				FileReader *embedded = lump->NewReader();
-				AddFile(path, embedded);
+				sprintf(cksumout + (j * 2), "%02X", cksum[j]);
 			}
+
+			fprintf(hashfile, "file: %s, hash: %s, size: %ld\n", filename, cksumout, reader->GetLength());
 		}
 
-		if (hashfile)
-		{
-			uint8_t cksum[16];
-			char cksumout[33];
-			memset(cksumout, 0, sizeof(cksumout));
+		else
+			fprintf(hashfile, "file: %s, Directory structure\n", filename);
 
-			FileReader *reader = wadinfo;
+		for (uint32_t i = 0; i < resfile->LumpCount(); i++)
+		{
+			FResourceLump *lump = resfile->GetLump(i);
 
-			if (reader != NULL)
+			if (!(lump->Flags & LUMPF_EMBEDDED))
 			{
+				reader = lump->NewReader();
+
 				MD5Context md5;
-				reader->Seek(0, SEEK_SET);
-				md5.Update(reader, reader->GetLength());
+				md5.Update(reader, lump->LumpSize);
 				md5.Final(cksum);
 
 				for (size_t j = 0; j < sizeof(cksum); ++j)
@@ -319,38 +400,13 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 					sprintf(cksumout + (j * 2), "%02X", cksum[j]);
 				}
 
-				fprintf(hashfile, "file: %s, hash: %s, size: %ld\n", filename, cksumout, reader->GetLength());
-			}
-
-			else
-				fprintf(hashfile, "file: %s, Directory structure\n", filename);
-
-			for (uint32_t i = 0; i < resfile->LumpCount(); i++)
-			{
-				FResourceLump *lump = resfile->GetLump(i);
-
-				if (!(lump->Flags & LUMPF_EMBEDDED))
-				{
-					reader = lump->NewReader();
-
-					MD5Context md5;
-					md5.Update(reader, lump->LumpSize);
-					md5.Final(cksum);
-
-					for (size_t j = 0; j < sizeof(cksum); ++j)
-					{
-						sprintf(cksumout + (j * 2), "%02X", cksum[j]);
-					}
-
-					fprintf(hashfile, "file: %s, lump: %s, hash: %s, size: %d\n", filename,
-						lump->FullName.IsNotEmpty() ? lump->FullName.GetChars() : lump->Name,
-						cksumout, lump->LumpSize);
+				fprintf(hashfile, "file: %s, lump: %s, hash: %s, size: %d\n", filename,
+					lump->FullName.IsNotEmpty() ? lump->FullName.GetChars() : lump->Name,
+					cksumout, lump->LumpSize);
 
-					delete reader;
-				}
+				delete reader;
 			}
 		}
-		return;
 	}
 }
 
@@ -447,23 +503,20 @@ int FWadCollection::CheckNumForName (const char *name, int space)
 	}
 
 	uppercopy (uname, name);
-	i = FirstLumpIndex[LumpNameHash (uname) % NumLumps];
+	i = FindShortName (qname);
 
 	while (i != NULL_INDEX)
 	{
 		FResourceLump *lump = LumpInfo[i].lump;
 
-		if (lump->qwName == qname)
-		{
-			if (lump->Namespace == space) break;
-			// If the lump is from one of the special namespaces exclusive to Zips
-			// the check has to be done differently:
-			// If we find a lump with this name in the global namespace that does not come
-			// from a Zip return that. WADs don't know these namespaces and single lumps must
-			// work as well.
-			if (space > ns_specialzipdirectory && lump->Namespace == ns_global && 
-				!(lump->Flags & LUMPF_ZIPFILE)) break;
-		}
+		if (lump->Namespace == space) break;
+		// If the lump is from one of the special namespaces exclusive to Zips
+		// the check has to be done differently:
+		// If we find a lump with this name in the global namespace that does not come
+		// from a Zip return that. WADs don't know these namespaces and single lumps must
+		// work as well.
+		if (space > ns_specialzipdirectory && lump->Namespace == ns_global && 
+			!(lump->Flags & LUMPF_ZIPFILE)) break;
 		i = NextLumpIndex[i];
 	}
 
@@ -486,14 +539,13 @@ int FWadCollection::CheckNumForName (const char *name, int space, int wadnum, bo
 	}
 
 	uppercopy (uname, name);
-	i = FirstLumpIndex[LumpNameHash (uname) % NumLumps];
+	i = FindShortName (qname);
 
 	// If exact is true if will only find lumps in the same WAD, otherwise
 	// also those in earlier WADs.
 
 	while (i != NULL_INDEX &&
-		(lump = LumpInfo[i].lump, lump->qwName != qname ||
-		lump->Namespace != space ||
+		(lump = LumpInfo[i].lump, lump->Namespace != space ||
 		 (exact? (LumpInfo[i].wadnum != wadnum) : (LumpInfo[i].wadnum > wadnum)) ))
 	{
 		i = NextLumpIndex[i];
@@ -551,13 +603,7 @@ int FWadCollection::CheckNumForFullName (const char *name, bool trynormal, int n
 		return -1;
 	}
 
-	i = FirstLumpIndex_FullName[MakeKey(name) % NumLumps];
-
-	while (i != NULL_INDEX && stricmp(name, LumpInfo[i].lump->FullName))
-	{
-		i = NextLumpIndex_FullName[i];
-	}
-
+	i = FindFullName (name);
 	if (i != NULL_INDEX) return i;
 
 	if (trynormal && strlen(name) <= 8 && !strpbrk(name, "./"))
@@ -576,10 +622,9 @@ int FWadCollection::CheckNumForFullName (const char *name, int wadnum)
 		return CheckNumForFullName (name);
 	}
 
-	i = FirstLumpIndex_FullName[MakeKey (name) % NumLumps];
+	i = FindFullName (name);
 
-	while (i != NULL_INDEX && 
-		(stricmp(name, LumpInfo[i].lump->FullName) || LumpInfo[i].wadnum != wadnum))
+	while (i != NULL_INDEX && LumpInfo[i].wadnum != wadnum)
 	{
 		i = NextLumpIndex_FullName[i];
 	}
@@ -720,36 +765,116 @@ uint32_t FWadCollection::LumpNameHash (const char *s)
 //
 // W_InitHashChains
 //
-// Prepares the lumpinfos for hashing.
-// (Hey! This looks suspiciously like something from Boom! :-)
+// Builds the open-addressed name indices. Lumps are inserted in load
+// order so the slot always ends up pointing at the newest lump with its
+// name, which is the one a lookup has to return first.
 //
 //==========================================================================
 
+static inline uint32_t ShortNameHash (uint64_t qname)
+{
+	return uint32_t((qname * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
 void FWadCollection::InitHashChains (void)
 {
-	char name[8];
-	unsigned int i, j;
+	unsigned int i, slot, mask;
+	unsigned int size = 16;
+
+	// Keep the tables at most half full so that probe sequences stay short.
+	while (size < NumLumps * 2) size <<= 1;
+	mask = size - 1;
 
-	// Mark all buckets as empty
-	memset (FirstLumpIndex, 255, NumLumps*sizeof(FirstLumpIndex[0]));
-	memset (NextLumpIndex, 255, NumLumps*sizeof(NextLumpIndex[0]));
-	memset (FirstLumpIndex_FullName, 255, NumLumps*sizeof(FirstLumpIndex_FullName[0]));
-	memset (NextLumpIndex_FullName, 255, NumLumps*sizeof(NextLumpIndex_FullName[0]));
+	ShortNameIndex.Resize(size);
+	FullNameIndex.Resize(size);
+	for (i = 0; i < size; i++)
+	{
+		ShortNameIndex[i].Lump = NULL_INDEX;
+		FullNameIndex[i].Lump = NULL_INDEX;
+	}
+	NextLumpIndex.Resize(NumLumps);
+	NextLumpIndex_FullName.Resize(NumLumps);
 
-	// Now set up the chains
 	for (i = 0; i < (unsigned)NumLumps; i++)
 	{
-		uppercopy (name, LumpInfo[i].lump->Name);
-		j = LumpNameHash (name) % NumLumps;
-		NextLumpIndex[i] = FirstLumpIndex[j];
-		FirstLumpIndex[j] = i;
+		FResourceLump *lump = LumpInfo[i].lump;
+		uint64_t qname = lump->qwName;
+
+		slot = ShortNameHash(qname) & mask;
+		while (ShortNameIndex[slot].Lump != NULL_INDEX && ShortNameIndex[slot].Name != qname)
+		{
+			slot = (slot + 1) & mask;
+		}
+		NextLumpIndex[i] = ShortNameIndex[slot].Lump;
+		ShortNameIndex[slot].Name = qname;
+		ShortNameIndex[slot].Lump = i;
 
 		// Do the same for the full paths
-		if (LumpInfo[i].lump->FullName.IsNotEmpty())
+		NextLumpIndex_FullName[i] = NULL_INDEX;
+		if (lump->FullName.IsNotEmpty())
+		{
+			uint32_t hash = MakeKey(lump->FullName);
+
+			slot = hash & mask;
+			while (FullNameIndex[slot].Lump != NULL_INDEX && (FullNameIndex[slot].Hash != hash ||
+				stricmp(LumpInfo[FullNameIndex[slot].Lump].lump->FullName, lump->FullName)))
+			{
+				slot = (slot + 1) & mask;
+			}
+			NextLumpIndex_FullName[i] = FullNameIndex[slot].Lump;
+			FullNameIndex[slot].Hash = hash;
+			FullNameIndex[slot].Lump = i;
+		}
+	}
+}
+
+//==========================================================================
+//
+// FindShortName
+//
+// Returns the newest lump whose 8 character name matches, or NULL_INDEX.
+//
+//==========================================================================
+
+uint32_t FWadCollection::FindShortName (uint64_t qname) const
+{
+	if (ShortNameIndex.Size() == 0) return NULL_INDEX;
+
+	unsigned int mask = ShortNameIndex.Size() - 1;
+	for (unsigned int slot = ShortNameHash(qname) & mask; ; slot = (slot + 1) & mask)
+	{
+		const ShortNameSlot &entry = ShortNameIndex[slot];
+		if (entry.Lump == NULL_INDEX || entry.Name == qname)
 		{
-			j = MakeKey(LumpInfo[i].lump->FullName) % NumLumps;
-			NextLumpIndex_FullName[i] = FirstLumpIndex_FullName[j];
-			FirstLumpIndex_FullName[j] = i;
+			return entry.Lump;
+		}
+	}
+}
+
+//==========================================================================
+//
+// FindFullName
+//
+// Same for full paths. The comparison is case insensitive.
+//
+//==========================================================================
+
+uint32_t FWadCollection::FindFullName (const char *name) const
+{
+	if (FullNameIndex.Size() == 0) return NULL_INDEX;
+
+	uint32_t hash = MakeKey(name);
+	unsigned int mask = FullNameIndex.Size() - 1;
+	for (unsigned int slot = hash & mask; ; slot = (slot + 1) & mask)
+	{
+		const FullNameSlot &entry = FullNameIndex[slot];
+		if (entry.Lump == NULL_INDEX)
+		{
+			return NULL_INDEX;
+		}
+		if (entry.Hash == hash && !stricmp(name, LumpInfo[entry.Lump].lump->FullName))
+		{
+			return entry.Lump;
 		}
 	}
 }
@@ -1280,6 +1405,47 @@ FMemLump FWadCollection::ReadLump (int lump)
 	return FMemLump(FString(ELumpNum(lump)));
 }
 
+//==========================================================================
+//
+// ReadLumpView
+//
+// Returns the lump's data without copying it, if possible.
+//
+//==========================================================================
+
+FLumpView FWadCollection::ReadLumpView (int lump)
+{
+	if ((unsigned)lump >= (unsigned)LumpInfo.Size())
+	{
+		I_Error ("ReadLumpView: %u >= NumLumps", lump);
+	}
+	return FLumpView(LumpInfo[lump].lump);
+}
+
+//==========================================================================
+//
+// PrefetchLumps
+//
+// Starts decompressing the given lumps on the job system so that their
+// first use does not have to. Uncompressed lumps are ignored.
+//
+//==========================================================================
+
+void FWadCollection::PrefetchLumps (const TArray<int> &lumps)
+{
+	TArray<FResourceLump *> resources;
+
+	resources.Grow(lumps.Size());
+	for (int lump : lumps)
+	{
+		if ((unsigned)lump < (unsigned)LumpInfo.Size())
+		{
+			resources.Push(LumpInfo[lump].lump);
+		}
+	}
+	FLumpCache::Instance()->Prefetch(resources);
+}
+
 //==========================================================================
 //
 // OpenLumpNum
@@ -1639,6 +1805,53 @@ FMemLump::~FMemLump ()
 {
 }
 
+// FLumpView ----------------------------------------------------------------
+
+FLumpView::FLumpView (FResourceLump *lump)
+{
+	Data = (const char *)lump->CacheLump();
+	Size = Data == NULL ? 0 : lump->LumpSize;
+	// A negative reference count means the cache stays valid for the lump's entire lifetime.
+	Lump = Data != NULL && lump->RefCount > 0 ? lump : NULL;
+}
+
+FLumpView::FLumpView (FLumpView &&other)
+: Lump(other.Lump), Data(other.Data), Size(other.Size)
+{
+	other.Lump = NULL;
+	other.Data = NULL;
+	other.Size = 0;
+}
+
+FLumpView &FLumpView::operator= (FLumpView &&other)
+{
+	if (this != &other)
+	{
+		Release();
+		Lump = other.Lump;
+		Data = other.Data;
+		Size = other.Size;
+		other.Lump = NULL;
+		other.Data = NULL;
+		other.Size = 0;
+	}
+	return *this;
+}
+
+FLumpView::~FLumpView ()
+{
+	Release();
+}
+
+void FLumpView::Release ()
+{
+	if (Lump != NULL)
+	{
+		Lump->ReleaseCache();
+		Lump = NULL;
+	}
+}
+
 FString::FString (ELumpNum lumpnum)
 {
 	FWadLump lumpr = Wads.OpenLumpNum ((int)lumpnum);
@@ -1702,6 +1915,109 @@ static void PrintLastError ()
 }
 #endif
 
+//==========================================================================
+//
+// CCMD benchlumpindex
+//
+// Times name lookups on a synthetic load order, 100000 lumps by default.
+// About a quarter of the names are duplicated across files and half of
+// the files are zips with full paths, like a large mod setup.
+//
+//==========================================================================
+
+class FLumpIndexBenchmark : public FWadCollection
+{
+public:
+	void Run(int numlumps, int numlookups);
+};
+
+void FLumpIndexBenchmark::Run(int numlumps, int numlookups)
+{
+	static const int spaces[] = { ns_global, ns_sprites, ns_flats, ns_newtextures, ns_sounds, ns_graphics };
+	int numwads = 1 + numlumps / 5000;
+	int numnames = numlumps * 3 / 4;
+	uint32_t seed = 1;
+
+	auto random = [&](int range)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return int((seed >> 8) % range);
+	};
+
+	FUncompressedLump *lumps = new FUncompressedLump[numlumps];
+	LumpInfo.Resize(numlumps);
+	for (int i = 0; i < numlumps; i++)
+	{
+		int k = random(numnames);
+		int wadnum = int((int64_t)i * numwads / numlumps);
+
+		mysnprintf(lumps[i].Name, countof(lumps[i].Name), "L%07X", k);
+		lumps[i].Namespace = spaces[k % countof(spaces)];
+		if (wadnum & 1)
+		{
+			lumps[i].FullName.Format("dir%d/l%07x.lmp", k & 15, k);
+			lumps[i].Flags = LUMPF_ZIPFILE;
+		}
+		LumpInfo[i].lump = &lumps[i];
+		LumpInfo[i].wadnum = wadnum;
+	}
+	NumLumps = numlumps;
+
+	cycle_t buildtime, hittime, misstime, fulltime;
+	buildtime.Reset();
+	hittime.Reset();
+	misstime.Reset();
+	fulltime.Reset();
+
+	buildtime.Clock();
+	InitHashChains();
+	buildtime.Unclock();
+
+	// Prepare all query strings up front so that only the lookups get timed.
+	TArray<char> hits(numlookups * 9), misses(numlookups * 9);
+	TArray<int> hitspaces(numlookups);
+	TArray<const char *> fullnames(numlookups);
+	for (int i = 0; i < numlookups; i++)
+	{
+		FResourceLump *lump = &lumps[random(numlumps)];
+		memcpy(&hits[i * 9], lump->Name, 9);
+		hitspaces[i] = lump->Namespace;
+		mysnprintf(&misses[i * 9], 9, "M%07X", random(numnames));
+		do lump = &lumps[random(numlumps)]; while (lump->FullName.IsEmpty());
+		fullnames[i] = lump->FullName.GetChars();
+	}
+
+	int found = 0;
+	hittime.Clock();
+	for (int i = 0; i < numlookups; i++) found += CheckNumForName(&hits[i * 9], hitspaces[i]) >= 0;
+	hittime.Unclock();
+	misstime.Clock();
+	for (int i = 0; i < numlookups; i++) found += CheckNumForName(&misses[i * 9], ns_global) >= 0;
+	misstime.Unclock();
+	fulltime.Clock();
+	for (int i = 0; i < numlookups; i++) found += CheckNumForFullName(fullnames[i]) >= 0;
+	fulltime.Unclock();
+
+	Printf("%d lumps in %d files: index built in %.2f ms\n", numlumps, numwads, buildtime.TimeMS());
+	Printf("  short name hit:  %.1f ns\n", hittime.TimeMS() * 1e6 / numlookups);
+	Printf("  short name miss: %.1f ns\n", misstime.TimeMS() * 1e6 / numlookups);
+	Printf("  full name hit:   %.1f ns\n", fulltime.TimeMS() * 1e6 / numlookups);
+	Printf("  %d of %d lookups found\n", found, numlookups * 3);
+
+	LumpInfo.Clear();
+	NumLumps = 0;
+	delete[] lumps;
+}
+
+CCMD(benchlumpindex)
+{
+	int numlumps = argv.argc() > 1 ? atoi(argv[1]) : 100000;
+	if (numlumps < 1) numlumps = 1;
+
+	FLumpIndexBenchmark bench;
+	bench.Run(numlumps, 1000000);
+}
+
 #ifdef _DEBUG
 //==========================================================================
 //
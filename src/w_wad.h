@@ -72,6 +72,7 @@ enum ELumpFlags
 	LUMPF_ZIPFILE=2,
 	LUMPF_EMBEDDED=4,
 	LUMPF_BLOODCRYPT = 8,
+	LUMPF_LUMPCACHE = 64,	// The lump cache may hold decompressed data for this lump
 };
 
 
@@ -127,6 +128,32 @@ private:
 	friend class FWadCollection;
 };
 
+// Read-only access to a lump's data without copying it. For uncompressed
+// lumps in memory mapped or memory based archives this points directly
+// into the archive, everything else is cached for the lifetime of the view.
+class FLumpView
+{
+public:
+	FLumpView () : Lump(NULL), Data(NULL), Size(0) {}
+	FLumpView (FLumpView &&other);
+	FLumpView &operator= (FLumpView &&other);
+	~FLumpView ();
+	const void *GetMem () const { return Size == 0 ? NULL : Data; }
+	size_t GetSize () const { return Size; }
+
+private:
+	FLumpView (FResourceLump *lump);
+	FLumpView (const FLumpView &) = delete;
+	FLumpView &operator= (const FLumpView &) = delete;
+	void Release ();
+
+	FResourceLump *Lump;	// only set if the view holds a reference to the lump's cache
+	const char *Data;
+	size_t Size;
+
+	friend class FWadCollection;
+};
+
 class FWadCollection
 {
 public:
@@ -174,6 +201,8 @@ public:
 	void ReadLump (int lump, void *dest);
 	FMemLump ReadLump (int lump);
 	FMemLump ReadLump (const char *name) { return ReadLump (GetNumForName (name)); }
+	FLumpView ReadLumpView (int lump);
+	void PrefetchLumps (const TArray<int> &lumps);	// Decompresses lumps ahead of use on the job system
 
 	FWadLump OpenLumpNum (int lump);
 	FWadLump OpenLumpName (const char *name) { return OpenLumpNum (GetNumForName (name)); }
@@ -215,19 +244,37 @@ protected:
 	TArray<FResourceFile *> Files;
 	TArray<LumpRecord> LumpInfo;
 
-	uint32_t *FirstLumpIndex;	// [RH] Hashing stuff moved out of lumpinfo structure
-	uint32_t *NextLumpIndex;
-
-	uint32_t *FirstLumpIndex_FullName;	// The same information for fully qualified paths from .zips
-	uint32_t *NextLumpIndex_FullName;
+	// Open-addressed name indices. Each slot holds one distinct name and the
+	// newest lump using it; older lumps with the same name are chained
+	// through NextLumpIndex, so a lookup never looks at other names' lumps.
+	struct ShortNameSlot
+	{
+		uint64_t Name;	// qwName of the lump
+		uint32_t Lump;
+	};
+	struct FullNameSlot
+	{
+		uint32_t Hash;	// MakeKey of the full name
+		uint32_t Lump;
+	};
+
+	TArray<ShortNameSlot> ShortNameIndex;
+	TArray<uint32_t> NextLumpIndex;
+
+	TArray<FullNameSlot> FullNameIndex;	// The same information for fully qualified paths from .zips
+	TArray<uint32_t> NextLumpIndex_FullName;
 
 	uint32_t NumLumps;					// Not necessarily the same as LumpInfo.Size()
 	uint32_t NumWads;
 
 	void SkinHack (int baselump);
 	void InitHashChains ();								// [RH] Set up the lumpinfo hashing
+	uint32_t FindShortName (uint64_t qname) const;
+	uint32_t FindFullName (const char *name) const;
 
 private:
+	static FResourceFile *OpenFile (const char *filename, FileReader *&wadinfo);
+	void AddResourceFile (const char *filename, FResourceFile *resfile, FileReader *wadinfo);
 	void RenameSprites();
 	void RenameNerve();
 	void FixMacHexen();